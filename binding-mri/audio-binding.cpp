@@ -23,6 +23,8 @@
 #include "sharedstate.h"
 #include "binding-util.h"
 #include "exception.h"
+#include "streamcache.h"
+#include "alstream.h"
 
 #define DEF_PLAY_STOP_POS(entity) \
 	RB_METHOD(audio_##entity##Play) \
@@ -33,7 +35,7 @@
 		int pitch = 100; \
 		double pos = -1.0; \
 		bool fadeInOnOffset = true; \
-		rb_get_args(argc, argv, "z|iifb", &filename, &volume, &pitch, &pos, &fadeInOnOffset RB_ARG_END); \
+		rb_get_typed_args<1>(argc, argv, &filename, &volume, &pitch, &pos, &fadeInOnOffset); \
 		GUARD_EXC( shState->audio().entity##Play(filename, volume, pitch, pos, fadeInOnOffset); ) \
 		return Qnil; \
 	} \
@@ -56,7 +58,7 @@
 		const char *filename; \
 		int volume = 100; \
 		int pitch = 100; \
-		rb_get_args(argc, argv, "z|ii", &filename, &volume, &pitch RB_ARG_END); \
+		rb_get_typed_args<1>(argc, argv, &filename, &volume, &pitch); \
 		GUARD_EXC( shState->audio().entity##Play(filename, volume, pitch); ) \
 		return Qnil; \
 	} \
@@ -72,7 +74,7 @@ RB_METHOD(audio_##entity##Fade) \
 { \
 	RB_UNUSED_PARAM; \
 	int time; \
-	rb_get_args(argc, argv, "i", &time RB_ARG_END); \
+	rb_get_typed_args(argc, argv, &time); \
 	shState->audio().entity##Fade(time); \
 	return Qnil; \
 }
@@ -86,7 +88,7 @@ RB_METHOD(audio_##entity##Crossfade) \
 	int volume = 100; \
 	int pitch = 100; \
 	double pos = -1.0; \
-	rb_get_args(argc, argv, "z|fiif", &filename, &time, &volume, &pitch, &pos RB_ARG_END); \
+	rb_get_typed_args<1>(argc, argv, &filename, &time, &volume, &pitch, &pos); \
 	GUARD_EXC(shState->audio().entity##Crossfade(filename, time, volume, pitch, pos);) \
 	return Qnil; \
 }
@@ -115,7 +117,7 @@ RB_METHOD(audio_##entity##Crossfade) \
 	{ \
 		RB_UNUSED_PARAM; \
 		int value; \
-		rb_get_args(argc, argv, "i", &value RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &value); \
 		shState->audio().set##PropName(value); \
 		return rb_fix_new(value); \
 	}
@@ -123,16 +125,16 @@ RB_METHOD(audio_##entity##Crossfade) \
 AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 	int type;
 	double gain, gainlf, gainhf;
-	rb_get_args(argc, argv, "i|", &type RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &type);
 	switch(type) {
 		case 0: // lowpass
-			rb_get_args(argc, argv, "iff", &type, &gain, &gainhf RB_ARG_END);
+			rb_get_typed_args(argc, argv, &type, &gain, &gainhf);
 			return AL::Filter::createLowpassFilter(gain, gainhf);
 		case 1: // highpass
-			rb_get_args(argc, argv, "iff", &type, &gain, &gainlf RB_ARG_END);
+			rb_get_typed_args(argc, argv, &type, &gain, &gainlf);
 			return AL::Filter::createHighpassFilter(gain, gainlf);
 		case 2: // bandpass
-			rb_get_args(argc, argv, "ifff", &type, &gain, &gainlf, &gainhf RB_ARG_END);
+			rb_get_typed_args(argc, argv, &type, &gain, &gainlf, &gainhf);
 			return AL::Filter::createBandpassFilter(gain, gainlf, gainhf);
 		default:
 			rb_raise(rb_eArgError, "Unrecognized AL filter type");
@@ -151,7 +153,7 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 	} \
 	RB_METHOD(audio_##entity##SetALEffect) { \
 		VALUE effect_obj; \
-		rb_get_args(argc, argv, "o", &effect_obj RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &effect_obj); \
 		ALuint effect = NUM2INT(rb_funcall(effect_obj, rb_intern("create_underlying_effect"), 0)); \
 		shState->audio().entity##SetALEffect(effect); \
 		return Qnil; \
@@ -170,28 +172,28 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 		int pitch = 100; \
 		double pos = -1.0; \
 		bool fadeInOnOffset = true; \
-		rb_get_args(argc, argv, "iz|iifb", &id, &filename, &volume, &pitch, &pos, &fadeInOnOffset RB_ARG_END); \
+		rb_get_typed_args<2>(argc, argv, &id, &filename, &volume, &pitch, &pos, &fadeInOnOffset); \
 		GUARD_EXC( shState->audio().entity##Play(id, filename, volume, pitch, pos, fadeInOnOffset); ) \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##Stop) \
 	{ \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		shState->audio().entity##Stop(id); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##Pos) \
 	{ \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		return rb_float_new(shState->audio().entity##Pos(id)); \
 	} \
 	RB_METHOD(audio_##entity##Fade) \
 	{ \
 		unsigned int id; \
 		int time; \
-		rb_get_args(argc, argv, "ii", &id, &time RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id, &time); \
 		shState->audio().entity##Fade(id, time); \
 		return Qnil; \
 	} \
@@ -203,27 +205,27 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 		int volume = 100; \
 		int pitch = 100; \
 		double pos = -1.0; \
-		rb_get_args(argc, argv, "iz|fiif", &id, &filename, &time, &volume, &pitch, &pos RB_ARG_END); \
+		rb_get_typed_args<2>(argc, argv, &id, &filename, &time, &volume, &pitch, &pos); \
 		GUARD_EXC(shState->audio().entity##Crossfade(id, filename, time, volume, pitch, pos);) \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##IsPlaying) \
 	{ \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		return shState->audio().entity##IsPlaying(id) ? Qtrue : Qfalse; \
 	} \
 	RB_METHOD(audio_##entity##getVolume) \
 	{ \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		return rb_float_new(shState->audio().get##entity##Volume(id)); \
 	} \
 	RB_METHOD(audio_##entity##setVolume) \
 	{ \
 		unsigned int id; \
 		double vol; \
-		rb_get_args(argc, argv, "if", &id, &vol RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id, &vol); \
 		shState->audio().set##entity##Volume(id, vol); \
 		return Qnil; \
 	} \
@@ -235,27 +237,27 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 	RB_METHOD(audio_##entity##setGlobalVolume) \
 	{ \
 		double vol; \
-		rb_get_args(argc, argv, "f", &vol RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &vol); \
 		shState->audio().set##entity##GlobalVolume(vol); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##getPitch) \
 	{ \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		return rb_float_new(shState->audio().get##entity##Pitch(id)); \
 	} \
 	RB_METHOD(audio_##entity##setPitch) \
 	{ \
 		unsigned int id; \
 		double pitch; \
-		rb_get_args(argc, argv, "if", &id, &pitch RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id, &pitch); \
 		shState->audio().set##entity##Pitch(id, pitch); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##SetALFilter) { \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i|", &id RB_ARG_END); \
+		rb_get_typed_args<1>(argc, argv, &id); \
 		argc--; \
 		argv++; \
 		AL::Filter::ID filter = constructALFilter(argc, argv); \
@@ -264,21 +266,21 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 	} \
 	RB_METHOD(audio_##entity##ClearALFilter) { \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		shState->audio().entity##ClearALFilter(id); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##SetALEffect) { \
 		unsigned int id; \
 		VALUE effect_obj; \
-		rb_get_args(argc, argv, "io", &id, &effect_obj RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id, &effect_obj); \
 		ALuint effect = NUM2INT(rb_funcall(effect_obj, rb_intern("create_underlying_effect"), 0)); \
 		shState->audio().entity##SetALEffect(id, effect); \
 		return Qnil; \
 	} \
 	RB_METHOD(audio_##entity##ClearALEffect) { \
 		unsigned int id; \
-		rb_get_args(argc, argv, "i", &id RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &id); \
 		shState->audio().entity##ClearALEffect(id); \
 		return Qnil; \
 	} \
@@ -288,7 +290,7 @@ AL::Filter::ID constructALFilter(int argc, VALUE *argv) {
 	} \
 	RB_METHOD(audio_##entity##Resize) { \
 		unsigned int size; \
-		rb_get_args(argc, argv, "i", &size RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &size); \
 		shState->audio().entity##Resize(size); \
 		return Qnil; \
 	}
@@ -310,7 +312,30 @@ DEF_ISPLAYING( bgm )
 DEF_ISPLAYING( bgs )
 DEF_ISPLAYING( me )
 
-DEF_PLAY_STOP( se )
+RB_METHOD(audio_sePlay)
+{
+	RB_UNUSED_PARAM;
+
+	const char *filename;
+	int volume = 100;
+	int pitch = 100;
+	int priority = 0;
+
+	rb_get_typed_args<1>(argc, argv, &filename, &volume, &pitch, &priority);
+
+	GUARD_EXC( shState->audio().sePlay(filename, volume, pitch, priority); )
+
+	return Qnil;
+}
+
+RB_METHOD(audio_seStop)
+{
+	RB_UNUSED_PARAM;
+
+	shState->audio().seStop();
+
+	return Qnil;
+}
 
 DEF_AUD_PROP_I(BGM_Volume)
 DEF_AUD_PROP_I(SFX_Volume)
@@ -323,6 +348,141 @@ DEF_AUD_ALFILTER(se)
 DEF_ALL_AUDIO_CH_FUNC(lch)
 DEF_ALL_AUDIO_CH_FUNC(ch)
 
+static void sePreloadValue(VALUE name)
+{
+	if (RB_TYPE_P(name, RUBY_T_ARRAY))
+	{
+		for (long i = 0; i < RARRAY_LEN(name); ++i)
+			sePreloadValue(rb_ary_entry(name, i));
+
+		return;
+	}
+
+	shState->audio().sePreload(StringValueCStr(name));
+}
+
+RB_METHOD(audio_sePreload)
+{
+	RB_UNUSED_PARAM;
+
+	/* Accepts any number of names, or arrays of them */
+	for (int i = 0; i < argc; ++i)
+		GUARD_EXC( sePreloadValue(argv[i]); )
+
+	return Qnil;
+}
+
+RB_METHOD(audio_seGetVoices)
+{
+	RB_UNUSED_PARAM;
+
+	return rb_fix_new(shState->audio().seVoices());
+}
+
+RB_METHOD(audio_seSetVoices)
+{
+	RB_UNUSED_PARAM;
+
+	int count;
+	rb_get_typed_args(argc, argv, &count);
+
+	shState->audio().setSEVoices(count);
+
+	return rb_fix_new(shState->audio().seVoices());
+}
+
+RB_METHOD(audio_seStats)
+{
+	RB_UNUSED_PARAM;
+
+	Audio &audio = shState->audio();
+	VALUE hash = rb_hash_new();
+
+#define SET_STAT(key, value) \
+	rb_hash_aset(hash, ID2SYM(rb_intern(key)), value)
+
+	SET_STAT("voices", INT2FIX(audio.seVoices()));
+	SET_STAT("active", INT2FIX(audio.seActiveVoices()));
+	SET_STAT("steals", ULL2NUM(audio.seSteals()));
+	SET_STAT("coalesced", ULL2NUM(audio.seCoalesced()));
+	SET_STAT("dropped", ULL2NUM(audio.seDropped()));
+	SET_STAT("cache_bytes", UINT2NUM(audio.seCacheBytes()));
+
+#undef SET_STAT
+
+	return hash;
+}
+
+RB_METHOD(audioStreamCacheStats)
+{
+	RB_UNUSED_PARAM;
+
+	StreamCache::Stats st = shState->audio().streamCache().stats();
+	VALUE hash = rb_hash_new();
+
+#define SET_STAT(key, value) \
+	rb_hash_aset(hash, ID2SYM(rb_intern(key)), value)
+
+	SET_STAT("hits", ULL2NUM(st.hits));
+	SET_STAT("misses", ULL2NUM(st.misses));
+	SET_STAT("entries", ULL2NUM(st.entries));
+	SET_STAT("bytes", ULL2NUM(st.bytes));
+
+#undef SET_STAT
+
+	return hash;
+}
+
+static VALUE streamStatsHash(const ALStreamStats &st)
+{
+	VALUE hash = rb_hash_new();
+
+#define SET_STAT(key, value) \
+	rb_hash_aset(hash, ID2SYM(rb_intern(key)), value)
+
+	SET_STAT("underruns", ULL2NUM(st.underruns));
+	SET_STAT("wakeups", ULL2NUM(st.wakeups));
+	SET_STAT("buffers", ULL2NUM(st.buffersFilled));
+	SET_STAT("decode_us", ULL2NUM(st.decodeUs));
+	SET_STAT("max_decode_us", UINT2NUM(st.maxDecodeUs));
+	SET_STAT("refills", ULL2NUM(st.refills));
+	SET_STAT("refill_us", ULL2NUM(st.refillUs));
+	SET_STAT("max_refill_us", UINT2NUM(st.maxRefillUs));
+	SET_STAT("avg_queued", rb_float_new(st.depthSamples ? (double) st.depthSum / st.depthSamples : 0.0));
+	SET_STAT("min_queued", st.minDepth < 0 ? Qnil : INT2FIX(st.minDepth));
+	SET_STAT("grows", ULL2NUM(st.grows));
+	SET_STAT("shrinks", ULL2NUM(st.shrinks));
+	SET_STAT("peak_buffers", INT2FIX(st.peakBuffers));
+	SET_STAT("peak_buffer_bytes", UINT2NUM(st.peakBufferBytes));
+
+#undef SET_STAT
+
+	return hash;
+}
+
+RB_METHOD(audioStats)
+{
+	RB_UNUSED_PARAM;
+
+	Audio &audio = shState->audio();
+	VALUE hash = rb_hash_new();
+
+#define SET_STAT(key, value) \
+	rb_hash_aset(hash, ID2SYM(rb_intern(key)), value)
+
+	SET_STAT("bgm", streamStatsHash(audio.bgmStats()));
+	SET_STAT("bgs", streamStatsHash(audio.bgsStats()));
+	SET_STAT("me", streamStatsHash(audio.meStats()));
+	SET_STAT("lch", streamStatsHash(audio.lchStats()));
+	SET_STAT("ch", streamStatsHash(audio.chStats()));
+	SET_STAT("se", audio_seStats(0, 0, self));
+	SET_STAT("stream_cache", audioStreamCacheStats(0, 0, self));
+
+#undef SET_STAT
+
+	return hash;
+}
+
 RB_METHOD(audioReset)
 {
 	RB_UNUSED_PARAM;
@@ -399,6 +559,12 @@ audioBindingInit()
 	BIND_POS( bgs );
 
 	BIND_PLAY_STOP( se )
+	_rb_define_module_function(module, "se_preload", audio_sePreload);
+	_rb_define_module_function(module, "se_voices", audio_seGetVoices);
+	_rb_define_module_function(module, "se_voices=", audio_seSetVoices);
+	_rb_define_module_function(module, "se_stats", audio_seStats);
+	_rb_define_module_function(module, "stream_cache_stats", audioStreamCacheStats);
+	_rb_define_module_function(module, "stats", audioStats);
 
 	BIND_IS_PLAYING( bgm );
 	BIND_IS_PLAYING( bgs );
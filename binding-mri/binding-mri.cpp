@@ -68,6 +68,7 @@ void bitmapBindingInit();
 void spriteBindingInit();
 void viewportBindingInit();
 void planeBindingInit();
+void particleSystemBindingInit();
 void windowBindingInit();
 void tilemapBindingInit();
 void windowVXBindingInit();
@@ -81,9 +82,7 @@ void fileIntBindingInit();
 
 void journalBindingInit();
 void wallpaperBindingInit();
-#ifdef __linux__
 void wallpaperBindingTerminate();
-#endif
 void nikoBindingInit();
 void oneshotBindingInit();
 void steamBindingInit();
@@ -111,6 +110,7 @@ static void mriBindingInit()
 	spriteBindingInit();
 	viewportBindingInit();
 	planeBindingInit();
+	particleSystemBindingInit();
 
 	windowBindingInit();
 	tilemapBindingInit();
@@ -244,7 +244,7 @@ RB_METHOD(mkxpPuts)
 	RB_UNUSED_PARAM;
 
 	const char *str;
-	rb_get_args(argc, argv, "z", &str RB_ARG_END);
+	rb_get_typed_args(argc, argv, &str);
 
 	Debug() << str;
 
@@ -709,15 +709,18 @@ static void mriBindingExecute()
 
 	ruby_cleanup(0);
 
+	/* Ack first: the scripts are done, and a slow wallpaper reset
+	 * must not look like a stuck script. Main waits for this
+	 * thread to exit anyway */
 	shState->rtData().rqTermAck.set();
+
+	/* Waits for wallpaper changes still in flight */
+	wallpaperBindingTerminate();
 }
 
 static void mriBindingTerminate()
 {
 	rb_raise(rb_eSystemExit, " ");
-#ifdef __linux__
-	wallpaperBindingTerminate();
-#endif
 }
 
 static void mriBindingReset()
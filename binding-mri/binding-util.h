@@ -347,6 +347,18 @@ static inline VALUE objectLoad(int argc, VALUE *argv, VALUE self) {
 static inline VALUE rb_bool_new(bool value) { return value ? Qtrue : Qfalse; }
 
 inline void rb_float_arg(VALUE arg, double *out, int argPos = 0) {
+    /* Skip the type switch for the common cases */
+    if (FIXNUM_P(arg)) {
+        *out = FIX2INT(arg);
+        return;
+    }
+#ifdef RB_FLOAT_TYPE_P
+    if (RB_FLOAT_TYPE_P(arg)) {
+        *out = RFLOAT_VALUE(arg);
+        return;
+    }
+#endif
+    
     switch (rb_type(arg)) {
         case RUBY_T_FLOAT:
             *out = RFLOAT_VALUE(arg);
@@ -362,6 +374,11 @@ inline void rb_float_arg(VALUE arg, double *out, int argPos = 0) {
 }
 
 inline void rb_int_arg(VALUE arg, int *out, int argPos = 0) {
+    if (FIXNUM_P(arg)) {
+        *out = FIX2INT(arg);
+        return;
+    }
+    
     switch (rb_type(arg)) {
         case RUBY_T_FLOAT:
             // FIXME check int range?
@@ -399,6 +416,88 @@ inline void rb_check_argc(int actual, int expected) {
                  expected);
 }
 
+/* Typed counterpart to 'rb_get_args': the conversion for each
+ * argument is picked from the type of its output pointer at compile
+ * time instead of parsing a format string on every call.
+ * Supported: int ('i'), double ('f'), bool ('b'), VALUE ('o') and
+ * const char* ('z'). 'Required' is the number of leading arguments
+ * that must be present (the part before '|'), and defaults to all.
+ * Returns the number of arguments read, raises the same errors as
+ * 'rb_get_args' */
+template<typename T>
+struct RbArgConv;
+
+template<>
+struct RbArgConv<int> {
+    static void get(VALUE arg, int *out, int argPos) { rb_int_arg(arg, out, argPos); }
+};
+
+/* Also 'i', for ids and sizes */
+template<>
+struct RbArgConv<unsigned int> {
+    static void get(VALUE arg, unsigned int *out, int argPos) {
+        int value;
+        rb_int_arg(arg, &value, argPos);
+        *out = value;
+    }
+};
+
+template<>
+struct RbArgConv<double> {
+    static void get(VALUE arg, double *out, int argPos) { rb_float_arg(arg, out, argPos); }
+};
+
+template<>
+struct RbArgConv<bool> {
+    static void get(VALUE arg, bool *out, int argPos) { rb_bool_arg(arg, out, argPos); }
+};
+
+template<>
+struct RbArgConv<VALUE> {
+    static void get(VALUE arg, VALUE *out, int) { *out = arg; }
+};
+
+template<>
+struct RbArgConv<const char*> {
+    static void get(VALUE arg, const char **out, int) {
+        VALUE str = rb_str_to_str(arg);
+        *out = RSTRING_PTR(str);
+    }
+};
+
+static inline void rb_get_typed_args_step(int, VALUE *, int) {}
+
+template<typename T, typename... Rest>
+static inline void rb_get_typed_args_step(int argc, VALUE *argv, int argI,
+                                          T *out, Rest *...rest) {
+    if (argI >= argc)
+        return;
+    
+    RbArgConv<T>::get(argv[argI], out, argI);
+    rb_get_typed_args_step(argc, argv, argI + 1, rest...);
+}
+
+template<int Required = -1, typename... Args>
+static inline int rb_get_typed_args(int argc, VALUE *argv, Args *...args) {
+    const int count = sizeof...(Args);
+    const int required = Required < 0 ? count : Required;
+    
+    static_assert(Required <= count, "more required arguments than outputs");
+    
+    // FIXME print num of needed args vs provided
+    if (argc < required)
+        rb_raise(rb_eArgError, "wrong number of arguments");
+    
+#ifndef NDEBUG
+    if (argc > count)
+        rb_raise(rb_eArgError, "wrong number of arguments");
+#endif
+    
+    rb_get_typed_args_step(argc, argv, 0, args...);
+    
+    return argc < count ? argc : count;
+}
+
 #if RAPI_MAJOR < 2
 static inline void rb_error_arity(int argc, int min, int max) {
     if (argc > max || argc < min)
@@ -436,7 +535,7 @@ RB_METHOD(Typ##Load) { return objectLoad<Typ>(argc, argv, self); }
 #define INITCOPY_FUN(Klass)                                                    \
 RB_METHOD(Klass##InitializeCopy) {                                           \
 VALUE origObj;                                                             \
-rb_get_args(argc, argv, "o", &origObj RB_ARG_END);                         \
+rb_get_typed_args(argc, argv, &origObj);                         \
 if (!OBJ_INIT_COPY(self, origObj)) /* When would this fail??*/             \
 return self;                                                             \
 Klass *orig = getPrivateData<Klass>(origObj);                              \
@@ -54,15 +54,15 @@ RB_METHOD(bitmapInitialize)
 
 	if (argc == 1)
 	{
-		char *filename;
-		rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+		const char *filename;
+		rb_get_typed_args(argc, argv, &filename);
 
 		GUARD_EXC( b = new Bitmap(filename); )
 	}
 	else
 	{
 		int width, height;
-		rb_get_args(argc, argv, "ii", &width, &height RB_ARG_END);
+		rb_get_typed_args(argc, argv, &width, &height);
 
 		GUARD_EXC( b = new Bitmap(width, height); )
 	}
@@ -123,7 +123,7 @@ RB_METHOD(bitmapBlt)
 	Bitmap *src;
 	Rect *srcRect;
 
-	rb_get_args(argc, argv, "iioo|i", &x, &y, &srcObj, &srcRectObj, &opacity RB_ARG_END);
+	rb_get_typed_args<4>(argc, argv, &x, &y, &srcObj, &srcRectObj, &opacity);
 
 	src = getPrivateDataCheck<Bitmap>(srcObj, BitmapType);
 	srcRect = getPrivateDataCheck<Rect>(srcRectObj, RectType);
@@ -145,7 +145,7 @@ RB_METHOD(bitmapStretchBlt)
 	Bitmap *src;
 	Rect *destRect, *srcRect;
 
-	rb_get_args(argc, argv, "ooo|i", &destRectObj, &srcObj, &srcRectObj, &opacity RB_ARG_END);
+	rb_get_typed_args<3>(argc, argv, &destRectObj, &srcObj, &srcRectObj, &opacity);
 
 	src = getPrivateDataCheck<Bitmap>(srcObj, BitmapType);
 	destRect = getPrivateDataCheck<Rect>(destRectObj, RectType);
@@ -168,7 +168,7 @@ RB_METHOD(bitmapFillRect)
 		VALUE rectObj;
 		Rect *rect;
 
-		rb_get_args(argc, argv, "oo", &rectObj, &colorObj RB_ARG_END);
+		rb_get_typed_args(argc, argv, &rectObj, &colorObj);
 
 		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
 		color = getPrivateDataCheck<Color>(colorObj, ColorType);
@@ -179,7 +179,7 @@ RB_METHOD(bitmapFillRect)
 	{
 		int x, y, width, height;
 
-		rb_get_args(argc, argv, "iiiio", &x, &y, &width, &height, &colorObj RB_ARG_END);
+		rb_get_typed_args(argc, argv, &x, &y, &width, &height, &colorObj);
 
 		color = getPrivateDataCheck<Color>(colorObj, ColorType);
 
@@ -206,7 +206,7 @@ RB_METHOD(bitmapGetPixel)
 
 	int x, y;
 
-	rb_get_args(argc, argv, "ii", &x, &y RB_ARG_END);
+	rb_get_typed_args(argc, argv, &x, &y);
 
 	Color value;
 	GUARD_EXC( value = b->getPixel(x, y); );
@@ -225,7 +225,7 @@ RB_METHOD(bitmapSetPixel)
 
 	Color *color;
 
-	rb_get_args(argc, argv, "iio", &x, &y, &colorObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &x, &y, &colorObj);
 
 	color = getPrivateDataCheck<Color>(colorObj, ColorType);
 
@@ -240,7 +240,7 @@ RB_METHOD(bitmapHueChange)
 
 	int hue;
 
-	rb_get_args(argc, argv, "i", &hue RB_ARG_END);
+	rb_get_typed_args(argc, argv, &hue);
 
 	GUARD_EXC( b->hueChange(hue); );
 
@@ -262,13 +262,13 @@ RB_METHOD(bitmapDrawText)
 		if (rgssVer >= 2)
 		{
 			VALUE strObj;
-			rb_get_args(argc, argv, "oo|i", &rectObj, &strObj, &align RB_ARG_END);
+			rb_get_typed_args<2>(argc, argv, &rectObj, &strObj, &align);
 
 			str = objAsStringPtr(strObj);
 		}
 		else
 		{
-			rb_get_args(argc, argv, "oz|i", &rectObj, &str, &align RB_ARG_END);
+			rb_get_typed_args<2>(argc, argv, &rectObj, &str, &align);
 		}
 
 		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
@@ -282,13 +282,13 @@ RB_METHOD(bitmapDrawText)
 		if (rgssVer >= 2)
 		{
 			VALUE strObj;
-			rb_get_args(argc, argv, "iiiio|i", &x, &y, &width, &height, &strObj, &align RB_ARG_END);
+			rb_get_typed_args<5>(argc, argv, &x, &y, &width, &height, &strObj, &align);
 
 			str = objAsStringPtr(strObj);
 		}
 		else
 		{
-			rb_get_args(argc, argv, "iiiiz|i", &x, &y, &width, &height, &str, &align RB_ARG_END);
+			rb_get_typed_args<5>(argc, argv, &x, &y, &width, &height, &str, &align);
 		}
 
 		GUARD_EXC( b->drawText(x, y, width, height, str, align); );
@@ -306,13 +306,13 @@ RB_METHOD(bitmapTextSize)
 	if (rgssVer >= 2)
 	{
 		VALUE strObj;
-		rb_get_args(argc, argv, "o", &strObj RB_ARG_END);
+		rb_get_typed_args(argc, argv, &strObj);
 
 		str = objAsStringPtr(strObj);
 	}
 	else
 	{
-		rb_get_args(argc, argv, "z", &str RB_ARG_END);
+		rb_get_typed_args(argc, argv, &str);
 	}
 
 	IntRect value;
@@ -323,6 +323,35 @@ RB_METHOD(bitmapTextSize)
 	return wrapObject(rect, RectType);
 }
 
+RB_METHOD(bitmapDrawTextWrapped)
+{
+	Bitmap *b = getPrivateData<Bitmap>(self);
+
+	VALUE rectObj;
+	const char *str;
+	int align = Bitmap::Left;
+	int lineHeight = 0;
+
+	if (rgssVer >= 2)
+	{
+		VALUE strObj;
+		rb_get_typed_args<2>(argc, argv, &rectObj, &strObj, &align, &lineHeight);
+
+		str = objAsStringPtr(strObj);
+	}
+	else
+	{
+		rb_get_typed_args<2>(argc, argv, &rectObj, &str, &align, &lineHeight);
+	}
+
+	Rect *rect = getPrivateDataCheck<Rect>(rectObj, RectType);
+
+	int lines = 0;
+	GUARD_EXC( lines = b->drawTextWrapped(rect->toIntRect(), str, align, lineHeight); );
+
+	return rb_fix_new(lines);
+}
+
 DEF_PROP_OBJ_VAL(Bitmap, Font, Font, "font")
 
 RB_METHOD(bitmapGradientFillRect)
@@ -338,8 +367,8 @@ RB_METHOD(bitmapGradientFillRect)
 		VALUE rectObj;
 		Rect *rect;
 
-		rb_get_args(argc, argv, "ooo|b", &rectObj,
-		            &color1Obj, &color2Obj, &vertical RB_ARG_END);
+		rb_get_typed_args<3>(argc, argv, &rectObj,
+		            &color1Obj, &color2Obj, &vertical);
 
 		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
 		color1 = getPrivateDataCheck<Color>(color1Obj, ColorType);
@@ -351,8 +380,8 @@ RB_METHOD(bitmapGradientFillRect)
 	{
 		int x, y, width, height;
 
-		rb_get_args(argc, argv, "iiiioo|b", &x, &y, &width, &height,
-		            &color1Obj, &color2Obj, &vertical RB_ARG_END);
+		rb_get_typed_args<6>(argc, argv, &x, &y, &width, &height,
+		            &color1Obj, &color2Obj, &vertical);
 
 		color1 = getPrivateDataCheck<Color>(color1Obj, ColorType);
 		color2 = getPrivateDataCheck<Color>(color2Obj, ColorType);
@@ -372,7 +401,7 @@ RB_METHOD(bitmapClearRect)
 		VALUE rectObj;
 		Rect *rect;
 
-		rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+		rb_get_typed_args(argc, argv, &rectObj);
 
 		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
 
@@ -382,7 +411,7 @@ RB_METHOD(bitmapClearRect)
 	{
 		int x, y, width, height;
 
-		rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+		rb_get_typed_args(argc, argv, &x, &y, &width, &height);
 
 		GUARD_EXC( b->clearRect(x, y, width, height); );
 	}
@@ -408,7 +437,7 @@ RB_METHOD(bitmapMask)
 
 	int x = 0;
 	int y = 0;
-	rb_get_args(argc, argv, "o|ii", &bitmapObj, &x, &y RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &bitmapObj, &x, &y);
 	bitmap = getPrivateDataCheck<Bitmap>(bitmapObj, BitmapType);
 
 	Bitmap *b = getPrivateData<Bitmap>(self);
@@ -423,7 +452,7 @@ RB_METHOD(bitmapRadialBlur)
 	Bitmap *b = getPrivateData<Bitmap>(self);
 
 	int angle, divisions;
-	rb_get_args(argc, argv, "ii", &angle, &divisions RB_ARG_END);
+	rb_get_typed_args(argc, argv, &angle, &divisions);
 
 	b->radialBlur(angle, divisions);
 
@@ -474,6 +503,7 @@ bitmapBindingInit()
 	_rb_define_method(klass, "hue_change",  bitmapHueChange);
 	_rb_define_method(klass, "draw_text",   bitmapDrawText);
 	_rb_define_method(klass, "text_size",   bitmapTextSize);
+	_rb_define_method(klass, "draw_text_wrapped", bitmapDrawTextWrapped);
 	_rb_define_method(klass, "mask",   		bitmapMask);
 
 	//if (rgssVer >= 2)
@@ -28,7 +28,7 @@ DEF_TYPE(Color);
 DEF_TYPE(Tone);
 DEF_TYPE(Rect);
 
-#define ATTR_RW(Klass, Attr, arg_type, arg_t_s, value_fun) \
+#define ATTR_RW(Klass, Attr, arg_type, value_fun) \
 	RB_METHOD(Klass##Get##Attr) \
 	{ \
 		RB_UNUSED_PARAM \
@@ -39,13 +39,13 @@ DEF_TYPE(Rect);
 	{ \
 		Klass *p = getPrivateData<Klass>(self); \
 		arg_type arg; \
-		rb_get_args(argc, argv, arg_t_s, &arg RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &arg); \
 		p->set##Attr(arg); \
 		return *argv; \
 	}
 
-#define ATTR_DOUBLE_RW(Klass, Attr) ATTR_RW(Klass, Attr, double, "f", rb_float_new)
-#define ATTR_INT_RW(Klass, Attr)   ATTR_RW(Klass, Attr, int, "i", rb_fix_new)
+#define ATTR_DOUBLE_RW(Klass, Attr) ATTR_RW(Klass, Attr, double, rb_float_new)
+#define ATTR_INT_RW(Klass, Attr)   ATTR_RW(Klass, Attr, int, rb_fix_new)
 
 ATTR_DOUBLE_RW(Color, Red)
 ATTR_DOUBLE_RW(Color, Green)
@@ -68,7 +68,7 @@ ATTR_INT_RW(Rect, Height)
 		Klass *p = getPrivateData<Klass>(self); \
 		VALUE otherObj; \
 		Klass *other; \
-		rb_get_args(argc, argv, "o", &otherObj RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &otherObj); \
 		if (rgssVer >= 3) \
 			if (!rb_typeddata_is_kind_of(otherObj, &Klass##Type)) \
 				return Qfalse; \
@@ -80,7 +80,7 @@ EQUAL_FUN(Color)
 EQUAL_FUN(Tone)
 EQUAL_FUN(Rect)
 
-#define INIT_FUN(Klass, param_type, param_t_s, last_param_def) \
+#define INIT_FUN(Klass, param_type, param_req, last_param_def) \
 	RB_METHOD(Klass##Initialize) \
 	{ \
 		Klass *k; \
@@ -91,18 +91,18 @@ EQUAL_FUN(Rect)
 		else \
 		{ \
 			param_type p1, p2, p3, p4 = last_param_def; \
-			rb_get_args(argc, argv, param_t_s, &p1, &p2, &p3, &p4 RB_ARG_END); \
+			rb_get_typed_args<param_req>(argc, argv, &p1, &p2, &p3, &p4); \
 			k = new Klass(p1, p2, p3, p4); \
 		} \
 		setPrivateData(self, k); \
 		return self; \
 	}
 
-INIT_FUN(Color, double, "fff|f", 255)
-INIT_FUN(Tone, double, "fff|f", 0)
-INIT_FUN(Rect, int, "iiii", 0)
+INIT_FUN(Color, double, 3, 255)
+INIT_FUN(Tone, double, 3, 0)
+INIT_FUN(Rect, int, 4, 0)
 
-#define SET_FUN(Klass, param_type, param_t_s, last_param_def) \
+#define SET_FUN(Klass, param_type, param_req, last_param_def) \
 	RB_METHOD(Klass##Set) \
 	{ \
 		Klass *k = getPrivateData<Klass>(self); \
@@ -115,15 +115,15 @@ INIT_FUN(Rect, int, "iiii", 0)
 		else \
 		{ \
 			param_type p1, p2, p3, p4 = last_param_def; \
-			rb_get_args(argc, argv, param_t_s, &p1, &p2, &p3, &p4 RB_ARG_END); \
+			rb_get_typed_args<param_req>(argc, argv, &p1, &p2, &p3, &p4); \
 			k->set(p1, p2, p3, p4); \
 		} \
 		return self; \
 	}
 
-SET_FUN(Color, double, "fff|f", 255)
-SET_FUN(Tone, double, "fff|f", 0)
-SET_FUN(Rect, int, "iiii", 0)
+SET_FUN(Color, double, 3, 255)
+SET_FUN(Tone, double, 3, 0)
+SET_FUN(Rect, int, 4, 0)
 
 RB_METHOD(rectEmpty)
 {
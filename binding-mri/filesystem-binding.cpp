@@ -71,7 +71,7 @@ RB_METHOD(fileIntRead)
 {
 
 	int length = -1;
-	rb_get_args(argc, argv, "i", &length RB_ARG_END);
+	rb_get_typed_args(argc, argv, &length);
 
 	SDL_RWops *ops = getPrivateData<SDL_RWops>(self);
 
@@ -144,7 +144,7 @@ RB_METHOD(kernelLoadData)
 	RB_UNUSED_PARAM;
 
 	const char *filename;
-	rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+	rb_get_typed_args(argc, argv, &filename);
 
 	return kernelLoadDataInt(filename, true);
 }
@@ -192,7 +192,7 @@ RB_METHOD(_marshalLoad)
 
 	VALUE port, proc = Qnil;
 
-	rb_get_args(argc, argv, "o|o", &port, &proc RB_ARG_END);
+	rb_get_typed_args<1>(argc, argv, &port, &proc);
 
 	VALUE utf8Proc;
 	if (NIL_P(proc))
@@ -36,7 +36,7 @@ RB_METHOD(flashableFlash)
 
 	Color *color;
 
-	rb_get_args(argc, argv, "oi", &colorObj, &duration RB_ARG_END);
+	rb_get_typed_args(argc, argv, &colorObj, &duration);
 
 	if (NIL_P(colorObj))
 	{
@@ -59,7 +59,7 @@ RB_METHOD(fontDoesExist)
 	const char *name = 0;
 	VALUE nameObj;
 
-	rb_get_args(argc, argv, "o", &nameObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &nameObj);
 
 	if (RB_TYPE_P(nameObj, RUBY_T_STRING))
 		name = rb_string_value_cstr(&nameObj);
@@ -74,7 +74,7 @@ RB_METHOD(fontInitialize)
 	VALUE namesObj = Qnil;
 	int size = 0;
 
-	rb_get_args(argc, argv, "|oi", &namesObj, &size RB_ARG_END);
+	rb_get_typed_args<0>(argc, argv, &namesObj, &size);
 
 	Font *f;
 
@@ -112,7 +112,7 @@ RB_METHOD(fontInitialize)
 RB_METHOD(fontInitializeCopy)
 {
 	VALUE origObj;
-	rb_get_args(argc, argv, "o", &origObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &origObj);
 
 	if (!OBJ_INIT_COPY(self, origObj))
 		return self;
@@ -167,7 +167,7 @@ DEF_PROP_B(Font, Italic)
 DEF_PROP_B(Font, Shadow)
 DEF_PROP_B(Font, Outline)
 
-#define DEF_KLASS_PROP(Klass, type, PropName, param_t_s, value_fun) \
+#define DEF_KLASS_PROP(Klass, type, PropName, value_fun) \
 	RB_METHOD(Klass##Get##PropName) \
 	{ \
 		RB_UNUSED_PARAM; \
@@ -177,16 +177,16 @@ DEF_PROP_B(Font, Outline)
 	{ \
 		RB_UNUSED_PARAM; \
 		type value; \
-		rb_get_args(argc, argv, param_t_s, &value RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &value); \
 		Klass::set##PropName(value); \
 		return value_fun(value); \
 	}
 
-DEF_KLASS_PROP(Font, int,  DefaultSize,    "i", rb_fix_new)
-DEF_KLASS_PROP(Font, bool, DefaultBold,    "b", rb_bool_new)
-DEF_KLASS_PROP(Font, bool, DefaultItalic,  "b", rb_bool_new)
-DEF_KLASS_PROP(Font, bool, DefaultShadow,  "b", rb_bool_new)
-DEF_KLASS_PROP(Font, bool, DefaultOutline, "b", rb_bool_new)
+DEF_KLASS_PROP(Font, int,  DefaultSize,    rb_fix_new)
+DEF_KLASS_PROP(Font, bool, DefaultBold,    rb_bool_new)
+DEF_KLASS_PROP(Font, bool, DefaultItalic,  rb_bool_new)
+DEF_KLASS_PROP(Font, bool, DefaultShadow,  rb_bool_new)
+DEF_KLASS_PROP(Font, bool, DefaultOutline, rb_bool_new)
 
 RB_METHOD(FontGetDefaultOutColor)
 {
@@ -199,7 +199,7 @@ RB_METHOD(FontSetDefaultOutColor)
 	RB_UNUSED_PARAM;
 
 	VALUE colorObj;
-	rb_get_args(argc, argv, "o", &colorObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &colorObj);
 
 	Color *c = getPrivateDataCheck<Color>(colorObj, ColorType);
 
@@ -242,7 +242,7 @@ RB_METHOD(FontSetDefaultColor)
 	RB_UNUSED_PARAM;
 
 	VALUE colorObj;
-	rb_get_args(argc, argv, "o", &colorObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &colorObj);
 
 	Color *c = getPrivateDataCheck<Color>(colorObj, ColorType);
 
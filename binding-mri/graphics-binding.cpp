@@ -61,7 +61,7 @@ RB_METHOD(graphicsTransition)
 	const char *filename = "";
 	int vague = 40;
 
-	rb_get_args(argc, argv, "|izi", &duration, &filename, &vague RB_ARG_END);
+	rb_get_typed_args<0>(argc, argv, &duration, &filename, &vague);
 
 	GUARD_EXC( shState->graphics().transition(duration, filename, vague); )
 
@@ -87,7 +87,7 @@ RB_METHOD(graphicsFrameReset)
 	{ \
 		RB_UNUSED_PARAM; \
 		int value; \
-		rb_get_args(argc, argv, "i", &value RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &value); \
 		shState->graphics().set##PropName(value); \
 		return rb_fix_new(value); \
 	}
@@ -102,7 +102,7 @@ RB_METHOD(graphicsFrameReset)
 	{ \
 		RB_UNUSED_PARAM; \
 		bool value; \
-		rb_get_args(argc, argv, "b", &value RB_ARG_END); \
+		rb_get_typed_args(argc, argv, &value); \
 		shState->graphics().set##PropName(value); \
 		return rb_bool_new(value); \
 	}
@@ -121,12 +121,67 @@ RB_METHOD(graphicsHeight)
 	return rb_fix_new(shState->graphics().height());
 }
 
+RB_METHOD(graphicsDrawnElements)
+{
+	RB_UNUSED_PARAM;
+
+	return rb_fix_new(shState->graphics().drawnElements());
+}
+
+RB_METHOD(graphicsCulledElements)
+{
+	RB_UNUSED_PARAM;
+
+	return rb_fix_new(shState->graphics().culledElements());
+}
+
+RB_METHOD(graphicsFrameTiming)
+{
+	RB_UNUSED_PARAM;
+
+	const FrameTimingStats &st = shState->graphics().frameTiming();
+
+	VALUE histogram = rb_ary_new2(FrameTimingStats::BucketCount);
+
+	for (int i = 0; i < FrameTimingStats::BucketCount; ++i)
+		rb_ary_push(histogram, ULL2NUM(st.buckets[i]));
+
+	int64_t samples = std::max<int64_t>(st.samples, 1);
+
+	VALUE hash = rb_hash_new();
+
+#define SET_STAT(key, value) \
+	rb_hash_aset(hash, ID2SYM(rb_intern(key)), value)
+
+	SET_STAT("frames", ULL2NUM(st.samples));
+	SET_STAT("min_us", LL2NUM(st.minUs));
+	SET_STAT("max_us", LL2NUM(st.maxUs));
+	SET_STAT("mean_us", LL2NUM(st.sumUs / samples));
+	SET_STAT("mean_abs_us", LL2NUM(st.sumAbsUs / samples));
+	SET_STAT("bucket_us", INT2FIX(FrameTimingStats::BucketUs));
+	SET_STAT("bucket_min_us", INT2FIX(FrameTimingStats::BucketMinUs));
+	SET_STAT("histogram", histogram);
+
+#undef SET_STAT
+
+	return hash;
+}
+
+RB_METHOD(graphicsResetFrameTiming)
+{
+	RB_UNUSED_PARAM;
+
+	shState->graphics().resetFrameTiming();
+
+	return Qnil;
+}
+
 RB_METHOD(graphicsWait)
 {
 	RB_UNUSED_PARAM;
 
 	int duration;
-	rb_get_args(argc, argv, "i", &duration RB_ARG_END);
+	rb_get_typed_args(argc, argv, &duration);
 
 	shState->graphics().wait(duration);
 
@@ -138,7 +193,7 @@ RB_METHOD(graphicsFadeout)
 	RB_UNUSED_PARAM;
 
 	int duration;
-	rb_get_args(argc, argv, "i", &duration RB_ARG_END);
+	rb_get_typed_args(argc, argv, &duration);
 
 	shState->graphics().fadeout(duration);
 
@@ -150,7 +205,7 @@ RB_METHOD(graphicsFadein)
 	RB_UNUSED_PARAM;
 
 	int duration;
-	rb_get_args(argc, argv, "i", &duration RB_ARG_END);
+	rb_get_typed_args(argc, argv, &duration);
 
 	shState->graphics().fadein(duration);
 
@@ -177,7 +232,7 @@ RB_METHOD(graphicsResizeScreen)
 	RB_UNUSED_PARAM;
 
 	int width, height;
-	rb_get_args(argc, argv, "ii", &width, &height RB_ARG_END);
+	rb_get_typed_args(argc, argv, &width, &height);
 
 	shState->graphics().resizeScreen(width, height);
 
@@ -198,7 +253,7 @@ RB_METHOD(graphicsPlayMovie)
 	RB_UNUSED_PARAM;
 
 	const char *filename;
-	rb_get_args(argc, argv, "z", &filename RB_ARG_END);
+	rb_get_typed_args(argc, argv, &filename);
 
 	shState->graphics().playMovie(filename);
 
@@ -256,4 +311,9 @@ void graphicsBindingInit()
 	INIT_GRA_PROP_BIND( ShowCursor, "show_cursor" );
 	INIT_GRA_PROP_BIND( Smooth,     "smooth"      );
 	INIT_GRA_PROP_BIND( Frameskip,     "frameskip"      );
+
+	_rb_define_module_function(module, "drawn_elements", graphicsDrawnElements);
+	_rb_define_module_function(module, "culled_elements", graphicsCulledElements);
+	_rb_define_module_function(module, "frame_timing", graphicsFrameTiming);
+	_rb_define_module_function(module, "reset_frame_timing", graphicsResetFrameTiming);
 }
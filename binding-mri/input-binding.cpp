@@ -131,7 +131,7 @@ RB_METHOD(inputModkeys) {
 
 RB_METHOD(inputStartTextInput) {
 	int limit = 4096;
-	rb_get_args(argc, argv, "|i", &limit RB_ARG_END);
+	rb_get_typed_args<0>(argc, argv, &limit);
 	SDL_LockMutex(EventThread::inputMut);
 	shState->rtData().acceptingTextInput = true;
 	shState->rtData().inputTextLimit = limit;
@@ -159,7 +159,7 @@ RB_METHOD(inputTextInput) {
 RB_METHOD(inputSetTextInput) {
 	RB_UNUSED_PARAM;
 	const char *newinput;
-	rb_get_args(argc, argv, "z", &newinput RB_ARG_END);
+	rb_get_typed_args(argc, argv, &newinput);
 	SDL_LockMutex(EventThread::inputMut);
 	shState->rtData().inputText = newinput;
 	SDL_UnlockMutex(EventThread::inputMut);
@@ -24,14 +24,14 @@ RB_METHOD(GetWindowPosition) {
 
 RB_METHOD(SetWindowPosition) {
 	int x, y;
-	rb_get_args(argc, argv, "ii", &x, &y);
+	rb_get_typed_args(argc, argv, &x, &y);
 	SDL_SetWindowPosition(shState->rtData().window, x, y);
 	return Qnil;
 }
 
 RB_METHOD(SetTitle) {
-	char* wintitle; //thx rkevin
-	rb_get_args(argc, argv, "z", &wintitle);
+	const char *wintitle; //thx rkevin
+	rb_get_typed_args(argc, argv, &wintitle);
 	SDL_SetWindowTitle(shState->rtData().window, wintitle);
 	return Qnil;
 }
@@ -42,7 +42,7 @@ RB_METHOD(SetTransparentColor) {
 	RB_UNUSED_PARAM;
 	Value colorObj;
 
-	rb_get_args(argc, argv, "o", &colorObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &colorObj);
 
 	Color *c = getPrivateDataCheck<Color>(colorObj, ColorType);
 
@@ -64,8 +64,8 @@ RB_METHOD(SetTransparentColor) {
 */
 
 RB_METHOD(SetIcon) {
-	char* path;
-	rb_get_args(argc, argv, "z", &path);
+	const char *path;
+	rb_get_typed_args(argc, argv, &path);
 	SDL_Surface* icon = IMG_Load(path);
 	if (!icon) {
 		rb_raise(rb_eRuntimeError, "Loading icon from path failed");
@@ -76,8 +76,8 @@ RB_METHOD(SetIcon) {
 
 RB_METHOD(SetWindowOpacity) {
 
-	float opacity;
-	rb_get_args(argc, argv, "f", &opacity);
+	double opacity;
+	rb_get_typed_args(argc, argv, &opacity);
 	SDL_SetWindowOpacity(shState->rtData().window, opacity);
 	return Qnil;
 }
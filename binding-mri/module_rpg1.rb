@@ -482,19 +482,15 @@ module RPG
       @snow_bitmap.fill_rect(1, 0, 4, 6, color2)
       @snow_bitmap.fill_rect(1, 2, 4, 2, color1)
       @snow_bitmap.fill_rect(2, 1, 2, 4, color1)
-      @sprites = []
-      for i in 1..40
-        sprite = Sprite.new(viewport)
-        sprite.z = 1000
-        sprite.visible = false
-        sprite.opacity = 0
-        @sprites.push(sprite)
-      end
+      @particles = ParticleSystem.new(viewport)
+      @particles.z = 1000
+      @particles.emit_rect = Rect.new(-50, -200, 800, 800)
+      @particles.opacity_start = 255
+      @particles.opacity_end = 64
+      @particles.max_particles = 0
     end
     def dispose
-      for sprite in @sprites
-        sprite.dispose
-      end
+      @particles.dispose
       @rain_bitmap.dispose
       @storm_bitmap.dispose
       @snow_bitmap.dispose
@@ -505,80 +501,60 @@ module RPG
       case @type
       when 1
         bitmap = @rain_bitmap
+        speed_x, speed_y, fade = -2, 16, 8
       when 2
         bitmap = @storm_bitmap
+        speed_x, speed_y, fade = -8, 16, 12
       when 3
         bitmap = @snow_bitmap
+        speed_x, speed_y, fade = -2, 8, 8
       else
         bitmap = nil
       end
-      for i in 1..40
-        sprite = @sprites[i]
-        if sprite != nil
-          sprite.visible = (i <= @max)
-          sprite.bitmap = bitmap
-        end
+      @particles.bitmap = bitmap
+      if bitmap != nil
+        @particles.velocity_x = speed_x
+        @particles.velocity_y = speed_y
+        # Frames until the opacity drops below 64
+        @particles.lifetime = (255 - 64) / fade + 1
+      else
+        @particles.clear
       end
+      update_spawn_rate
     end
     def ox=(ox)
       return if @ox == ox;
       @ox = ox
-      for sprite in @sprites
-        sprite.ox = @ox
-      end
+      @particles.ox = @ox
     end
     def oy=(oy)
       return if @oy == oy;
       @oy = oy
-      for sprite in @sprites
-        sprite.oy = @oy
-      end
+      @particles.oy = @oy
     end
     def max=(max)
       return if @max == max;
       @max = [[max, 0].max, 40].min
-      for i in 1..40
-        sprite = @sprites[i]
-        if sprite != nil
-          sprite.visible = (i <= @max)
-        end
-      end
+      @particles.max_particles = @max
+      update_spawn_rate
     end
     def update
       return if @type == 0
-      for i in 1..@max
-        sprite = @sprites[i]
-        if sprite == nil
-          break
-        end
-        if @type == 1
-          sprite.x -= 2
-          sprite.y += 16
-          sprite.opacity -= 8
-        end
-        if @type == 2
-          sprite.x -= 8
-          sprite.y += 16
-          sprite.opacity -= 12
-        end
-        if @type == 3
-          sprite.x -= 2
-          sprite.y += 8
-          sprite.opacity -= 8
-        end
-        x = sprite.x - @ox
-        y = sprite.y - @oy
-        if sprite.opacity < 64 or x < -50 or x > 750 or y < -300 or y > 500
-          sprite.x = rand(800) - 50 + @ox
-          sprite.y = rand(800) - 200 + @oy
-          sprite.opacity = 255
-        end
-      end
+      @particles.update
     end
     attr_reader :type
     attr_reader :max
     attr_reader :ox
     attr_reader :oy
+    private
+    # Keeps about 'max' particles alive
+    def update_spawn_rate
+      if @type == 0
+        @particles.spawn_rate = 0
+      else
+        @particles.spawn_rate = @max.to_f / @particles.lifetime
+      end
+    end
   end
 
   class Map
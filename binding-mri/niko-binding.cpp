@@ -3,6 +3,10 @@
 #include "sharedstate.h"
 #include "debugwriter.h"
 #include "eventthread.h"
+#include "ipcchannel.h"
+
+#include <string>
+#include <cstdio>
 
 #if defined _WIN32
 #define OS_W32
@@ -15,17 +19,8 @@
 		#define OS_LINUX
 	#endif
 
-	#include <fcntl.h>
-	#include <sys/stat.h>
-	#include <sys/types.h>
-	#ifdef OS_LINUX
-		#include <sys/inotify.h>
-	#endif
 	#include <unistd.h>
-	#include <cstdio>
-	#include <pwd.h>
-	#include <string>
-	#include <errno.h>
+	#include <limits.h>
 #endif
 
 #include <SDL2/SDL.h>
@@ -36,63 +31,43 @@ namespace syswm {
 #define NIKO_X (320 - 16)
 #define NIKO_Y ((13 * 16) * 2)
 
-#define BUFFER_SIZE 256
-
 static SDL_Thread *thread = NULL;
 static SDL_mutex *mutex = NULL;
-static volatile char message_buffer[BUFFER_SIZE];
-static volatile bool active = false;
-static volatile int message_len = 0;
-
-#ifdef LINUX
-	static std::string NIKO_PIPE_PATH = std::string(getpwuid(getuid())->pw_dir) + "/.oneshot-niko-pipe";
-	static volatile int out_pipe = -1;
-	void niko_cleanup_pipe()
-	{
-		unlink(NIKO_PIPE_PATH.c_str());
-		remove(NIKO_PIPE_PATH.c_str());
-	}
-#endif
+static std::string message;
+
+// Connected niko process, or NULL; guarded by mutex
+static IPCChannel *channel = NULL;
+static volatile bool accepting = false;
 
 int niko_server_thread(void *data)
 {
-	(void)data;
-#if defined OS_W32
-	HANDLE pipe = CreateNamedPipeW(L"\\\\.\\pipe\\oneshot-journal-to-game",
-	                               PIPE_ACCESS_OUTBOUND,
-	                               PIPE_TYPE_BYTE | PIPE_WAIT,
-	                               PIPE_UNLIMITED_INSTANCES,
-	                               BUFFER_SIZE,
-	                               BUFFER_SIZE,
-	                               0,
-	                               NULL);
-	for (;;) {
-		ConnectNamedPipe(pipe, NULL);
-		SDL_LockMutex(mutex);
-		DWORD written;
-		WriteFile(pipe, (const void*)message_buffer, BUFFER_SIZE, &written, NULL);
-		active = true;
-		SDL_UnlockMutex(mutex);
-		FlushFileBuffers(pipe);
-		DisconnectNamedPipe(pipe);
+	IPCChannel *pending = (IPCChannel*)data;
+
+	// Wait for the niko process to connect
+	if (!pending->accept(-1))
+	{
+		Debug() << "Niko process did not connect";
+		delete pending;
+		accepting = false;
+		return 0;
 	}
-	CloseHandle(pipe);
-#else
-	if (access(NIKO_PIPE_PATH.c_str(), F_OK) != -1) {
-		out_pipe = open(NIKO_PIPE_PATH.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-		SDL_LockMutex(mutex);
-		active = true;
-		if (message_len > 0)
-		{
-			if (write(out_pipe, (char*)message_buffer, message_len) == -1)
-			{
-				Debug() << "Failed to write to pipe!";
-			}
-		}
-		SDL_UnlockMutex(mutex);
+
+	SDL_LockMutex(mutex);
+	if (message.empty())
+	{
+		channel = pending;
 	}
+	else
+	{
+		// Position was decided before it got here
+		if (!pending->send(message))
+			Debug() << "Failed to write to niko's channel!";
+		delete pending;
+	}
+	accepting = false;
+	SDL_UnlockMutex(mutex);
+
 	return 0;
-#endif
 }
 
 RB_METHOD(nikoPrepare)
@@ -104,12 +79,47 @@ RB_METHOD(nikoPrepare)
 	SDL_VERSION(&syswindow.version);
 	SDL_GetWindowWMInfo(shState->rtData().window, &syswindow);
 
-#ifdef LINUX
+	// Clean up finished connection thread
+	if (thread != NULL && !accepting) {
+		SDL_WaitThread(thread, NULL);
+		thread = NULL;
+	}
+
+	if (thread != NULL || channel != NULL)
+		return Qnil;
+
+	message.clear();
+
+	IPCChannel *pending = new IPCChannel;
+	if (!pending->listen("oneshot-niko")) {
+		Debug() << "Cannot create channel to niko process";
+		delete pending;
+		return Qnil;
+	}
+
+#ifdef _WIN32
+	// Start process
+	WCHAR path[MAX_PATH];
+	WCHAR args[MAX_PATH];
+	GetModuleFileNameW(NULL, path, MAX_PATH);
+	PathRemoveFileSpecW(path);
+	wcscat(path, L"\\_______.exe");
+	wcscpy(args, L"_______.exe niko");
+	STARTUPINFOW si;
+	memset(&si, 0, sizeof(si));
+	si.cb = sizeof(si);
+	PROCESS_INFORMATION pi;
+	if (CreateProcessW(path, args, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+		CloseHandle(pi.hThread);
+		CloseHandle(pi.hProcess);
+	}
+#else
 	char path[PATH_MAX];
 	std::string journal;
 
 	// Get current path
 	if (getcwd(path, sizeof(path)) == NULL) {
+		delete pending;
 		return Qnil;
 	}
 
@@ -126,6 +136,11 @@ RB_METHOD(nikoPrepare)
 		exit(1);
 	}
 #endif
+
+	// Accept in the background, it can take a while to start up
+	accepting = true;
+	thread = SDL_CreateThread(niko_server_thread, "niko", pending);
+
 	return Qnil;
 }
 
@@ -138,67 +153,47 @@ RB_METHOD(nikoStart)
 	SDL_VERSION(&syswindow.version);
 	SDL_GetWindowWMInfo(shState->rtData().window, &syswindow);
 
-#ifdef _WIN32
 	// Calculate where to stick the window
+#ifdef _WIN32
 	POINT pos;
 	pos.x = NIKO_X;
 	pos.y = NIKO_Y;
 	ClientToScreen(syswindow.info.win.window, &pos);
-	// Start process
-	WCHAR path[MAX_PATH];
-	WCHAR args[MAX_PATH];
-	GetModuleFileNameW(NULL, path, MAX_PATH);
-	PathRemoveFileSpecW(path);
-	wcscat(path, L"\\_______.exe");
-	wsprintfW(args, L"_______.exe %d %d", pos.x, pos.y);
-	STARTUPINFOW si;
-	memset(&si, 0, sizeof(si));
-	si.cb = sizeof(si);
-	PROCESS_INFORMATION pi;
-	CreateProcessW(path, args, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+	int x = pos.x, y = pos.y;
 #else
-	// Calculate where to stick the window
 	int x, y; // Top-left area of client (hopefully)
 	SDL_GetWindowPosition(shState->rtData().window, &x, &y);
 	x += NIKO_X;
 	y += NIKO_Y;
-	char message[32];
-	sprintf(message, "%d,%d\n", x, y);
-
-	SDL_LockMutex(mutex);
-	message_len = strlen(message);
-	strcpy((char*)message_buffer, message);
-	SDL_UnlockMutex(mutex);
+#endif
+	char position[32];
+	sprintf(position, "%d,%d", x, y);
 
-	// Clean up connection thread
-	if (thread != NULL && out_pipe != -1) {
+	// Clean up finished connection thread
+	if (thread != NULL && !accepting) {
 		SDL_WaitThread(thread, NULL);
 		thread = NULL;
 	}
-	if (out_pipe == -1) {
-		// We don't have a pipe open, so spawn the connection thread
-		thread = SDL_CreateThread(niko_server_thread, "journal", NULL);
-	}
-	// Attempt to send it over the tubes
-	if (out_pipe != -1) {
-		// We have a connection, so send it over
-		if (write(out_pipe, (char*)message_buffer, message_len) <= 0) {
-			// In the case of an error, close
-			close(out_pipe);
-			out_pipe = -1;
-		}
+
+	SDL_LockMutex(mutex);
+	message = position;
+	// Attempt to send it over the tubes; if it isn't
+	// connected yet, the connection thread sends it
+	if (channel != NULL) {
+		if (!channel->send(message))
+			Debug() << "Failed to write to niko's channel!";
+		// It only ever needs the one message
+		delete channel;
+		channel = NULL;
 	}
-#endif
+	SDL_UnlockMutex(mutex);
+
 	return Qnil;
 }
 
 void nikoBindingInit()
 {
 	mutex = SDL_CreateMutex();
-#if defined __linux
-	mkfifo(NIKO_PIPE_PATH.c_str(), 0666);
-	atexit(niko_cleanup_pipe);
-#endif
 
 	VALUE module = rb_define_module("Niko");
 
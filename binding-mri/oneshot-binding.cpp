@@ -13,7 +13,7 @@ RB_METHOD(oneshotSetYesNo)
 	RB_UNUSED_PARAM;
 	const char *yes;
 	const char *no;
-	rb_get_args(argc, argv, "zz", &yes, &no RB_ARG_END);
+	rb_get_typed_args(argc, argv, &yes, &no);
 	shState->oneshot().setYesNo(yes, no);
 	return Qnil;
 }
@@ -59,7 +59,7 @@ RB_METHOD(oneshotAllowExit)
 {
 	RB_UNUSED_PARAM;
 	bool allowExit;
-	rb_get_args(argc, argv, "b", &allowExit RB_ARG_END);
+	rb_get_typed_args(argc, argv, &allowExit);
 	shState->oneshot().setAllowExit(allowExit);
 	return Qnil;
 }
@@ -68,7 +68,7 @@ RB_METHOD(oneshotExiting)
 {
 	RB_UNUSED_PARAM;
 	bool exiting;
-	rb_get_args(argc, argv, "b", &exiting RB_ARG_END);
+	rb_get_typed_args(argc, argv, &exiting);
 	shState->oneshot().setExiting(exiting);
 	return Qnil;
 }
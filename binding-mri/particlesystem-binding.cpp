@@ -0,0 +1,144 @@
+/*
+** particlesystem-binding.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particlesystem.h"
+#include "disposable-binding.h"
+#include "viewportelement-binding.h"
+#include "binding-util.h"
+#include "binding-types.h"
+
+DEF_TYPE(ParticleSystem);
+
+RB_METHOD(particleSystemInitialize)
+{
+	ParticleSystem *p = viewportElementInitialize<ParticleSystem>(argc, argv, self);
+
+	setPrivateData(self, p);
+
+	p->initDynAttribs();
+
+	wrapProperty(self, &p->getEmitRect(), "emit_rect", RectType);
+
+	return self;
+}
+
+RB_METHOD(particleSystemUpdate)
+{
+	RB_UNUSED_PARAM;
+
+	ParticleSystem *p = getPrivateData<ParticleSystem>(self);
+
+	GUARD_EXC( p->update(); )
+
+	return Qnil;
+}
+
+RB_METHOD(particleSystemEmit)
+{
+	ParticleSystem *p = getPrivateData<ParticleSystem>(self);
+
+	int count;
+	rb_get_typed_args(argc, argv, &count);
+
+	GUARD_EXC( p->emit(count); )
+
+	return Qnil;
+}
+
+RB_METHOD(particleSystemClear)
+{
+	RB_UNUSED_PARAM;
+
+	ParticleSystem *p = getPrivateData<ParticleSystem>(self);
+
+	GUARD_EXC( p->clear(); )
+
+	return Qnil;
+}
+
+RB_METHOD(particleSystemCount)
+{
+	RB_UNUSED_PARAM;
+
+	ParticleSystem *p = getPrivateData<ParticleSystem>(self);
+
+	int value = 0;
+	GUARD_EXC( value = p->getCount(); )
+
+	return rb_fix_new(value);
+}
+
+DEF_PROP_OBJ_REF(ParticleSystem, Bitmap, Bitmap,   "bitmap")
+DEF_PROP_OBJ_VAL(ParticleSystem, Rect,   EmitRect, "emit_rect")
+
+DEF_PROP_I(ParticleSystem, OX)
+DEF_PROP_I(ParticleSystem, OY)
+DEF_PROP_I(ParticleSystem, Opacity)
+DEF_PROP_I(ParticleSystem, BlendType)
+DEF_PROP_I(ParticleSystem, MaxParticles)
+DEF_PROP_I(ParticleSystem, Lifetime)
+DEF_PROP_I(ParticleSystem, LifetimeSpread)
+DEF_PROP_I(ParticleSystem, OpacityStart)
+DEF_PROP_I(ParticleSystem, OpacityEnd)
+
+DEF_PROP_F(ParticleSystem, SpawnRate)
+DEF_PROP_F(ParticleSystem, VelocityX)
+DEF_PROP_F(ParticleSystem, VelocityY)
+DEF_PROP_F(ParticleSystem, VelocitySpreadX)
+DEF_PROP_F(ParticleSystem, VelocitySpreadY)
+DEF_PROP_F(ParticleSystem, GravityX)
+DEF_PROP_F(ParticleSystem, GravityY)
+
+
+void
+particleSystemBindingInit()
+{
+	VALUE klass = rb_define_class("ParticleSystem", rb_cObject);
+	rb_define_alloc_func(klass, classAllocate<&ParticleSystemType>);
+
+	disposableBindingInit<ParticleSystem>     (klass);
+	viewportElementBindingInit<ParticleSystem>(klass);
+
+	_rb_define_method(klass, "initialize", particleSystemInitialize);
+	_rb_define_method(klass, "update",     particleSystemUpdate);
+	_rb_define_method(klass, "emit",       particleSystemEmit);
+	_rb_define_method(klass, "clear",      particleSystemClear);
+	_rb_define_method(klass, "count",      particleSystemCount);
+
+	INIT_PROP_BIND( ParticleSystem, Bitmap,          "bitmap"            );
+	INIT_PROP_BIND( ParticleSystem, EmitRect,        "emit_rect"         );
+	INIT_PROP_BIND( ParticleSystem, OX,              "ox"                );
+	INIT_PROP_BIND( ParticleSystem, OY,              "oy"                );
+	INIT_PROP_BIND( ParticleSystem, Opacity,         "opacity"           );
+	INIT_PROP_BIND( ParticleSystem, BlendType,       "blend_type"        );
+	INIT_PROP_BIND( ParticleSystem, SpawnRate,       "spawn_rate"        );
+	INIT_PROP_BIND( ParticleSystem, MaxParticles,    "max_particles"     );
+	INIT_PROP_BIND( ParticleSystem, VelocityX,       "velocity_x"        );
+	INIT_PROP_BIND( ParticleSystem, VelocityY,       "velocity_y"        );
+	INIT_PROP_BIND( ParticleSystem, VelocitySpreadX, "velocity_spread_x" );
+	INIT_PROP_BIND( ParticleSystem, VelocitySpreadY, "velocity_spread_y" );
+	INIT_PROP_BIND( ParticleSystem, GravityX,        "gravity_x"         );
+	INIT_PROP_BIND( ParticleSystem, GravityY,        "gravity_y"         );
+	INIT_PROP_BIND( ParticleSystem, Lifetime,        "lifetime"          );
+	INIT_PROP_BIND( ParticleSystem, LifetimeSpread,  "lifetime_spread"   );
+	INIT_PROP_BIND( ParticleSystem, OpacityStart,    "opacity_start"     );
+	INIT_PROP_BIND( ParticleSystem, OpacityEnd,      "opacity_end"       );
+}
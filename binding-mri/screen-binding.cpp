@@ -4,13 +4,14 @@
 #include "debugwriter.h"
 #include "config.h"
 #include "sharedstate.h"
-#include "pipe.h"
+#include "ipcchannel.h"
 
-static Pipe ipc;
+static IPCChannel ipc;
 
 static void start()
 {
-	ipc.open("oneshot-pipe", Pipe::Write);
+	if (!ipc.listen("oneshot-screen"))
+		rb_raise(rb_eRuntimeError, "Cannot create channel to screen process");
 
 	// Create process
 #if defined _WIN32
@@ -46,7 +47,8 @@ static void start()
 	}
 #endif
 
-	ipc.connect();
+	if (!ipc.accept(5000))
+		Debug() << "Screen process did not connect";
 }
 
 RB_METHOD(screenStart)
@@ -59,7 +61,7 @@ RB_METHOD(screenStart)
 RB_METHOD(screenFinish)
 {
 	RB_UNUSED_PARAM;
-	ipc.write("END", sizeof("END"));
+	ipc.send("END");
 	ipc.close();
 	return Qnil;
 }
@@ -68,10 +70,10 @@ RB_METHOD(screenSet)
 {
 	RB_UNUSED_PARAM;
 	const char *imageName;
-	rb_get_args(argc, argv, "z", &imageName RB_ARG_END);
-	if (!ipc.isOpen())
+	rb_get_typed_args(argc, argv, &imageName);
+	if (!ipc.isConnected())
 		start();
-	ipc.write(imageName, strlen(imageName) + 1);
+	ipc.send(imageName);
 	return Qnil;
 }
 
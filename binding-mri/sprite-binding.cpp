@@ -28,6 +28,8 @@
 #include "binding-util.h"
 #include "binding-types.h"
 
+#include <vector>
+
 DEF_TYPE(Sprite);
 
 RB_METHOD(spriteInitialize)
@@ -98,6 +100,78 @@ RB_METHOD(spriteHeight)
 	return rb_fix_new(value);
 }
 
+/* Reads 'perSprite' values per sprite out of the array
+ * at 'key' in 'attrs', returns null if the key is missing */
+template<typename T, typename ArgT>
+static const T *
+batchArray(VALUE attrs, const char *key, long count, long perSprite,
+           std::vector<T> &out, void (*conv)(VALUE, ArgT*, int))
+{
+	VALUE ary = rb_hash_aref(attrs, ID2SYM(rb_intern(key)));
+
+	if (NIL_P(ary))
+		return 0;
+
+	Check_Type(ary, T_ARRAY);
+
+	long size = count * perSprite;
+
+	if (RARRAY_LEN(ary) < size)
+		rb_raise(rb_eArgError, "%s: expected %ld values, got %ld",
+		         key, size, (long) RARRAY_LEN(ary));
+
+	out.resize(size);
+
+	for (long i = 0; i < size; ++i)
+	{
+		ArgT value;
+		conv(rb_ary_entry(ary, i), &value, 0);
+		out[i] = value;
+	}
+
+	return dataPtr(out);
+}
+
+/* Sprite.batch_set(sprites, attrs): 'attrs' maps attribute names
+ * (:x, :y, :z, :ox, :oy, :opacity, :zoom_x, :zoom_y, :angle) to
+ * arrays holding one value per sprite, and :src_rect to an array
+ * of 4 values (x, y, width, height) per sprite */
+RB_METHOD(spriteBatchSet)
+{
+	RB_UNUSED_PARAM;
+
+	VALUE spritesObj, attrs;
+	rb_get_typed_args<2>(argc, argv, &spritesObj, &attrs);
+
+	Check_Type(spritesObj, T_ARRAY);
+	Check_Type(attrs, T_HASH);
+
+	long count = RARRAY_LEN(spritesObj);
+	std::vector<Sprite*> sprites(count);
+
+	for (long i = 0; i < count; ++i)
+		sprites[i] = getPrivateDataCheck<Sprite>(rb_ary_entry(spritesObj, i), SpriteType);
+
+	std::vector<int> x, y, z, ox, oy, opacity, srcRect;
+	std::vector<float> zoomX, zoomY, angle;
+
+	SpriteBatch batch;
+	batch.x       = batchArray(attrs, "x",        count, 1, x,       rb_int_arg);
+	batch.y       = batchArray(attrs, "y",        count, 1, y,       rb_int_arg);
+	batch.z       = batchArray(attrs, "z",        count, 1, z,       rb_int_arg);
+	batch.ox      = batchArray(attrs, "ox",       count, 1, ox,      rb_int_arg);
+	batch.oy      = batchArray(attrs, "oy",       count, 1, oy,      rb_int_arg);
+	batch.opacity = batchArray(attrs, "opacity",  count, 1, opacity, rb_int_arg);
+	batch.zoomX   = batchArray(attrs, "zoom_x",   count, 1, zoomX,   rb_float_arg);
+	batch.zoomY   = batchArray(attrs, "zoom_y",   count, 1, zoomY,   rb_float_arg);
+	batch.angle   = batchArray(attrs, "angle",    count, 1, angle,   rb_float_arg);
+	batch.srcRect = batchArray(attrs, "src_rect", count, 4, srcRect, rb_int_arg);
+
+	GUARD_EXC( Sprite::batchSet(dataPtr(sprites), count, batch); )
+
+	return Qnil;
+}
+
 void
 spriteBindingInit()
 {
@@ -110,6 +184,8 @@ spriteBindingInit()
 
 	_rb_define_method(klass, "initialize", spriteInitialize);
 
+	rb_define_class_method(klass, "batch_set", spriteBatchSet);
+
 	INIT_PROP_BIND( Sprite, Bitmap,    "bitmap"     );
 	INIT_PROP_BIND( Sprite, SrcRect,   "src_rect"   );
 	INIT_PROP_BIND( Sprite, X,         "x"          );
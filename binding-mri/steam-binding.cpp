@@ -23,7 +23,7 @@ RB_METHOD(steamUnlock)
 	RB_UNUSED_PARAM;
 
     const char *name;
-	rb_get_args(argc, argv, "z", &name RB_ARG_END);
+	rb_get_typed_args(argc, argv, &name);
 
 #ifdef STEAM
 	shState->steam().unlock(name);
@@ -36,7 +36,7 @@ RB_METHOD(steamLock)
 	RB_UNUSED_PARAM;
 
 	const char *name;
-	rb_get_args(argc, argv, "z", &name RB_ARG_END);
+	rb_get_typed_args(argc, argv, &name);
 
 #ifdef STEAM
 	shState->steam().lock(name);
@@ -49,7 +49,7 @@ RB_METHOD(steamUnlocked)
 	RB_UNUSED_PARAM;
 
 	const char *name;
-	rb_get_args(argc, argv, "z", &name RB_ARG_END);
+	rb_get_typed_args(argc, argv, &name);
 
 #ifdef STEAM
 	return shState->steam().isUnlocked(name) ? Qtrue : Qfalse;
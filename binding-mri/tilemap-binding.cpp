@@ -37,7 +37,7 @@ RB_METHOD(tilemapAutotilesSet)
 	int i;
 	VALUE bitmapObj;
 
-	rb_get_args(argc, argv, "io", &i, &bitmapObj RB_ARG_END);
+	rb_get_typed_args(argc, argv, &i, &bitmapObj);
 
 	Bitmap *bitmap = getPrivateDataCheck<Bitmap>(bitmapObj, BitmapType);
 
@@ -74,7 +74,7 @@ RB_METHOD(tilemapInitialize)
 	int xSize = 21;
 	int ySize = 16;
 
-	rb_get_args(argc, argv, "|oii", &viewportObj, &xSize, &ySize RB_ARG_END);
+	rb_get_typed_args<0>(argc, argv, &viewportObj, &xSize, &ySize);
 
 	if (!NIL_P(viewportObj))
 		viewport = getPrivateDataCheck<Viewport>(viewportObj, ViewportType);
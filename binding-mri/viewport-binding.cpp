@@ -44,7 +44,7 @@ RB_METHOD(viewportInitialize)
 		VALUE rectObj;
 		Rect *rect;
 
-		rb_get_args(argc, argv, "o", &rectObj RB_ARG_END);
+		rb_get_typed_args(argc, argv, &rectObj);
 
 		rect = getPrivateDataCheck<Rect>(rectObj, RectType);
 
@@ -54,7 +54,7 @@ RB_METHOD(viewportInitialize)
 	{
 		int x, y, width, height;
 
-		rb_get_args(argc, argv, "iiii", &x, &y, &width, &height RB_ARG_END);
+		rb_get_typed_args(argc, argv, &x, &y, &width, &height);
 
 		v = new Viewport(x, y, width, height);
 	}
@@ -80,7 +80,7 @@ RB_METHOD(setRGBOffset)
 {
 	double x, y, z;
 	double x2, y2, z2;
-	rb_get_args(argc, argv, "ffffff", &x, &y, &z, &x2, &y2, &z2);
+	rb_get_typed_args(argc, argv, &x, &y, &z, &x2, &y2, &z2);
 
 	Viewport *v = getPrivateData<Viewport>(self);
 
@@ -93,7 +93,7 @@ RB_METHOD(setRGBOffset)
 RB_METHOD(setCubicTime)
 {
 	double time;
-	rb_get_args(argc, argv, "f", &time);
+	rb_get_typed_args(argc, argv, &time);
 
 	Viewport *v = getPrivateData<Viewport>(self);
 
@@ -105,7 +105,7 @@ RB_METHOD(setCubicTime)
 RB_METHOD(setBinaryStrength)
 {
 	double strength;
-	rb_get_args(argc, argv, "f", &strength);
+	rb_get_typed_args(argc, argv, &strength);
 
 	Viewport *v = getPrivateData<Viewport>(self);
 
@@ -117,7 +117,7 @@ RB_METHOD(setBinaryStrength)
 RB_METHOD(setWaterTime)
 {
 	double time;
-	rb_get_args(argc, argv, "f", &time);
+	rb_get_typed_args(argc, argv, &time);
 
 	Viewport *v = getPrivateData<Viewport>(self);
 
@@ -129,7 +129,7 @@ RB_METHOD(setWaterTime)
 RB_METHOD(setZoom)
 {
 	double x, y;
-	rb_get_args(argc, argv, "ff", &x, &y);
+	rb_get_typed_args(argc, argv, &x, &y);
 
 	Viewport *v = getPrivateData<Viewport>(self);
 
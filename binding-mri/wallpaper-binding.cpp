@@ -4,6 +4,9 @@
 #include <vector>
 #include <map>
 
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_mutex.h>
+
 #include <boost/algorithm/string/replace.hpp>
 
 #include "etc.h"
@@ -33,6 +36,9 @@
 		#include <gio/gio.h>
 		#include <xfconf/xfconf.h>
 		#include <unistd.h>
+		#include <spawn.h>
+		#include <sys/wait.h>
+		#include <errno.h>
 		#include <algorithm>
 		#include <iostream>
 		#include <string>
@@ -53,9 +59,47 @@
 		static std::map<std::string, bool> defBlurs;
 		// Fallback settings
 		static std::string fallbackPath;
+
+		extern char **environ;
 	#endif
 #endif
 
+/* Desktop settings are changed on a worker thread, as that can take
+ * long (child processes, D-Bus round trips) and would otherwise stall
+ * the game. There is only a single pending request; a new one replaces
+ * it if the worker hasn't picked it up yet, so a burst of changes only
+ * applies the last one. All desktop state above is only touched by the
+ * worker once it exists */
+struct WallpaperRequest
+{
+	enum Type
+	{
+		None,
+		Set,
+		Reset
+	};
+
+	Type type;
+	std::string name;
+	int color;
+
+	WallpaperRequest()
+	    : type(None),
+	      color(0)
+	{}
+};
+
+static SDL_Thread *worker = 0;
+static SDL_mutex *workerMutex = 0;
+static SDL_cond *workerCond = 0;
+static bool workerQuit = false;
+static bool workerBusy = false;
+static WallpaperRequest pending;
+
+/* Outcome of the last finished request:
+ * -1 = none yet, 0 = failed, 1 = succeeded */
+static int lastResult = -1;
+
 #ifdef __linux__
 	void desktopEnvironmentInit()
 	{
@@ -164,14 +208,35 @@
 			fallbackPath = std::string(getenv("HOME")) + "/Desktop/ONESHOT_hint.png";
 		}
 	}
+
+	/* Runs a program directly instead of through a shell,
+	 * and waits for it. Returns its exit status, or -1 */
+	static int runProgram(const std::vector<std::string> &args)
+	{
+		std::vector<char*> argv;
+
+		for (size_t i = 0; i < args.size(); ++i)
+			argv.push_back(const_cast<char*>(args[i].c_str()));
+
+		argv.push_back(0);
+
+		pid_t pid;
+
+		if (posix_spawnp(&pid, argv[0], 0, 0, &argv[0], environ) != 0)
+			return -1;
+
+		int status;
+
+		while (waitpid(pid, &status, 0) < 0)
+			if (errno != EINTR)
+				return -1;
+
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
 #endif
 
-RB_METHOD(wallpaperSet)
+static bool applyWallpaper(const std::string &name, int color)
 {
-	RB_UNUSED_PARAM;
-	const char *name;
-	int color;
-	rb_get_args(argc, argv, "zi", &name, &color RB_ARG_END);
 	std::string path;
 #ifdef _WIN32
 	path = shState->config().gameFolder + "\\Wallpaper\\" + name + ".bmp";
@@ -194,6 +259,7 @@ RB_METHOD(wallpaperSet)
 	int colorId = COLOR_BACKGROUND;
 	WCHAR zero[2] = L"0";
 	DWORD zeroSize = 4;
+	bool ok = false;
 
 	HKEY hKey = NULL;
 	if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", 0, KEY_READ, &hKey) != ERROR_SUCCESS)
@@ -239,9 +305,13 @@ RB_METHOD(wallpaperSet)
 	// Set the color
 	if (!SetSysColors(1, &colorId, (const COLORREF *)&color))
 		goto end;
+
+	ok = true;
 end:
 	if (hKey)
 		RegCloseKey(hKey);
+
+	return ok;
 #else
 	std::string nameFix(name);
 	std::size_t found = nameFix.find("w32");
@@ -258,10 +328,11 @@ end:
 			isCached = true;
 		}
 		MacDesktop::ChangeBackground(shState->config().gameFolder + path, ((color >> 16) & 0xFF) / 255.0, ((color >> 8) & 0xFF) / 255.0, (color & 0xFF) / 255.0);
+		return true;
 	#else
 		char gameDir[PATH_MAX];
 		if (getcwd(gameDir, sizeof(gameDir)) == NULL) {
-			return Qnil;
+			return false;
 		}
 		std::string gameDirStr(gameDir);
 		desktopEnvironmentInit();
@@ -276,6 +347,7 @@ end:
 			} else {
 				g_settings_set_string(bgsetting, "picture-filename", (gameDirStr + path).c_str());
 			}
+			return true;
 		} else if (desktop == "xfce") {
 			int r = (color >> 16) & 0xFF;
 			int g = (color >> 8) & 0xFF;
@@ -292,17 +364,29 @@ end:
 			GPtrArray *colorArr = g_ptr_array_sized_new(4);
 			GType colorArrType = g_type_from_name("GPtrArray_GValue_");
 			if (!colorArrType) {
-				std::stringstream colorCommand;
-				colorCommand << "xfconf-query -c xfce4-desktop -n -p " << optionColor
-							 << " -t uint -t uint -t uint -t uint -s " << ub
-							 << " -s " << ug << " -s " << ub << " -s " << alpha;
-				int colorCommandRes = system(colorCommand.str().c_str());
+				std::vector<std::string> colorCommand;
+				colorCommand.push_back("xfconf-query");
+				colorCommand.push_back("-c");
+				colorCommand.push_back("xfce4-desktop");
+				colorCommand.push_back("-n");
+				colorCommand.push_back("-p");
+				colorCommand.push_back(optionColor);
+				for (int i = 0; i < 4; ++i) {
+					colorCommand.push_back("-t");
+					colorCommand.push_back("uint");
+				}
+				const unsigned int channels[] = { ur, ug, ub, alpha };
+				for (int i = 0; i < 4; ++i) {
+					colorCommand.push_back("-s");
+					colorCommand.push_back(std::to_string(channels[i]));
+				}
+				int colorCommandRes = runProgram(colorCommand);
 				defColorExists = xfconf_channel_get_property(bgchannel, optionColor.c_str(), &defColor);
 				colorArrType = g_type_from_name("GPtrArray_GValue_");
 				if (!colorArrType) {
 					// Let's do some debug output here and skip changing the color
 					Debug() << "WALLPAPER ERROR: xfconf-query call returned" << colorCommandRes;
-					return Qnil;
+					return false;
 				}
 			}
 			g_value_init(&colorValue, colorArrType);
@@ -323,14 +407,14 @@ end:
 			g_ptr_array_add(colorArr, vb);
 			g_ptr_array_add(colorArr, va);
 			g_value_set_boxed(&colorValue, colorArr);
-			xfconf_channel_set_property(bgchannel, optionColor.c_str(), &colorValue);
+			return xfconf_channel_set_property(bgchannel, optionColor.c_str(), &colorValue);
 		} else if (desktop == "kde") {
-			std::stringstream command;
+			std::stringstream script;
 			std::string concatPath(gameDirStr + path);
 			boost::replace_all(concatPath, "\\", "\\\\");
 			boost::replace_all(concatPath, "\"", "\\\"");
 			boost::replace_all(concatPath, "'", "\\x27");
-			command << "qdbus org.kde.plasmashell /PlasmaShell org.kde.PlasmaShell.evaluateScript 'string:" <<
+			script << "string:" <<
 				"var allDesktops = desktops();" <<
 				"for (var i = 0, l = allDesktops.length; i < l; ++i) {" <<
 					"var d = allDesktops[i];" <<
@@ -344,29 +428,37 @@ end:
 						std::to_string((color >> 8) & 0xFF) << "\", \"" <<
 						std::to_string(color & 0xFF) <<
 					"\"]);" <<
-				"}" <<
-			"'";
-			Debug() << "Wallpaper command:" << command.str();
-			int result = system(command.str().c_str());
+				"}";
+			Debug() << "Wallpaper script:" << script.str();
+			std::vector<std::string> command;
+			command.push_back("qdbus");
+			command.push_back("org.kde.plasmashell");
+			command.push_back("/PlasmaShell");
+			command.push_back("org.kde.PlasmaShell.evaluateScript");
+			command.push_back(script.str());
+			int result = runProgram(command);
 			Debug() << "Result:" << result;
+			return result == 0;
 		} else {
 			std::ifstream srcHint(gameDirStr + path);
 			std::ofstream dstHint(fallbackPath);
 			dstHint << srcHint.rdbuf();
+			bool ok = srcHint.is_open() && dstHint.good();
 			srcHint.close();
 			dstHint.close();
+			return ok;
 		}
 	#endif
 #endif
-	return Qnil;
 }
 
-RB_METHOD(wallpaperReset)
+static bool restoreWallpaper()
 {
-	RB_UNUSED_PARAM;
 #ifdef _WIN32
+	bool ok = true;
 	if (isCached) {
 		int colorId = COLOR_BACKGROUND;
+		ok = false;
 		HKEY hKey = NULL;
 		if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", 0, KEY_WRITE, &hKey) != ERROR_SUCCESS)
 			goto end;
@@ -385,13 +477,17 @@ RB_METHOD(wallpaperReset)
 		// Set the color
 		if (!SetSysColors(1, &colorId, (const COLORREF *)&oldcolor))
 			goto end;
+
+		ok = true;
 	end:
 		if (hKey)
 			RegCloseKey(hKey);
 	}
+	return ok;
 #else
 	#ifdef __APPLE__
 		MacDesktop::ResetBackground();
+		return true;
 	#else
 		desktopEnvironmentInit();
 		if (desktop == "cinnamon" || desktop == "gnome" || desktop == "mate" || desktop == "deepin") {
@@ -403,6 +499,7 @@ RB_METHOD(wallpaperReset)
 			g_settings_set_string(bgsetting, "picture-options", defPictureOptions.c_str());
 			g_settings_set_string(bgsetting, "primary-color", defPrimaryColor.c_str());
 			g_settings_set_string(bgsetting, "color-shading-type", defColorShading.c_str());
+			return true;
 		} else if (desktop == "xfce") {
 			if (defColorExists) {
 				xfconf_channel_set_property(bgchannel, optionColor.c_str(), &defColor);
@@ -424,34 +521,35 @@ RB_METHOD(wallpaperReset)
 			} else {
 				xfconf_channel_set_int(bgchannel, optionColorStyle.c_str(), defColorStyle);
 			}
+			return true;
 		} else if (desktop == "kde") {
-			std::stringstream command;
-			command << "qdbus org.kde.plasmashell /PlasmaShell org.kde.PlasmaShell.evaluateScript 'string:" <<
+			std::stringstream script;
+			script << "string:" <<
 					"var allDesktops = desktops();" <<
 					"var data = {";
 			// Plugin, picture, color, mode, blur
 			for (auto const& x : defPlugins) {
-				command << "\"" << x.first << "\": {"
+				script << "\"" << x.first << "\": {"
 						<< "plugin: \"" << x.second << "\"";
 				if (defPictures.find(x.first) != defPictures.end()) {
 					std::string picture = defPictures[x.first];
 					boost::replace_all(picture, "\\", "\\\\");
 					boost::replace_all(picture, "\"", "\\\"");
 					boost::replace_all(picture, "'", "\\x27");
-					command << ", picture: \"" << picture << "\"";
+					script << ", picture: \"" << picture << "\"";
 				}
 				if (defColors.find(x.first) != defColors.end()) {
-					command << ", color: \"" << defColors[x.first] << "\"";
+					script << ", color: \"" << defColors[x.first] << "\"";
 				}
 				if (defModes.find(x.first) != defModes.end()) {
-					command << ", mode: \"" << defModes[x.first] << "\"";
+					script << ", mode: \"" << defModes[x.first] << "\"";
 				}
 				if (defBlurs.find(x.first) != defBlurs.end() && defBlurs[x.first]) {
-					command << ", blur: true";
+					script << ", blur: true";
 				}
-				command << "},";
+				script << "},";
 			}
-			command << "\"no\": {}};" <<
+			script << "\"no\": {}};" <<
 				"for (var i = 0, l = allDesktops.length; i < l; ++i) {" <<
 					"var d = allDesktops[i];" <<
 					"var dat = data[d.id];" <<
@@ -469,21 +567,164 @@ RB_METHOD(wallpaperReset)
 					"if (dat.blur) {" <<
 						"d.writeConfig(\"Blur\", dat.blur);" <<
 					"}" <<
-				"}" <<
-			"'";
-			Debug() << "Reset wallpaper command:" << command.str();
-			int result = system(command.str().c_str());
+				"}";
+			Debug() << "Reset wallpaper script:" << script.str();
+			std::vector<std::string> command;
+			command.push_back("qdbus");
+			command.push_back("org.kde.plasmashell");
+			command.push_back("/PlasmaShell");
+			command.push_back("org.kde.PlasmaShell.evaluateScript");
+			command.push_back(script.str());
+			int result = runProgram(command);
 			Debug() << "Reset result:" << result;
+			return result == 0;
 		} else {
 			if (remove(fallbackPath.c_str()) != 0) {
 				Debug() << "Failed to delete:" << fallbackPath;
+				return false;
 			}
+			return true;
 		}
 	#endif
 #endif
+}
+
+static bool runRequest(const WallpaperRequest &req)
+{
+	if (req.type == WallpaperRequest::Set)
+		return applyWallpaper(req.name, req.color);
+
+	return restoreWallpaper();
+}
+
+static int wallpaperWorkerFun(void *)
+{
+	SDL_LockMutex(workerMutex);
+
+	for (;;)
+	{
+		while (!workerQuit && pending.type == WallpaperRequest::None)
+			SDL_CondWait(workerCond, workerMutex);
+
+		/* A request made right before quitting (eg. the
+		 * reset on exit) is still carried out */
+		if (pending.type == WallpaperRequest::None)
+			break;
+
+		WallpaperRequest req = pending;
+		pending = WallpaperRequest();
+		workerBusy = true;
+
+		SDL_UnlockMutex(workerMutex);
+
+		bool ok = runRequest(req);
+
+		SDL_LockMutex(workerMutex);
+
+		workerBusy = false;
+		lastResult = ok ? 1 : 0;
+	}
+
+	SDL_UnlockMutex(workerMutex);
+
+	return 0;
+}
+
+static void queueRequest(const WallpaperRequest &req)
+{
+	if (!workerMutex)
+	{
+		workerMutex = SDL_CreateMutex();
+		workerCond = SDL_CreateCond();
+		worker = SDL_CreateThread(wallpaperWorkerFun, "wallpaper", 0);
+
+		if (!worker)
+			Debug() << "Failed to start wallpaper worker:" << SDL_GetError();
+	}
+
+	if (!worker)
+	{
+		/* Nothing to hand it to, do it right away */
+		bool ok = runRequest(req);
+
+		SDL_LockMutex(workerMutex);
+		lastResult = ok ? 1 : 0;
+		SDL_UnlockMutex(workerMutex);
+
+		return;
+	}
+
+	SDL_LockMutex(workerMutex);
+
+	if (pending.type != WallpaperRequest::None)
+		Debug() << "Wallpaper request superseded before it was applied";
+
+	pending = req;
+	SDL_CondSignal(workerCond);
+
+	SDL_UnlockMutex(workerMutex);
+}
+
+RB_METHOD(wallpaperSet)
+{
+	RB_UNUSED_PARAM;
+	const char *name;
+	int color;
+	rb_get_typed_args(argc, argv, &name, &color);
+
+	WallpaperRequest req;
+	req.type = WallpaperRequest::Set;
+	req.name = name;
+	req.color = color;
+
+	queueRequest(req);
+
 	return Qnil;
 }
 
+RB_METHOD(wallpaperReset)
+{
+	RB_UNUSED_PARAM;
+
+	WallpaperRequest req;
+	req.type = WallpaperRequest::Reset;
+
+	queueRequest(req);
+
+	return Qnil;
+}
+
+RB_METHOD(wallpaperBusy)
+{
+	RB_UNUSED_PARAM;
+
+	if (!workerMutex)
+		return Qfalse;
+
+	SDL_LockMutex(workerMutex);
+	bool busy = workerBusy || pending.type != WallpaperRequest::None;
+	SDL_UnlockMutex(workerMutex);
+
+	return rb_bool_new(busy);
+}
+
+RB_METHOD(wallpaperLastResult)
+{
+	RB_UNUSED_PARAM;
+
+	if (!workerMutex)
+		return Qnil;
+
+	SDL_LockMutex(workerMutex);
+	int result = lastResult;
+	SDL_UnlockMutex(workerMutex);
+
+	if (result < 0)
+		return Qnil;
+
+	return rb_bool_new(result);
+}
+
 void wallpaperBindingInit()
 {
 	VALUE module = rb_define_module("Wallpaper");
@@ -491,14 +732,36 @@ void wallpaperBindingInit()
 	// Functions
 	_rb_define_module_function(module, "set", wallpaperSet);
 	_rb_define_module_function(module, "reset", wallpaperReset);
+	_rb_define_module_function(module, "busy?", wallpaperBusy);
+	_rb_define_module_function(module, "last_result", wallpaperLastResult);
 }
 
-#ifdef __linux__
 void wallpaperBindingTerminate()
 {
+	if (worker)
+	{
+		SDL_LockMutex(workerMutex);
+		workerQuit = true;
+		SDL_CondSignal(workerCond);
+		SDL_UnlockMutex(workerMutex);
+
+		/* Lets any pending request finish first */
+		SDL_WaitThread(worker, 0);
+		worker = 0;
+	}
+
+	if (workerMutex)
+	{
+		SDL_DestroyCond(workerCond);
+		SDL_DestroyMutex(workerMutex);
+		workerCond = 0;
+		workerMutex = 0;
+	}
+
+#ifdef __linux__
 	// Clean up.
 	if (desktop == "xfce") {
 		xfconf_shutdown();
 	}
-}
 #endif
+}
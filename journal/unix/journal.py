@@ -1,6 +1,6 @@
 # -*- coding: utf-8 -*-
 
-import os, sys, time
+import os, sys, time, socket, struct
 
 from PyQt5.QtCore import Qt, QEvent, QThread, pyqtSignal, QRect, QRectF, QTimer, QPoint
 from PyQt5.QtWidgets import QApplication, QWidget, QDesktopWidget, QLabel
@@ -15,13 +15,81 @@ def get_documents_path():
 	else:
 		return os.path.expanduser('~/Documents')
 
-def get_pipe_path(mode='journal'):
+def get_channel_dir(name):
+	# Must match endpointDir() in the game's IPCChannel
+	runtime = os.environ.get('XDG_RUNTIME_DIR')
+	home = os.environ.get('HOME')
+	path = None
+	if runtime: path = runtime + '/oneshot'
+	elif home: path = home + '/.oneshot'
+	# Too long for a socket path (with '/', '.sock' and the terminator)
+	max_len = 104 if sys.platform == 'darwin' else 108
+	if path is None or len(path) + len(name) + 7 > max_len:
+		tmp = '/var/tmp' if sys.platform == 'darwin' else '/tmp'
+		path = '{}/oneshot-{}'.format(tmp, os.getuid())
+	return path
+
+def get_channel_path(mode='journal'):
+	name = 'oneshot-niko' if mode == 'niko' else 'oneshot-journal'
 	if sys.platform == 'win32':
-		return '\\\\.\\pipe\\oneshot-journal-to-game'
-	else:
-		if mode == 'niko':
-			return os.path.expanduser('~/.oneshot-niko-pipe')
-		return os.path.expanduser('~/.oneshot-pipe')
+		return '\\\\.\\pipe\\' + name
+	return get_channel_dir(name) + '/' + name + '.sock'
+
+def channel_is_private(path):
+	# Only trust a directory that is ours and nobody else can enter
+	try: st = os.lstat(os.path.dirname(path))
+	except OSError: return False
+	return st.st_uid == os.getuid() and (st.st_mode & 0o077) == 0
+
+class Channel:
+	"""Client end of the game's IPCChannel: every message is
+	prefixed with its length as a native endian 32 bit integer"""
+
+	def __init__(self, path):
+		self.path = path
+		self.conn = None
+
+	def connect(self):
+		# Retry until the game creates the channel
+		while True:
+			try:
+				if sys.platform == 'win32':
+					self.conn = open(self.path, 'r+b', buffering=0)
+				else:
+					if not channel_is_private(self.path): raise OSError()
+					self.conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+					self.conn.connect(self.path)
+				return
+			except OSError:
+				self.close()
+				time.sleep(0.1)
+
+	def read_exact(self, size):
+		data = b''
+		while len(data) < size:
+			try:
+				if sys.platform == 'win32': chunk = self.conn.read(size - len(data))
+				else: chunk = self.conn.recv(size - len(data))
+			except OSError:
+				chunk = None
+			if not chunk: return None
+			data += chunk
+		return data
+
+	def receive(self):
+		"""Next message, or None if the game went away"""
+		header = self.read_exact(4)
+		if header is None: return None
+		size, = struct.unpack('=I', header)
+		if size == 0: return ''
+		payload = self.read_exact(size)
+		if payload is None: return None
+		return payload.decode('utf-8', 'replace')
+
+	def close(self):
+		if self.conn is not None:
+			self.conn.close()
+			self.conn = None
 
 left_close = False
 if sys.platform == 'darwin': left_close = True
@@ -29,67 +97,46 @@ if sys.platform == 'darwin': left_close = True
 try: base_path = sys._MEIPASS
 except AttributeError: base_path = os.path.abspath('.')
 
-class PipeThread(QThread):
+class ChannelThread(QThread):
 	def __init__(self, *args, **kwargs):
-		self.pipe = kwargs['pipe']
-		del kwargs['pipe']
+		self.channel = Channel(kwargs['path'])
+		del kwargs['path']
 		super().__init__(*args, **kwargs)
 
-class WatchPipe(PipeThread):
+class WatchChannel(ChannelThread):
 	change_image = pyqtSignal(str)
 
 	def run(self):
 		while True:
 			self.change_image.emit('default_en')
-			while not os.path.exists(self.pipe): time.sleep(0.1)
+			self.channel.connect()
 
-			pipe = open(self.pipe, 'r')
-			pipe.flush()
+			while True:
+				message = self.channel.receive()
+				if message is None: break # Game closed, wait for the next one
+				# An empty message tells the journal to close
+				if message == '': self.change_image.emit('CLOSE')
+				else: self.change_image.emit(message)
 
-			was_nondefault = False
+			self.channel.close()
 
-			while os.path.exists(self.pipe): # Make sure the file still exists and wasn't cleaned up by SyngleChance
-				message = os.read(pipe.fileno(), 256)
-				if len(message) > 0:
-					m = message.decode()
-					if m != 'default_en':
-						was_nondefault = True
-					self.change_image.emit(m)
-				else:
-					try:
-						st = os.stat(self.pipe)
-						if st.st_size == 0 and was_nondefault:
-							self.change_image.emit('CLOSE')
-					except FileNotFoundError:
-						pass
-
-					time.sleep(0.05)
-
-class AnimationTimer(PipeThread):
+class AnimationTimer(ChannelThread):
 	next_frame = pyqtSignal()
 	start_animation = pyqtSignal(int, int)
 
 	def run(self):
 		while True:
-			while not os.path.exists(self.pipe): time.sleep(0.1)
-
-			pipe = open(self.pipe, 'r')
-			pipe.flush()
-
-			while os.path.exists(self.pipe): # Make sure the file still exists and wasn't cleaned up by SyngleChance
-				message = os.read(pipe.fileno(), 256)
-				if len(message) > 0:
-					m = message.decode()
-					if not ',' in m: pass
-					last_line = m.splitlines()[-1]
-					x, y = last_line.split(',')
-					self.start_animation.emit(int(x), int(y))
-
-					while True:
-						self.next_frame.emit()
-						time.sleep(1.0 / 60)
-					
-				time.sleep(0.05)
+			self.channel.connect()
+			message = self.channel.receive()
+			self.channel.close()
+			if message is None or not ',' in message: continue
+
+			x, y = message.split(',')
+			self.start_animation.emit(int(x), int(y))
+
+			while True:
+				self.next_frame.emit()
+				time.sleep(1.0 / 60)
 
 class Journal(QWidget):
 	def __init__(self, *args, **kwargs):
@@ -203,11 +250,9 @@ class Niko(QWidget):
 if __name__ == '__main__':
 	app = QApplication(sys.argv)
 
-	pipe_path = get_pipe_path()
 	if len(sys.argv) == 2 and sys.argv[1] == 'niko':
 		# "Niko-leaves-the-screen" mode.
-		pipe_path = get_pipe_path('niko')
-		thread = AnimationTimer(pipe = pipe_path)
+		thread = AnimationTimer(path = get_channel_path('niko'))
 
 		niko = Niko(screen_height = app.primaryScreen().size().height(), app = app, thread = thread)
 
@@ -226,18 +271,8 @@ if __name__ == '__main__':
 				lang = lang[lang.find('[') + 1:lang.find(']')]
 				if lang == 'en_US': lang = 'en'
 				journal.change_image('save_' + lang)
-		thread = WatchPipe(pipe = pipe_path)
+		thread = WatchChannel(path = get_channel_path())
 		thread.change_image.connect(journal.change_image)
 		thread.start()
 
-	if not os.path.exists(pipe_path):
-		pipe_file = open(pipe_path, 'w+')
-		pipe_file.close()
-
 	app.exec_()
-
-	try:
-		os.remove(pipe_path)
-	except:
-		# Most likely due to the file being in use, ignore.
-		pass
@@ -109,46 +109,82 @@ LRESULT CALLBACK journal_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return 0;
 }
 
+// Reads exactly 'size' bytes, false if the game went away
+static BOOL read_exact(HANDLE pipe, void *data, DWORD size)
+{
+    DWORD total = 0;
+    DWORD len;
+
+    while (total < size) {
+        if (!ReadFile(pipe, (char*)data + total, size - total, &len, NULL) || len == 0)
+            return FALSE;
+        total += len;
+    }
+    return TRUE;
+}
+
+// Reads one length prefixed message into 'message', false if the game went away.
+// Messages too long for the buffer are skipped.
+static BOOL read_message(HANDLE pipe, char *message, BOOL *fits)
+{
+    char skip[IN_BUFFER_SIZE];
+    UINT32 size;
+
+    if (!read_exact(pipe, &size, sizeof(size)))
+        return FALSE;
+
+    *fits = size < IN_BUFFER_SIZE;
+    if (*fits) {
+        if (!read_exact(pipe, message, size))
+            return FALSE;
+        message[size] = 0;
+        return TRUE;
+    }
+
+    while (size > 0) {
+        DWORD chunk = size < IN_BUFFER_SIZE ? size : IN_BUFFER_SIZE;
+        if (!read_exact(pipe, skip, chunk))
+            return FALSE;
+        size -= chunk;
+    }
+    return TRUE;
+}
+
 // IPC thread
 DWORD WINAPI ipc_thread(LPVOID lpParam)
 {
     (void)lpParam;
 
     char message[IN_BUFFER_SIZE];
-    DWORD len;
-
-    HANDLE pipe = CreateNamedPipeW(L"\\\\.\\pipe\\oneshot-game-to-journal",
-                                   PIPE_ACCESS_INBOUND,
-                                   PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
-                                   PIPE_UNLIMITED_INSTANCES,
-                                   IN_BUFFER_SIZE,
-                                   IN_BUFFER_SIZE,
-                                   0,
-                                   NULL);
+    BOOL fits;
 
     for (;;) {
-        if (!ConnectNamedPipe(pipe, NULL))
+        // The game creates the channel once it has something to show
+        HANDLE pipe = CreateFileW(L"\\\\.\\pipe\\oneshot-journal",
+                                  GENERIC_READ | GENERIC_WRITE,
+                                  0,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  0,
+                                  NULL);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            Sleep(100);
             continue;
-        for (;;) {
-            if (ReadFile(pipe, (void*)message, IN_BUFFER_SIZE, &len, NULL)
-                    && len == IN_BUFFER_SIZE)
-            {
-                WaitForSingleObject(image_mutex, INFINITE);
-                if (*message == 0) {
-                    exit(0);
-                }
-                loadImage(message);
-                InvalidateRect(window, NULL, FALSE);
-                ReleaseMutex(image_mutex);
-            } else {
-                break;
+        }
+        while (read_message(pipe, message, &fits)) {
+            if (!fits)
+                continue;
+            WaitForSingleObject(image_mutex, INFINITE);
+            if (*message == 0) {
+                exit(0);
             }
+            loadImage(message);
+            InvalidateRect(window, NULL, FALSE);
+            ReleaseMutex(image_mutex);
         }
-        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
     }
 
-    CloseHandle(pipe);
-
     return 0;
 }
 
@@ -223,26 +259,6 @@ int do_journal()
   CoTaskMemFree(folder_path);
   init_check_save(save_path);
 
-    // Initial image
-    char message[IN_BUFFER_SIZE];
-    DWORD len;
-    HANDLE pipe = CreateFileW(L"\\\\.\\pipe\\oneshot-journal-to-game",
-	                          GENERIC_READ,
-	                          0,
-	                          NULL,
-	                          OPEN_EXISTING,
-	                          0,
-	                          NULL);
-    if (pipe != INVALID_HANDLE_VALUE) {
-        if (ReadFile(pipe, (void*)message, IN_BUFFER_SIZE, &len, NULL)
-                && len == IN_BUFFER_SIZE)
-        {
-            if (*message)
-                loadImage(message);
-        }
-        CloseHandle(pipe);
-    }
-
     WNDCLASSEXW wc;
     wc.cbSize           = sizeof(wc);
     wc.style            = 0;
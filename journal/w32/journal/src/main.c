@@ -1,6 +1,8 @@
 #include <windows.h>
+#include <wchar.h>
 
 extern int do_niko(int x, int y);
+extern int do_niko_from_game();
 extern int do_journal();
 
 int WINAPI WinMain(HINSTANCE hInstance,
@@ -22,6 +24,10 @@ int WINAPI WinMain(HINSTANCE hInstance,
         int y = _wtoi(argv[2]);
         return do_niko(x, y);
     }
+    // started by the game, which sends the position once it knows
+    if (argc == 2 && wcscmp(argv[1], L"niko") == 0) {
+        return do_niko_from_game();
+    }
     // assume journal
     return do_journal();
 }
@@ -1,4 +1,5 @@
 #include <windows.h>
+#include <stdio.h>
 
 static const WCHAR niko_classname[] = L"niko";
 static HWND niko = NULL;
@@ -128,3 +129,54 @@ int do_niko(int x, int y)
 
     return 0;
 }
+
+// Waits for the game to send where to start, as "x,y"
+int do_niko_from_game()
+{
+    char message[32];
+    UINT32 size;
+    DWORD len;
+    DWORD total = 0;
+    int x, y;
+
+    HANDLE pipe;
+    for (;;) {
+        pipe = CreateFileW(L"\\\\.\\pipe\\oneshot-niko",
+                           GENERIC_READ | GENERIC_WRITE,
+                           0,
+                           NULL,
+                           OPEN_EXISTING,
+                           0,
+                           NULL);
+        if (pipe != INVALID_HANDLE_VALUE)
+            break;
+        Sleep(100);
+    }
+
+    // Length prefix, then the message itself
+    while (total < sizeof(size)) {
+        if (!ReadFile(pipe, (char*)&size + total, sizeof(size) - total, &len, NULL) || len == 0) {
+            CloseHandle(pipe);
+            return 1;
+        }
+        total += len;
+    }
+    if (size >= sizeof(message)) {
+        CloseHandle(pipe);
+        return 1;
+    }
+    total = 0;
+    while (total < size) {
+        if (!ReadFile(pipe, message + total, size - total, &len, NULL) || len == 0) {
+            CloseHandle(pipe);
+            return 1;
+        }
+        total += len;
+    }
+    message[size] = 0;
+    CloseHandle(pipe);
+
+    if (sscanf(message, "%d,%d", &x, &y) != 2)
+        return 1;
+    return do_niko(x, y);
+}
@@ -0,0 +1,110 @@
+#encoding: utf-8
+
+# Micro-benchmark of hot binding calls through the Ruby VM.
+#
+# Runs inside the engine as a preload script, before the game scripts:
+#
+#   preloadScript=scripts/ruby/binding-bench.rb
+#
+# Results go to stdout and to binding-bench.txt in the game folder,
+# after which the game exits. For a before/after comparison, run it
+# once on each build with the same settings.
+
+BENCH_ITERATIONS = 200_000
+BENCH_ROUNDS = 5
+
+def bench_now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+# Best of several rounds, in nanoseconds per call
+def bench(name, results, iterations = BENCH_ITERATIONS)
+  best = nil
+  BENCH_ROUNDS.times do
+    start = bench_now
+    yield iterations
+    elapsed = bench_now - start
+    best = elapsed if best.nil? || elapsed < best
+  end
+  results << [name, best * 1_000_000_000 / iterations]
+end
+
+results = []
+
+bitmap = Bitmap.new(64, 64)
+src = Bitmap.new(32, 32)
+src_rect = Rect.new(0, 0, 32, 32)
+sprite = Sprite.new
+sprite.bitmap = bitmap
+table = Table.new(100, 100)
+color = Color.new(0, 0, 0)
+
+bench('Sprite#x= (Fixnum)', results) do |n|
+  i = 0
+  while i < n
+    sprite.x = i & 255
+    i += 1
+  end
+end
+
+bench('Sprite#zoom_x= (Float)', results) do |n|
+  i = 0
+  while i < n
+    sprite.zoom_x = 1.5
+    i += 1
+  end
+end
+
+bench('Color#set', results) do |n|
+  i = 0
+  while i < n
+    color.set(255, 128, 0, 255)
+    i += 1
+  end
+end
+
+bench('Rect#set', results) do |n|
+  i = 0
+  while i < n
+    src_rect.set(0, 0, 32, 32)
+    i += 1
+  end
+end
+
+bench('Table#[]', results) do |n|
+  i = 0
+  while i < n
+    table[i % 100, 7]
+    i += 1
+  end
+end
+
+bench('Input.press?', results) do |n|
+  i = 0
+  while i < n
+    Input.press?(Input::ACTION)
+    i += 1
+  end
+end
+
+# Each call draws, so far fewer of these
+bench('Bitmap#blt', results, BENCH_ITERATIONS / 100) do |n|
+  i = 0
+  while i < n
+    bitmap.blt(0, 0, src, src_rect)
+    i += 1
+  end
+end
+
+sprite.dispose
+bitmap.dispose
+src.dispose
+
+report = results.map do |name, ns|
+  format('%-26s %10.1f ns/call', name, ns)
+end
+
+report.each { |line| puts line }
+File.open('binding-bench.txt', 'w') { |f| f.puts(report) }
+
+exit
@@ -0,0 +1,97 @@
+#encoding: utf-8
+
+# Upload and draw cost of large quad arrays, with 16 bit versus
+# 32 bit indices in the global IBO.
+#
+# Runs inside the engine as a preload script, with the frame limiter
+# and vsync off so that Graphics.update isn't waiting on either:
+#
+#   preloadScript=scripts/ruby/ibo-bench.rb
+#   fixedFramerate=-1
+#   vsync=false
+#
+# The IBO only ever switches from 16 to 32 bit, so the phases run in
+# that order: the small scene on 16 bit indices, then the oversized
+# scene (which forces the switch), then the small scene again, now on
+# 32 bit indices. Results go to stdout and to ibo-bench.txt in the game
+# folder, after which the game exits.
+
+# Fits 16 bit indices (at most 16384 quads)
+SMALL_QUADS = 16_000
+# Too large for 16 bit indices
+LARGE_QUADS = 40_000
+
+BENCH_FRAMES = 300
+BENCH_WARMUP = 30
+
+def bench_now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+# Average milliseconds per frame
+def bench_frames(frames)
+  BENCH_WARMUP.times { yield }
+  start = bench_now
+  frames.times { yield }
+  (bench_now - start) * 1000.0 / frames
+end
+
+# One quad per particle, all alive for the whole run
+def make_scene(bitmap, quads)
+  scene = ParticleSystem.new
+  scene.bitmap = bitmap
+  scene.emit_rect = Rect.new(0, 0, Graphics.width, Graphics.height)
+  scene.max_particles = quads
+  scene.lifetime = 1_000_000
+  scene.spawn_rate = 0
+  scene.emit(quads)
+  scene
+end
+
+# 'draw' redraws the same vertices, 'upload + draw' rebuilds
+# and uploads them every frame. An unchanged screen isn't drawn
+# again at all, so the draw pass nudges the scene origin, which
+# only forces the redraw
+def bench_scene(name, bitmap, quads, results)
+  scene = make_scene(bitmap, quads)
+
+  frame = 0
+  draw = bench_frames(BENCH_FRAMES) do
+    frame += 1
+    scene.ox = frame & 1
+    Graphics.update
+  end
+  upload = bench_frames(BENCH_FRAMES) { scene.update; Graphics.update }
+
+  results << ["#{name}, draw", quads, draw]
+  results << ["#{name}, upload + draw", quads, upload]
+
+  scene.dispose
+end
+
+results = []
+
+bitmap = Bitmap.new(4, 4)
+bitmap.fill_rect(bitmap.rect, Color.new(255, 255, 255))
+
+# Redrawing the screen with nothing on it
+baseline = bench_frames(BENCH_FRAMES) do
+  Graphics.brightness = Graphics.brightness == 255 ? 254 : 255
+  Graphics.update
+end
+results << ['empty frame', 0, baseline]
+
+bench_scene('small, 16 bit', bitmap, SMALL_QUADS, results)
+bench_scene('large, 32 bit', bitmap, LARGE_QUADS, results)
+bench_scene('small, 32 bit', bitmap, SMALL_QUADS, results)
+
+bitmap.dispose
+
+report = results.map do |name, quads, ms|
+  format('%-28s %6d quads %8.3f ms/frame', name, quads, ms)
+end
+
+report.each { |line| puts line }
+File.open('ibo-bench.txt', 'w') { |f| f.puts(report) }
+
+exit
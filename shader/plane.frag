@@ -1,5 +1,9 @@
 
 uniform sampler2D texture;
+uniform vec2 texSizeInv;
+
+/* Repeated part of the bitmap, in pixels */
+uniform vec4 srcRect;
 
 uniform lowp vec4 tone;
 
@@ -13,8 +17,9 @@ const vec3 lumaF = vec3(.299, .587, .114);
 
 void main()
 {
-	/* Sample source color */
-	vec4 frag = texture2D(texture, v_texCoord);
+	/* Wrap into the source rect and sample source color */
+	vec2 coord = (srcRect.xy + fract(v_texCoord) * srcRect.zw) * texSizeInv;
+	vec4 frag = texture2D(texture, coord);
 	
 	/* Apply gray */
 	float luma = dot(frag.rgb, lumaF);
@@ -0,0 +1,22 @@
+
+uniform mat4 projMat;
+
+uniform vec2 translation;
+
+/* Wrapped scroll offset, in screen pixels */
+uniform vec2 offset;
+/* Inverse of the zoomed source rect size */
+uniform vec2 tileSizeInv;
+
+attribute vec2 position;
+attribute vec2 texCoord;
+
+/* Position in source rect tiles, wrapped in the fragment shader */
+varying vec2 v_texCoord;
+
+void main()
+{
+	gl_Position = projMat * vec4(position + translation, 0, 1);
+
+	v_texCoord = (texCoord + offset) * tileSizeInv;
+}
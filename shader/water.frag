@@ -1,4 +1,12 @@
 uniform sampler2D texture;
+uniform vec2 texSizeInv;
+
+/* Repeated part of the bitmap, in pixels */
+uniform vec4 srcRect;
+
+/* 1 to repeat the source rect (planes),
+ * 0 to clamp to its edges (screen effect) */
+uniform lowp float wrapEdges;
 uniform float iTime;
 uniform lowp float opacity;
 
@@ -111,12 +119,18 @@ vec3 calcNormal( in vec3 x, in float eps )
                             function(x+e.yxy) - function(x-e.yxy),
                             function(x+e.yyx) - function(x-e.yyx) ) );
 }
+vec2 wrapCoord(vec2 uv)
+{
+	vec2 tile = (uv / texSizeInv - srcRect.xy) / srcRect.zw;
+	tile = mix(clamp(tile, 0.0, 1.0), fract(tile), wrapEdges);
+	return (srcRect.xy + tile * srcRect.zw) * texSizeInv;
+}
 void main()
 {
    
-	vec2 uv = v_texCoord;
+	vec2 uv = (srcRect.xy + v_texCoord * srcRect.zw) * texSizeInv;
     vec3 v = calcNormal(vec3(uv.x,1,uv.y),.01);
-	vec4 fragColor = texture2D(texture,uv+(v.xz/15.*.25));
+	vec4 fragColor = texture2D(texture,wrapCoord(uv+(v.xz/15.*.25)));
     fragColor.a *= opacity;
     gl_FragColor = fragColor;
 }
\ No newline at end of file
@@ -24,10 +24,57 @@
 
 #include "al-util.h"
 
+#include <vector>
+#include <SDL2/SDL_atomic.h>
+
 #ifdef _WIN32
 #include <cstring>
 #endif
 
+/* Fully decoded audio data, shared between
+ * any number of sources playing it */
+struct PCMClip
+{
+	std::vector<uint8_t> data;
+
+	ALenum format;
+	int rate;
+	int frameSize;
+
+	/* In frames. If 'loopEnd' is 0, looping
+	 * wraps around the entire clip */
+	uint32_t loopStart;
+	uint32_t loopEnd;
+
+	PCMClip()
+	    : format(0), rate(0), frameSize(1),
+	      loopStart(0), loopEnd(0)
+	{
+		SDL_AtomicSet(&refCount, 1);
+	}
+
+	uint32_t frameCount() const
+	{
+		return data.size() / frameSize;
+	}
+
+	static PCMClip *ref(PCMClip *clip)
+	{
+		SDL_AtomicIncRef(&clip->refCount);
+
+		return clip;
+	}
+
+	static void deref(PCMClip *clip)
+	{
+		if (SDL_AtomicDecRef(&clip->refCount))
+			delete clip;
+	}
+
+private:
+	SDL_atomic_t refCount;
+};
+
 struct ALDataSource
 {
 	enum Status
@@ -55,6 +102,23 @@ struct ALDataSource
 
 	/* Returns false if not supported */
 	virtual bool setPitch(float value) = 0;
+
+	/* Roughly how many bytes each fillBuffer() call
+	 * should decode from now on. Ignored if not supported */
+	virtual void setBufferSize(uint32_t bytes)
+	{
+		(void) bytes;
+	}
+
+	/* Decodes the entire stream into memory if it isn't
+	 * longer than 'maxSeconds', otherwise (or if not
+	 * supported) returns null. The read position is
+	 * undefined afterwards */
+	virtual PCMClip *decodeAll(float maxSeconds)
+	{
+		(void) maxSeconds;
+		return 0;
+	}
 };
 
 ALDataSource *createSDLSource(SDL_RWops &ops,
@@ -65,4 +129,8 @@ ALDataSource *createSDLSource(SDL_RWops &ops,
 ALDataSource *createVorbisSource(SDL_RWops &ops,
                                  bool looped);
 
+/* Takes over the passed reference to 'clip' */
+ALDataSource *createPCMSource(PCMClip *clip,
+                              bool looped);
+
 #endif // ALDATASOURCE_H
@@ -26,12 +26,80 @@
 #include "sdl-util.h"
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
 #include <SDL2/SDL_rwops.h>
 
 struct ALDataSource;
 
 #define STREAM_BUFS 3
 
+/* Upper limit for ALStreamBufferPolicy::maxBuffers */
+#define STREAM_BUFS_MAX 16
+
+/* How many buffers a stream keeps queued, and how large
+ * they are. Streams start out with 'minBuffers' buffers of
+ * STREAM_BUF_SIZE bytes, grow both after an underrun, and
+ * shrink back one step at a time after 'stableMs' without one.
+ * The default policy never grows */
+struct ALStreamBufferPolicy
+{
+	int minBuffers;
+	int maxBuffers;
+	uint32_t maxBufferBytes;
+	uint32_t stableMs;
+
+	ALStreamBufferPolicy()
+	    : minBuffers(STREAM_BUFS),
+	      maxBuffers(STREAM_BUFS),
+	      maxBufferBytes(STREAM_BUF_SIZE),
+	      stableMs(30000)
+	{}
+};
+
+/* Counters collected by the stream thread, used to
+ * judge whether STREAM_BUFS / STREAM_BUF_SIZE hold up */
+struct ALStreamStats
+{
+	/* Times the source ran dry mid-stream and
+	 * had to be restarted */
+	uint64_t underruns;
+
+	/* Stream thread wakeups */
+	uint64_t wakeups;
+
+	/* Buffers decoded and queued, and the time spent
+	 * decoding them (in microseconds) */
+	uint64_t buffersFilled;
+	uint64_t decodeUs;
+	uint32_t maxDecodeUs;
+
+	/* Wakeups that found processed buffers, and the time from
+	 * then until all of them were queued up again */
+	uint64_t refills;
+	uint64_t refillUs;
+	uint32_t maxRefillUs;
+
+	/* Buffers still queued for playback when the stream
+	 * thread woke up (summed over 'depthSamples').
+	 * 'minDepth' is -1 until the first sample */
+	uint64_t depthSum;
+	uint64_t depthSamples;
+	int minDepth;
+
+	/* Buffer policy adjustments, and the largest
+	 * buffer count / size used so far */
+	uint64_t grows;
+	uint64_t shrinks;
+	int peakBuffers;
+	uint32_t peakBufferBytes;
+
+	ALStreamStats();
+
+	void add(const ALStreamStats &o);
+};
+
 /* State-machine like audio playback stream.
  * This class is NOT thread safe */
 struct ALStream
@@ -69,12 +137,29 @@ struct ALStream
 	float pitch;
 
 	AL::Source::ID alSrc;
-	AL::Buffer::ID alBuf[STREAM_BUFS];
+	std::vector<AL::Buffer::ID> alBuf;
+
+	ALStreamBufferPolicy policy;
+
+	/* Only touched by the stream thread: buffers not
+	 * currently queued, the number queued, and the
+	 * current target buffer count / size */
+	std::vector<AL::Buffer::ID> spareBufs;
+	int queuedBufs;
+	int targetBufs;
+	uint32_t bufBytes;
+	uint32_t stableSince;
 
 	uint64_t procFrames;
-	AL::Buffer::ID lastBuf;
 
-	SDL_RWops srcOps;
+	/* Queued buffers after which the data source wrapped
+	 * around, in queue order. Several can be queued at once
+	 * with short loops and deep buffering */
+	std::deque<AL::Buffer::ID> wrapBufs;
+
+	/* Written by the stream thread */
+	ALStreamStats stats;
+	SDL_mutex *statsMut;
 
 	/* only used for the crossfader in audiostream.c */
 	float crossfadeVolume;
@@ -94,7 +179,8 @@ struct ALStream
 
 	ALStream(LoopMode loopMode,
 			 AL::AuxiliaryEffectSlot::ID effectSlot,
-	         const std::string &threadId);
+	         const std::string &threadId,
+	         const ALStreamBufferPolicy &policy = ALStreamBufferPolicy());
 	~ALStream();
 
 	void close();
@@ -108,6 +194,7 @@ struct ALStream
 	State queryState();
 	float queryOffset();
 	bool queryNativePitch();
+	ALStreamStats queryStats();
 
 	void setALFilter(AL::Filter::ID filter);
 
@@ -122,6 +209,11 @@ private:
 
 	void checkStopped();
 
+	/* Stream thread helpers */
+	void growBuffers();
+	void maybeShrinkBuffers();
+	bool queueSpareBuffer(ALStreamStats &delta);
+
 	/* thread func */
 	void streamData();
 };
@@ -36,6 +36,8 @@
  *   quite make out their meaning yet) */
 
 struct AudioPrivate;
+struct ALStreamStats;
+class StreamCache;
 struct RGSSThreadData;
 
 class Audio
@@ -65,8 +67,34 @@ public:
 
 	void sePlay(const char *filename,
 	            int volume = 100,
-	            int pitch = 100);
+	            int pitch = 100,
+	            int priority = 0);
 	void seStop();
+	void sePreload(const char *filename);
+
+	/* SE voice pool */
+	int seVoices() const;
+	void setSEVoices(int count);
+	int seActiveVoices();
+
+	/* Counters since startup */
+	uint64_t seSteals() const;
+	uint64_t seCoalesced() const;
+	uint64_t seDropped() const;
+
+	/* Bytes of decoded SE data held in memory */
+	uint32_t seCacheBytes();
+
+	/* Stream thread counters since startup,
+	 * summed over each channel's streams */
+	ALStreamStats bgmStats();
+	ALStreamStats bgsStats();
+	ALStreamStats meStats();
+	ALStreamStats lchStats();
+	ALStreamStats chStats();
+
+	/* Decoded / encoded BGM, BGS, ME etc. kept in memory */
+	StreamCache &streamCache();
 
 	void lchPlay(unsigned int id,
 				 const char *filename,
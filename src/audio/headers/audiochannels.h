@@ -14,7 +14,9 @@ class AudioChannels {
     public:
     AudioChannels(ALStream::LoopMode loopMode,
 	            const std::string &threadId,
-                unsigned int count);
+                unsigned int count,
+                const ALStreamBufferPolicy &bufferPolicy = ALStreamBufferPolicy());
+    ~AudioChannels();
 
     unsigned int size();
     void resize(unsigned int size);
@@ -46,11 +48,21 @@ class AudioChannels {
 	void setALFilter(unsigned int id, AL::Filter::ID filter);
 	void setALEffect(unsigned int id, ALuint effect);
 
+    /* Totals over all channels, including ones removed
+     * by resize(). Safe to call from other threads */
+    ALStreamStats queryStats();
+
     private:
     std::vector<AudioStream*> streams;
     ALStream::LoopMode loopMode;
     const std::string threadId;
     float globalVolume;
+    const ALStreamBufferPolicy bufferPolicy;
+
+    /* Guards 'streams' against resize() while other
+     * threads query stats */
+    SDL_mutex *resizeMut;
+    ALStreamStats retiredStats;
 };
 
 #endif // AUDIOCHANNELS_H
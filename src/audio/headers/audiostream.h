@@ -129,7 +129,8 @@ struct AudioStream
 	
 
 	AudioStream(ALStream::LoopMode loopMode,
-	            const std::string &threadId);
+	            const std::string &threadId,
+	            const ALStreamBufferPolicy &bufferPolicy = ALStreamBufferPolicy());
 	~AudioStream();
 
 	void play(const std::string &filename,
@@ -161,12 +162,21 @@ struct AudioStream
 	float playingOffset();
 	ALStream::State queryState();
 
+	/* Totals over all streams this instance ever played */
+	ALStreamStats queryStats();
+
 	void setALFilter(AL::Filter::ID filter);
 	void setALEffect(ALuint effect);
 
 private:
 	float volumes[VolumeTypeCount];
+
+	/* Stats of streams already destroyed by crossfading */
+	ALStreamStats retiredStats;
+	std::deque<ALStream>::iterator retireStream(std::deque<ALStream>::iterator stream);
+
 	int alStreamThreadID;
+	const ALStreamBufferPolicy bufferPolicy;
 	std::string alStreamThreadIDPrefix;
 	AL::AuxiliaryEffectSlot::ID effectSlot;
 	AL::Filter::ID curfilter = AL::Filter::ID(AL_FILTER_NULL);
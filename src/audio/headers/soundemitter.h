@@ -28,13 +28,19 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
 
 struct SoundBuffer;
+struct SoundDecodeJob;
 struct Config;
 
 struct SoundEmitter
 {
 	typedef BoostHash<std::string, SoundBuffer*> BufferHash;
+	typedef BoostHash<std::string, SoundDecodeJob*> JobHash;
 
 	IntruList<SoundBuffer> buffers;
 	BufferHash bufferHash;
@@ -42,30 +48,119 @@ struct SoundEmitter
 	/* Byte count sum of all cached / playing buffers */
 	uint32_t bufferBytes;
 
-	const size_t srcCount;
-	std::vector<AL::Source::ID> alSrcs;
-	std::vector<SoundBuffer*> atchBufs;
+	/* Upper limit for 'bufferBytes' */
+	const uint32_t cacheBudget;
+
+	struct Voice
+	{
+		AL::Source::ID src;
+		SoundBuffer *buffer;
+
+		/* Tracked here instead of asking AL every time;
+		 * 'endTicks' is when the buffer is expected to
+		 * have finished playing */
+		uint32_t startTicks;
+		uint32_t endTicks;
+
+		int priority;
+	};
+
+	std::vector<Voice> voices;
+
+	/* Written with 'mutex' held, read through 'queryStats()' */
+	struct Stats
+	{
+		/* Plays that had to cut off another sound */
+		uint64_t steals;
 
-	/* Indices of sources, sorted by priority (lowest first) */
-	std::vector<size_t> srcPrio;
+		/* Identical plays (same sound, volume, pitch
+		 * and priority) merged within one frame */
+		uint64_t coalesced;
+
+		/* Plays discarded because all voices were busy
+		 * with higher priority sounds */
+		uint64_t dropped;
+	} stats;
 
 	SoundEmitter(const Config &conf);
 	~SoundEmitter();
 
+	/* If the sound isn't cached yet, it is decoded in the
+	 * background and starts playing once that's done.
+	 * If all voices are busy, the oldest one with the lowest
+	 * priority not above 'priority' is taken over */
 	void play(const std::string &filename,
 	          int volume,
-	          int pitch);
+	          int pitch,
+	          int priority = 0);
+
+	/* Decodes the sound into the cache ahead of time */
+	void preload(const std::string &filename);
 
 	void stop();
 
+	/* Number of sounds that can play at the same time */
+	size_t voiceCount() const;
+	void setVoiceCount(size_t count);
+
+	/* Voices currently (expected to be) playing */
+	size_t activeVoices();
+
+	/* Locked read of 'bufferBytes' */
+	uint32_t cacheBytes();
+
+	/* Locked copy of 'stats' */
+	Stats queryStats();
+
 	void setALFilter(AL::Filter::ID filter);
 	void setALEffect(ALuint effect);
 	
 private:
-	SoundBuffer *allocateBuffer(const std::string &filename);
+	/* Parses the sound's header and hands it to a decode
+	 * worker, optionally playing it once decoded */
+	void startDecode(const std::string &filename, bool play,
+	                 float volume = 0, float pitch = 0, int priority = 0);
+
+	/* All of these expect 'mutex' to be held */
+	SoundBuffer *findBuffer(const std::string &filename);
+	void insertBuffer(SoundBuffer *buffer);
+	void playBuffer(SoundBuffer *buffer, float volume, float pitch, int priority);
+	void finishDecode(SoundDecodeJob *job, SoundBuffer *buffer);
+	void initVoice(Voice &voice);
+	void releaseVoice(Voice &voice);
+
+	void decodeWorker();
+
 	AL::AuxiliaryEffectSlot::ID effectSlot;
 	AL::Filter::ID curfilter = AL::Filter::ID(AL_FILTER_NULL);
 	ALuint cureffect = AL_EFFECT_NULL;
+
+	/* Guards the buffer cache, sources and decode queue;
+	 * decode workers touch all of them once they're done */
+	SDL_mutex *mutex;
+	SDL_cond *jobCond;
+
+	/* Jobs not yet picked up by a worker */
+	std::deque<SoundDecodeJob*> jobQueue;
+
+	/* All jobs in flight, by sound name */
+	JobHash pendingJobs;
+
+	std::vector<SDL_Thread*> workers;
+	bool quitWorkers;
+
+	/* Plays requested during the current frame,
+	 * for coalescing identical ones */
+	struct FramePlay
+	{
+		std::string filename;
+		int volume;
+		int pitch;
+		int priority;
+	};
+
+	std::vector<FramePlay> framePlays;
+	unsigned int framePlaysFrame;
 };
 
 #endif // SOUNDEMITTER_H
@@ -0,0 +1,126 @@
+/*
+** streamcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMCACHE_H
+#define STREAMCACHE_H
+
+#include "intrulist.h"
+#include "boost-hash.h"
+
+#include <string>
+#include <deque>
+#include <stdint.h>
+
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_thread.h>
+
+struct ALDataSource;
+struct StreamCacheEntry;
+struct StreamDecoder;
+struct EncodedFile;
+struct PCMClip;
+struct Config;
+
+/* Keeps recently played BGM/ME/etc. files in memory so replaying
+ * them doesn't touch the disk. Streams shorter than a configurable
+ * length are kept fully decoded, longer ones as their encoded file
+ * contents plus idle decoders that can be picked up again without
+ * reparsing headers. Least recently used entries are evicted once
+ * the memory budget is exceeded.
+ *
+ * The first play always streams from the encoded contents; short
+ * streams are decoded on a worker thread meanwhile, and the entry
+ * switches over to the decoded clip once that is done. */
+class StreamCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+
+		/* Entries / bytes currently cached */
+		size_t entries;
+		uint32_t bytes;
+	};
+
+	StreamCache(const Config &conf);
+	~StreamCache();
+
+	/* Returns null (and fills 'errorMsg') if the file
+	 * can't be decoded. Throws on missing files like
+	 * FileSystem::openRead. The returned source is
+	 * destroyed by deleting it as usual */
+	ALDataSource *open(const std::string &filename,
+	                   bool looped,
+	                   std::string &errorMsg);
+
+	Stats stats();
+
+private:
+	friend struct CachedSource;
+
+	/* Called when a source returned by open() is deleted */
+	void release(const std::string &key, StreamDecoder *decoder);
+
+	void insertEntry(StreamCacheEntry *entry);
+	void removeEntry(StreamCacheEntry *entry);
+
+	/* Replaces the entry's encoded contents with 'clip',
+	 * expects 'mutex' to be held */
+	void storeClip(StreamCacheEntry *entry, PCMClip *clip);
+
+	struct DecodeJob
+	{
+		std::string key;
+		std::string ext;
+		bool looped;
+
+		/* Own reference */
+		EncodedFile *file;
+	};
+
+	void decodeWorker();
+	PCMClip *decodeClip(const DecodeJob &job);
+
+	const uint32_t budget;
+	const float decodeSeconds;
+
+	IntruList<StreamCacheEntry> entries;
+	BoostHash<std::string, StreamCacheEntry*> entryHash;
+
+	uint32_t bytes;
+
+	uint64_t hits;
+	uint64_t misses;
+
+	/* Guards everything above, and the decode queue */
+	SDL_mutex *mutex;
+	SDL_cond *jobCond;
+
+	std::deque<DecodeJob> jobQueue;
+	bool quitWorker;
+
+	/* Only started if short streams get decoded */
+	SDL_Thread *worker;
+};
+
+#endif // STREAMCACHE_H
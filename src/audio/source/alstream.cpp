@@ -26,6 +26,8 @@
 #include "filesystem.h"
 #include "exception.h"
 #include "aldatasource.h"
+#include "streamcache.h"
+#include "audio.h"
 #include "sdl-util.h"
 #include "debugwriter.h"
 
@@ -33,15 +35,59 @@
 #include <SDL2/SDL_thread.h>
 #include <SDL2/SDL_timer.h>
 
+#include <algorithm>
+
+ALStreamStats::ALStreamStats()
+    : underruns(0), wakeups(0),
+      buffersFilled(0), decodeUs(0), maxDecodeUs(0),
+      refills(0), refillUs(0), maxRefillUs(0),
+      depthSum(0), depthSamples(0), minDepth(-1),
+      grows(0), shrinks(0), peakBuffers(0), peakBufferBytes(0)
+{}
+
+void ALStreamStats::add(const ALStreamStats &o)
+{
+	underruns += o.underruns;
+	wakeups += o.wakeups;
+	buffersFilled += o.buffersFilled;
+	decodeUs += o.decodeUs;
+	maxDecodeUs = std::max(maxDecodeUs, o.maxDecodeUs);
+	refills += o.refills;
+	refillUs += o.refillUs;
+	maxRefillUs = std::max(maxRefillUs, o.maxRefillUs);
+	depthSum += o.depthSum;
+	depthSamples += o.depthSamples;
+	grows += o.grows;
+	shrinks += o.shrinks;
+	peakBuffers = std::max(peakBuffers, o.peakBuffers);
+	peakBufferBytes = std::max(peakBufferBytes, o.peakBufferBytes);
+
+	if (o.minDepth >= 0 && (minDepth < 0 || o.minDepth < minDepth))
+		minDepth = o.minDepth;
+}
+
+static uint32_t usSince(Uint64 start)
+{
+	static const Uint64 freq = SDL_GetPerformanceFrequency();
+
+	return (SDL_GetPerformanceCounter() - start) * 1000000 / freq;
+}
+
 ALStream::ALStream(LoopMode loopMode,
 				   AL::AuxiliaryEffectSlot::ID effectSlot,
-		           const std::string &threadId)
+		           const std::string &threadId,
+		           const ALStreamBufferPolicy &policy)
 	: looped(loopMode == Looped),
 	  state(Closed),
 	  source(0),
 	  thread(0),
 	  preemptPause(false),
       pitch(1.0f),
+	  policy(policy),
+	  queuedBufs(0),
+	  targetBufs(policy.minBuffers),
+	  bufBytes(STREAM_BUF_SIZE),
+	  stableSince(0),
 	  crossfadeVolume(1.0f)
 {
 	alSrc = AL::Source::gen();
@@ -52,10 +98,13 @@ ALStream::ALStream(LoopMode loopMode,
 
 	AL::Source::setAuxEffectSlot(alSrc, effectSlot);
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	alBuf.resize(policy.maxBuffers);
+
+	for (size_t i = 0; i < alBuf.size(); ++i)
 		alBuf[i] = AL::Buffer::gen();
 
 	pauseMut = SDL_CreateMutex();
+	statsMut = SDL_CreateMutex();
 
 	threadName = std::string("al_stream (") + threadId + ")";
 }
@@ -67,10 +116,11 @@ ALStream::~ALStream()
 	AL::Source::clearQueue(alSrc);
 	AL::Source::del(alSrc);
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	for (size_t i = 0; i < alBuf.size(); ++i)
 		AL::Buffer::del(alBuf[i]);
 
 	SDL_DestroyMutex(pauseMut);
+	SDL_DestroyMutex(statsMut);
 }
 
 void ALStream::close()
@@ -200,6 +250,15 @@ float ALStream::queryOffset()
 	return procOffset + AL::Source::getSecOffset(alSrc);
 }
 
+ALStreamStats ALStream::queryStats()
+{
+	SDL_LockMutex(statsMut);
+	ALStreamStats result = stats;
+	SDL_UnlockMutex(statsMut);
+
+	return result;
+}
+
 void ALStream::setALFilter(AL::Filter::ID filter) {
 	AL::Source::setFilter(alSrc, filter);
 }
@@ -209,62 +268,17 @@ void ALStream::closeSource()
 	delete source;
 }
 
-struct ALStreamOpenHandler : FileSystem::OpenHandler
-{
-	SDL_RWops *srcOps;
-	bool looped;
-	ALDataSource *source;
-	std::string errorMsg;
-
-	ALStreamOpenHandler(SDL_RWops &srcOps, bool looped)
-	    : srcOps(&srcOps), looped(looped), source(0)
-	{}
-
-	bool tryRead(SDL_RWops &ops, const char *ext)
-	{
-		/* Copy this because we need to keep it around,
-		 * as we will continue reading data from it later */
-		*srcOps = ops;
-
-		/* Try to read ogg file signature */
-		char sig[5] = { 0 };
-		SDL_RWread(srcOps, sig, 1, 4);
-		SDL_RWseek(srcOps, 0, RW_SEEK_SET);
-
-		try
-		{
-			if (!strcmp(sig, "OggS"))
-			{
-				source = createVorbisSource(*srcOps, looped);
-				return true;
-			}
-
-			source = createSDLSource(*srcOps, ext, STREAM_BUF_SIZE, looped);
-		}
-		catch (const Exception &e)
-		{
-			/* All source constructors will close the passed ops
-			 * before throwing errors */
-			errorMsg = e.msg;
-			return false;
-		}
-
-		return true;
-	}
-};
-
 void ALStream::openSource(const std::string &filename)
 {
-	ALStreamOpenHandler handler(srcOps, looped);
-	shState->fileSystem().openRead(handler, filename.c_str());
-	source = handler.source;
+	std::string errorMsg;
+	source = shState->audio().streamCache().open(filename, looped, errorMsg);
 	needsRewind.clear();
 
 	if (!source)
 	{
 		char buf[512];
 		snprintf(buf, sizeof(buf), "Unable to decode audio stream: %s: %s",
-		         filename.c_str(), handler.errorMsg.c_str());
+		         filename.c_str(), errorMsg.c_str());
 
 		Debug() << buf;
 	}
@@ -358,12 +372,97 @@ void ALStream::checkStopped()
 	state = Stopped;
 }
 
+void ALStream::growBuffers()
+{
+	int bufs = std::min(targetBufs + 1, policy.maxBuffers);
+	uint32_t bytes = std::min(bufBytes * 2, policy.maxBufferBytes);
+
+	stableSince = SDL_GetTicks();
+
+	if (bufs == targetBufs && bytes == bufBytes)
+		return;
+
+	targetBufs = bufs;
+
+	if (bytes != bufBytes)
+	{
+		bufBytes = bytes;
+		source->setBufferSize(bufBytes);
+	}
+
+	SDL_LockMutex(statsMut);
+	stats.grows++;
+	stats.peakBuffers = std::max(stats.peakBuffers, targetBufs);
+	stats.peakBufferBytes = std::max(stats.peakBufferBytes, bufBytes);
+	SDL_UnlockMutex(statsMut);
+}
+
+void ALStream::maybeShrinkBuffers()
+{
+	if (SDL_GetTicks() - stableSince < policy.stableMs)
+		return;
+
+	stableSince = SDL_GetTicks();
+
+	/* Give back the added latency first, then the memory.
+	 * Surplus buffers simply aren't requeued once played */
+	if (bufBytes > STREAM_BUF_SIZE)
+	{
+		bufBytes = std::max<uint32_t>(bufBytes / 2, STREAM_BUF_SIZE);
+		source->setBufferSize(bufBytes);
+	}
+	else if (targetBufs > policy.minBuffers)
+	{
+		targetBufs--;
+	}
+	else
+	{
+		return;
+	}
+
+	SDL_LockMutex(statsMut);
+	stats.shrinks++;
+	SDL_UnlockMutex(statsMut);
+}
+
+bool ALStream::queueSpareBuffer(ALStreamStats &delta)
+{
+	AL::Buffer::ID buf = spareBufs.back();
+
+	Uint64 decodeStart = SDL_GetPerformanceCounter();
+	ALDataSource::Status status = source->fillBuffer(buf);
+	uint32_t decodeUs = usSince(decodeStart);
+
+	if (status == ALDataSource::Error)
+		return false;
+
+	spareBufs.pop_back();
+
+	AL::Source::queueBuffer(alSrc, buf);
+	queuedBufs++;
+
+	delta.buffersFilled++;
+	delta.decodeUs += decodeUs;
+	delta.maxDecodeUs = std::max(delta.maxDecodeUs, decodeUs);
+
+	/* If this was the last buffer before the data
+	 * source loop wrapped around again, mark it as
+	 * such so we can catch it and reset the processed
+	 * sample count once it gets unqueued */
+	if (status == ALDataSource::WrapAround)
+		wrapBufs.push_back(buf);
+
+	if (status == ALDataSource::EndOfStream)
+		sourceExhausted.set();
+
+	return true;
+}
+
 /* thread func */
 void ALStream::streamData()
 {
 	/* Fill up queue */
 	bool firstBuffer = true;
-	ALDataSource::Status status;
 
 	if (threadTermReq)
 		return;
@@ -373,19 +472,34 @@ void ALStream::streamData()
 		source->seekToOffset(startOffset);
 	}
 
-	for (int i = 0; i < STREAM_BUFS; ++i)
+	/* The queue was cleared when the stream started, and
+	 * every play starts out with the minimal buffering */
+	spareBufs.assign(alBuf.rbegin(), alBuf.rend());
+	wrapBufs.clear();
+	queuedBufs = 0;
+	targetBufs = policy.minBuffers;
+	bufBytes = STREAM_BUF_SIZE;
+	stableSince = SDL_GetTicks();
+	source->setBufferSize(bufBytes);
+
+	SDL_LockMutex(statsMut);
+	stats.peakBuffers = std::max(stats.peakBuffers, targetBufs);
+	stats.peakBufferBytes = std::max(stats.peakBufferBytes, bufBytes);
+	SDL_UnlockMutex(statsMut);
+
+	while (queuedBufs < targetBufs)
 	{
 		if (threadTermReq)
 			return;
 
-		AL::Buffer::ID buf = alBuf[i];
-
-		status = source->fillBuffer(buf);
+		ALStreamStats delta;
 
-		if (status == ALDataSource::Error)
+		if (!queueSpareBuffer(delta))
 			return;
 
-		AL::Source::queueBuffer(alSrc, buf);
+		SDL_LockMutex(statsMut);
+		stats.add(delta);
+		SDL_UnlockMutex(statsMut);
 
 		if (firstBuffer)
 		{
@@ -398,11 +512,8 @@ void ALStream::streamData()
 		if (threadTermReq)
 			return;
 
-		if (status == ALDataSource::EndOfStream)
-		{
-			sourceExhausted.set();
+		if (sourceExhausted)
 			break;
-		}
 	}
 
 	/* Wait for buffers to be consumed, then
@@ -413,6 +524,19 @@ void ALStream::streamData()
 
 		ALint procBufs = AL::Source::getProcBufferCount(alSrc);
 
+		/* Collected locally, committed once per wakeup */
+		ALStreamStats delta;
+		Uint64 refillStart = SDL_GetPerformanceCounter();
+
+		delta.wakeups = 1;
+
+		if (!sourceExhausted)
+		{
+			delta.minDepth = queuedBufs - procBufs;
+			delta.depthSum = delta.minDepth;
+			delta.depthSamples = 1;
+		}
+
 		while (procBufs--)
 		{
 			if (threadTermReq)
@@ -424,12 +548,15 @@ void ALStream::streamData()
 			if (buf == AL::Buffer::ID(0))
 				break;
 
-			if (buf == lastBuf)
+			queuedBufs--;
+			spareBufs.push_back(buf);
+
+			if (!wrapBufs.empty() && buf == wrapBufs.front())
 			{
 				/* Reset the processed sample count so
 				 * querying the playback offset returns 0.0 again */
 				procFrames = source->loopStartFrames();
-				lastBuf = AL::Buffer::ID(0);
+				wrapBufs.pop_front();
 			}
 			else
 			{
@@ -442,36 +569,45 @@ void ALStream::streamData()
 				if (bits != 0 && chan != 0)
 					procFrames += ((size / (bits / 8)) / chan);
 			}
+		}
 
-			if (sourceExhausted)
-				continue;
+		if (!sourceExhausted && !threadTermReq)
+			maybeShrinkBuffers();
 
-			status = source->fillBuffer(buf);
+		bool refilled = false;
 
-			if (status == ALDataSource::Error)
+		while (!sourceExhausted && !threadTermReq &&
+		       queuedBufs < targetBufs && !spareBufs.empty())
+		{
+			if (!queueSpareBuffer(delta))
 			{
 				sourceExhausted.set();
 				return;
 			}
 
-			AL::Source::queueBuffer(alSrc, buf);
+			refilled = true;
 
-			/* In case of buffer underrun,
-			 * start playing again */
+			/* In case of buffer underrun, start playing
+			 * again, and queue up more from now on */
 			if (AL::Source::getState(alSrc) == AL_STOPPED)
+			{
 				AL::Source::play(alSrc);
+				delta.underruns++;
 
-			/* If this was the last buffer before the data
-			 * source loop wrapped around again, mark it as
-			 * such so we can catch it and reset the processed
-			 * sample count once it gets unqueued */
-			if (status == ALDataSource::WrapAround)
-				lastBuf = buf;
+				growBuffers();
+			}
+		}
 
-			if (status == ALDataSource::EndOfStream)
-				sourceExhausted.set();
+		if (refilled)
+		{
+			delta.refills = 1;
+			delta.refillUs = delta.maxRefillUs = usSince(refillStart);
 		}
 
+		SDL_LockMutex(statsMut);
+		stats.add(delta);
+		SDL_UnlockMutex(statsMut);
+
 		if (threadTermReq)
 			break;
 
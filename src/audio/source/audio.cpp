@@ -24,17 +24,36 @@
 #include "audiostream.h"
 #include "soundemitter.h"
 #include "audiochannels.h"
+#include "streamcache.h"
 #include "sharedstate.h"
 #include "eventthread.h"
 #include "sdl-util.h"
+#include "config.h"
+#include "debugwriter.h"
 
 #include <string>
 
 #include <SDL2/SDL_thread.h>
 #include <SDL2/SDL_timer.h>
 
+static ALStreamBufferPolicy bufferPolicy(const Config &conf,
+                                         const Config::StreamBuffers &bufs)
+{
+	ALStreamBufferPolicy policy;
+	policy.minBuffers = bufs.minBuffers;
+	policy.maxBuffers = bufs.maxBuffers;
+	policy.maxBufferBytes = bufs.maxBufferSize * 1024;
+	policy.stableMs = conf.streamBuffers.stableSeconds * 1000;
+
+	return policy;
+}
+
 struct AudioPrivate
 {
+	/* Declared first, so it outlives all
+	 * streams handing sources back to it */
+	StreamCache streamCache;
+
 	int bgm_volume;
 	int sfx_volume;
 
@@ -72,13 +91,23 @@ struct AudioPrivate
 		MeWatchState state;
 	} meWatch;
 
+	/* Periodic stats log, written by the MeWatch */
+	uint32_t statsIntervalMs;
+	uint32_t lastStatsTicks;
+
 	AudioPrivate(RGSSThreadData &rtData)
-	    : bgm(ALStream::Looped, "bgm"),
-	      bgs(ALStream::Looped, "bgs"),
-	      me(ALStream::NotLooped, "me"),
+	    : streamCache(rtData.config),
+	      bgm(ALStream::Looped, "bgm",
+	          bufferPolicy(rtData.config, rtData.config.streamBuffers.bgm)),
+	      bgs(ALStream::Looped, "bgs",
+	          bufferPolicy(rtData.config, rtData.config.streamBuffers.bgs)),
+	      me(ALStream::NotLooped, "me",
+	         bufferPolicy(rtData.config, rtData.config.streamBuffers.me)),
 	      se(rtData.config),
-		  lch(ALStream::Looped, "lch", rtData.config.audioChannels),
-		  ch(ALStream::NotLooped, "ch", rtData.config.audioChannels),
+		  lch(ALStream::Looped, "lch", rtData.config.audioChannels,
+		      bufferPolicy(rtData.config, rtData.config.streamBuffers.channels)),
+		  ch(ALStream::NotLooped, "ch", rtData.config.audioChannels,
+		     bufferPolicy(rtData.config, rtData.config.streamBuffers.channels)),
 	      syncPoint(rtData.syncPoint)
 	{
 		bgm_volume = 100;
@@ -87,6 +116,8 @@ struct AudioPrivate
 		current_bgs_volume = 100;
 		current_me_volume = 100;
 		meWatch.state = MeNotPlaying;
+		statsIntervalMs = rtData.config.audioStatsInterval * 1000;
+		lastStatsTicks = SDL_GetTicks();
 		meWatch.thread = createSDLThread
 			<AudioPrivate, &AudioPrivate::meWatchFun>(this, "audio_mewatch");
 	}
@@ -248,9 +279,50 @@ struct AudioPrivate
 			}
 			}
 
+			if (statsIntervalMs > 0 && SDL_GetTicks() - lastStatsTicks >= statsIntervalMs)
+			{
+				logStats();
+				lastStatsTicks = SDL_GetTicks();
+			}
+
 			SDL_Delay(AUDIO_SLEEP);
 		}
 	}
+
+	static void logStreamStats(const char *name, const ALStreamStats &st)
+	{
+		if (st.wakeups == 0)
+			return;
+
+		Debug() << "Audio" << name << "underruns" << st.underruns
+		        << "buffers" << st.buffersFilled
+		        << "decode us (avg/max)"
+		        << (st.buffersFilled ? st.decodeUs / st.buffersFilled : 0) << st.maxDecodeUs
+		        << "refill us (avg/max)"
+		        << (st.refills ? st.refillUs / st.refills : 0) << st.maxRefillUs
+		        << "queued (avg/min)"
+		        << (st.depthSamples ? (float) st.depthSum / st.depthSamples : 0.f)
+		        << st.minDepth
+		        << "peak buffers" << st.peakBuffers << "x" << st.peakBufferBytes
+		        << "wakeups" << st.wakeups;
+	}
+
+	void logStats()
+	{
+		logStreamStats("bgm", bgm.queryStats());
+		logStreamStats("bgs", bgs.queryStats());
+		logStreamStats("me", me.queryStats());
+		logStreamStats("lch", lch.queryStats());
+		logStreamStats("ch", ch.queryStats());
+
+		SoundEmitter::Stats seStats = se.queryStats();
+
+		Debug() << "Audio se voices" << se.activeVoices() << "/" << se.voiceCount()
+		        << "steals" << seStats.steals
+		        << "coalesced" << seStats.coalesced
+		        << "dropped" << seStats.dropped
+		        << "cache bytes" << se.cacheBytes();
+	}
 };
 
 Audio::Audio(RGSSThreadData &rtData)
@@ -321,9 +393,10 @@ void Audio::meFade(int time)
 
 void Audio::sePlay(const char *filename,
                    int volume,
-                   int pitch)
+                   int pitch,
+                   int priority)
 {
-	p->se.play(filename, (volume*p->sfx_volume)/100, pitch);
+	p->se.play(filename, (volume*p->sfx_volume)/100, pitch, priority);
 }
 
 void Audio::seStop()
@@ -331,6 +404,76 @@ void Audio::seStop()
 	p->se.stop();
 }
 
+void Audio::sePreload(const char *filename)
+{
+	p->se.preload(filename);
+}
+
+int Audio::seVoices() const
+{
+	return p->se.voiceCount();
+}
+
+void Audio::setSEVoices(int count)
+{
+	p->se.setVoiceCount(std::max(count, 1));
+}
+
+int Audio::seActiveVoices()
+{
+	return p->se.activeVoices();
+}
+
+uint64_t Audio::seSteals() const
+{
+	return p->se.queryStats().steals;
+}
+
+uint64_t Audio::seCoalesced() const
+{
+	return p->se.queryStats().coalesced;
+}
+
+uint64_t Audio::seDropped() const
+{
+	return p->se.queryStats().dropped;
+}
+
+uint32_t Audio::seCacheBytes()
+{
+	return p->se.cacheBytes();
+}
+
+ALStreamStats Audio::bgmStats()
+{
+	return p->bgm.queryStats();
+}
+
+ALStreamStats Audio::bgsStats()
+{
+	return p->bgs.queryStats();
+}
+
+ALStreamStats Audio::meStats()
+{
+	return p->me.queryStats();
+}
+
+ALStreamStats Audio::lchStats()
+{
+	return p->lch.queryStats();
+}
+
+ALStreamStats Audio::chStats()
+{
+	return p->ch.queryStats();
+}
+
+StreamCache &Audio::streamCache()
+{
+	return p->streamCache;
+}
+
 void Audio::bgmCrossfade(const char *filename,
 						 float time,
 			       		 int volume,
@@ -7,14 +7,22 @@
 #include "audiochannels.h"
 AudioChannels::AudioChannels(ALStream::LoopMode loopMode,
                              const std::string &threadId,
-                             unsigned int count):
+                             unsigned int count,
+                             const ALStreamBufferPolicy &bufferPolicy):
                              loopMode(loopMode),
                              threadId(threadId),
-                             globalVolume(1.0f) {
+                             globalVolume(1.0f),
+                             bufferPolicy(bufferPolicy) {
     for (int i=0; i<count; i++) {
-        AudioStream *s = new AudioStream(loopMode, threadId + "_" + std::to_string(i));
+        AudioStream *s = new AudioStream(loopMode, threadId + "_" + std::to_string(i), bufferPolicy);
         streams.push_back(s);
     }
+
+    resizeMut = SDL_CreateMutex();
+}
+
+AudioChannels::~AudioChannels() {
+    SDL_DestroyMutex(resizeMut);
 }
 
 unsigned int AudioChannels::size() {
@@ -22,17 +30,21 @@ unsigned int AudioChannels::size() {
 }
 
 void AudioChannels::resize(unsigned int size) {
+    SDL_LockMutex(resizeMut);
     if (size < streams.size()) {
-        for (std::vector<AudioStream*>::iterator i = streams.begin() + size; i != streams.end(); i++)
+        for (std::vector<AudioStream*>::iterator i = streams.begin() + size; i != streams.end(); i++) {
+            retiredStats.add((*i)->queryStats());
             delete *i;
+        }
         streams.erase(streams.begin() + size, streams.end());
     }
     else {
         for(int i = streams.size(); i < size; i++) {
-            AudioStream *s = new AudioStream(loopMode, threadId + "_" + std::to_string(i));
+            AudioStream *s = new AudioStream(loopMode, threadId + "_" + std::to_string(i), bufferPolicy);
             streams.push_back(s);
         }
     }
+    SDL_UnlockMutex(resizeMut);
 }
 
 float AudioChannels::getGlobalVolume() {
@@ -150,3 +162,12 @@ void AudioChannels::setALEffect(unsigned int id, ALuint effect) {
     }
     streams[id]->setALEffect(effect);
 }
+
+ALStreamStats AudioChannels::queryStats() {
+    SDL_LockMutex(resizeMut);
+    ALStreamStats result = retiredStats;
+    for (AudioStream*& stream : streams)
+        result.add(stream->queryStats());
+    SDL_UnlockMutex(resizeMut);
+    return result;
+}
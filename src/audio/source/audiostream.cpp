@@ -29,10 +29,12 @@
 #include <SDL2/SDL_timer.h>
 
 AudioStream::AudioStream(ALStream::LoopMode loopMode,
-                         const std::string &threadId)
+                         const std::string &threadId,
+                         const ALStreamBufferPolicy &bufferPolicy)
 	: extPaused(false),
 	  noResumeStop(false),
-	  alStreamThreadID(0)
+	  alStreamThreadID(0),
+	  bufferPolicy(bufferPolicy)
 {
 	current.volume = 1.0f;
 	current.pitch = 1.0f;
@@ -49,7 +51,8 @@ AudioStream::AudioStream(ALStream::LoopMode loopMode,
 	effectSlot = AL::AuxiliaryEffectSlot::gen();
 
 	alStreamThreadIDPrefix = threadId + "_";
-	streams.emplace_front(loopMode, effectSlot, alStreamThreadIDPrefix + std::to_string(alStreamThreadID));
+	streams.emplace_front(loopMode, effectSlot, alStreamThreadIDPrefix + std::to_string(alStreamThreadID),
+	                      bufferPolicy);
 	alStreamThreadID++;
 
 
@@ -97,7 +100,7 @@ void AudioStream::destroyCrossfades() {
 		ALStream& stream = streams.back();
 		stream.stop();
 		stream.close();
-		streams.pop_back();
+		retireStream(streams.end() - 1);
 	}
 }
 
@@ -227,7 +230,8 @@ void AudioStream::crossfade(const std::string &filename,
 	streams.emplace_front(
 		streams[0].looped ? ALStream::LoopMode::Looped : ALStream::LoopMode::NotLooped,
 		effectSlot,
-		alStreamThreadIDPrefix + std::to_string(alStreamThreadID));
+		alStreamThreadIDPrefix + std::to_string(alStreamThreadID),
+		bufferPolicy);
 	alStreamThreadID++;
 
 	try {
@@ -236,7 +240,7 @@ void AudioStream::crossfade(const std::string &filename,
 	catch (const Exception &e) {
 		// crap, bail ship
 		// (and actually destroy new stream, keep old stream)
-		streams.erase(streams.begin());
+		retireStream(streams.begin());
 		unlockStream();
 		throw e;
 	}
@@ -387,6 +391,28 @@ ALStream::State AudioStream::queryState()
 	return result;
 }
 
+ALStreamStats AudioStream::queryStats()
+{
+	lockStream();
+
+	ALStreamStats result = retiredStats;
+
+	for (ALStream &stream : streams)
+		result.add(stream.queryStats());
+
+	unlockStream();
+
+	return result;
+}
+
+std::deque<ALStream>::iterator AudioStream::retireStream(std::deque<ALStream>::iterator stream)
+{
+	/* The stream thread has been joined at this point */
+	retiredStats.add(stream->stats);
+
+	return streams.erase(stream);
+}
+
 void AudioStream::setALFilter(AL::Filter::ID filter) {
 	lockStream();
 	for(ALStream& stream : streams) {
@@ -537,7 +563,7 @@ void AudioStream::crossfadeThread()
 				if (i->crossfadeVolume<0) {
 					i->stop();
 					i->close();
-					i = streams.erase(i);
+					i = retireStream(i);
 					continue;
 				} else {
 					i++;
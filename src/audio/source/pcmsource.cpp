@@ -0,0 +1,136 @@
+/*
+** pcmsource.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "aldatasource.h"
+
+#include <algorithm>
+
+/* Streams out of an already decoded clip */
+struct PCMSource : ALDataSource
+{
+	PCMClip *clip;
+	bool looped;
+
+	/* Current read position, in frames */
+	uint32_t currentFrame;
+
+	/* Frames uploaded per buffer */
+	uint32_t chunkFrames;
+
+	PCMSource(PCMClip *clip,
+	          bool looped)
+	    : clip(clip),
+	      looped(looped),
+	      currentFrame(0)
+	{
+		chunkFrames = std::max<uint32_t>(STREAM_BUF_SIZE / clip->frameSize, 1);
+	}
+
+	~PCMSource()
+	{
+		PCMClip::deref(clip);
+	}
+
+	uint32_t endFrame() const
+	{
+		uint32_t total = clip->frameCount();
+
+		if (looped && clip->loopEnd)
+			return std::min(clip->loopEnd, total);
+
+		return total;
+	}
+
+	uint32_t wrapFrame() const
+	{
+		return clip->loopEnd ? clip->loopStart : 0;
+	}
+
+	Status fillBuffer(AL::Buffer::ID alBuffer)
+	{
+		uint32_t end = endFrame();
+
+		if (currentFrame >= end)
+		{
+			/* Nothing left to read; only possible with
+			 * an empty clip or broken loop points */
+			return ALDataSource::Error;
+		}
+
+		uint32_t frames = std::min(end - currentFrame, chunkFrames);
+
+		AL::Buffer::uploadData(alBuffer, clip->format,
+		                       &clip->data[currentFrame * clip->frameSize],
+		                       frames * clip->frameSize, clip->rate);
+
+		currentFrame += frames;
+
+		if (currentFrame < end)
+			return ALDataSource::NoError;
+
+		if (!looped)
+			return ALDataSource::EndOfStream;
+
+		currentFrame = wrapFrame();
+
+		return ALDataSource::WrapAround;
+	}
+
+	int sampleRate()
+	{
+		return clip->rate;
+	}
+
+	void seekToOffset(float seconds)
+	{
+		if (seconds <= 0)
+		{
+			currentFrame = 0;
+			return;
+		}
+
+		currentFrame = seconds * clip->rate;
+
+		if (currentFrame >= endFrame())
+			currentFrame = looped ? wrapFrame() : 0;
+	}
+
+	uint32_t loopStartFrames()
+	{
+		return wrapFrame();
+	}
+
+	bool setPitch(float)
+	{
+		return false;
+	}
+
+	void setBufferSize(uint32_t bytes)
+	{
+		chunkFrames = std::max<uint32_t>(bytes / clip->frameSize, 1);
+	}
+};
+
+ALDataSource *createPCMSource(PCMClip *clip,
+                              bool looped)
+{
+	return new PCMSource(clip, looped);
+}
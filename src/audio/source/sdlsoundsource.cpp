@@ -119,6 +119,41 @@ struct SDLSoundSource : ALDataSource
 	{
 		return false;
 	}
+
+	void setBufferSize(uint32_t bytes)
+	{
+		/* Has to be a multiple of the frame size */
+		uint32_t frameSize = sampleSize * sample->actual.channels;
+
+		if (frameSize == 0 || bytes < frameSize)
+			return;
+
+		Sound_SetBufferSize(sample, bytes - bytes % frameSize);
+	}
+
+	PCMClip *decodeAll(float maxSeconds)
+	{
+		Sint32 duration = Sound_GetDuration(sample);
+
+		if (duration < 0 || duration > maxSeconds * 1000)
+			return 0;
+
+		Sound_Rewind(sample);
+		uint32_t decoded = Sound_DecodeAll(sample);
+
+		if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+			return 0;
+
+		const uint8_t *buffer = static_cast<const uint8_t*>(sample->buffer);
+
+		PCMClip *clip = new PCMClip;
+		clip->data.assign(buffer, buffer + decoded);
+		clip->format = alFormat;
+		clip->rate = alFreq;
+		clip->frameSize = sampleSize * sample->actual.channels;
+
+		return clip;
+	}
 };
 
 ALDataSource *createSDLSource(SDL_RWops &ops,
@@ -27,10 +27,11 @@
 #include "config.h"
 #include "util.h"
 #include "debugwriter.h"
+#include "sdl-util.h"
+#include "graphics.h"
 
 #include <SDL2/SDL_sound.h>
-
-#define SE_CACHE_MEM (10*1024*1024) // 10 MB
+#include <SDL2/SDL_timer.h>
 
 struct SoundBuffer
 {
@@ -45,6 +46,9 @@ struct SoundBuffer
 	/* Buffer byte count */
 	uint32_t bytes;
 
+	/* Playback length at normal pitch */
+	uint32_t durationMs;
+
 	/* Reference count */
 	uint8_t refCount;
 
@@ -76,122 +80,268 @@ private:
 	}
 };
 
-/* Before: [a][b][c][d], After (index=1): [a][c][d][b] */
-static void
-arrayPushBack(std::vector<size_t> &array, size_t size, size_t index)
+/* A sound whose header has been parsed on the RGSS thread,
+ * waiting to be fully decoded by a worker */
+struct SoundDecodeJob
 {
-	size_t v = array[index];
+	std::string key;
+
+	/* Encoded file contents; 'sample' reads from these */
+	std::vector<uint8_t> data;
+	Sound_Sample *sample;
+
+	/* Plays requested before decoding finished */
+	struct Play
+	{
+		float volume;
+		float pitch;
+		int priority;
+	};
 
-	for (size_t t = index; t < size-1; ++t)
-		array[t] = array[t+1];
+	std::vector<Play> plays;
+};
 
-	array[size-1] = v;
+/* SDL_GetTicks() wraps around */
+static inline bool ticksBefore(uint32_t a, uint32_t b)
+{
+	return (int32_t) (a - b) < 0;
 }
 
 SoundEmitter::SoundEmitter(const Config &conf)
     : bufferBytes(0),
-      srcCount(conf.SE.sourceCount),
-      alSrcs(srcCount),
-      atchBufs(srcCount),
-      srcPrio(srcCount)
+      cacheBudget(conf.SE.cacheSize * 1024 * 1024),
+      quitWorkers(false),
+      framePlaysFrame(0)
 {
+	stats.steals = 0;
+	stats.coalesced = 0;
+	stats.dropped = 0;
+
 	effectSlot = AL::AuxiliaryEffectSlot::gen();
-	for (size_t i = 0; i < srcCount; ++i)
-	{
-		alSrcs[i] = AL::Source::gen();
-		AL::Source::setAuxEffectSlot(alSrcs[i], effectSlot);
-		atchBufs[i] = 0;
-		srcPrio[i] = i;
 
-	}
+	voices.resize(conf.SE.sourceCount);
+
+	for (size_t i = 0; i < voices.size(); ++i)
+		initVoice(voices[i]);
+
+	mutex = SDL_CreateMutex();
+	jobCond = SDL_CreateCond();
+
+	for (int i = 0; i < conf.SE.decodeThreads; ++i)
+		workers.push_back(createSDLThread
+			<SoundEmitter, &SoundEmitter::decodeWorker>(this, "se_decode"));
 }
 
 SoundEmitter::~SoundEmitter()
 {
-	for (size_t i = 0; i < srcCount; ++i)
-	{
-		AL::Source::stop(alSrcs[i]);
-		AL::Source::del(alSrcs[i]);
+	SDL_LockMutex(mutex);
+	quitWorkers = true;
+	SDL_CondBroadcast(jobCond);
+	SDL_UnlockMutex(mutex);
 
-		if (atchBufs[i])
-			SoundBuffer::deref(atchBufs[i]);
+	for (size_t i = 0; i < workers.size(); ++i)
+		SDL_WaitThread(workers[i], 0);
+
+	/* Jobs no worker got to anymore */
+	for (size_t i = 0; i < jobQueue.size(); ++i)
+	{
+		Sound_FreeSample(jobQueue[i]->sample);
+		delete jobQueue[i];
 	}
 
+	for (size_t i = 0; i < voices.size(); ++i)
+		releaseVoice(voices[i]);
+
 	BufferHash::const_iterator iter;
 	for (iter = bufferHash.cbegin(); iter != bufferHash.cend(); ++iter)
 		SoundBuffer::deref(iter->second);
+
+	SDL_DestroyCond(jobCond);
+	SDL_DestroyMutex(mutex);
 }
 
 void SoundEmitter::play(const std::string &filename,
                         int volume,
-                        int pitch)
+                        int pitch,
+                        int priority)
 {
+	/* Many events triggering the same sound in one frame
+	 * would otherwise each take a voice and restart it */
+	unsigned int frame = shState->graphics().frameSerial();
+
+	if (frame != framePlaysFrame)
+	{
+		framePlays.clear();
+		framePlaysFrame = frame;
+	}
+
+	for (size_t i = 0; i < framePlays.size(); ++i)
+	{
+		const FramePlay &fp = framePlays[i];
+
+		/* A repeat with a different priority still goes through,
+		 * so a low priority one can't suppress a higher one */
+		if (fp.volume == volume && fp.pitch == pitch &&
+		    fp.priority == priority && fp.filename == filename)
+		{
+			SDL_LockMutex(mutex);
+			++stats.coalesced;
+			SDL_UnlockMutex(mutex);
+
+			return;
+		}
+	}
+
+	FramePlay fp = { filename, volume, pitch, priority };
+	framePlays.push_back(fp);
+
 	float _volume = clamp<int>(volume, 0, 100) / 100.0f;
 	float _pitch  = clamp<int>(pitch, 50, 150) / 100.0f;
 
-	SoundBuffer *buffer = allocateBuffer(filename);
+	SDL_LockMutex(mutex);
+
+	SoundBuffer *buffer = findBuffer(filename);
+
+	if (buffer)
+	{
+		playBuffer(buffer, _volume, _pitch, priority);
+		SDL_UnlockMutex(mutex);
 
-	if (!buffer)
 		return;
+	}
 
-	/* Try to find first free source */
-	size_t i;
-	for (i = 0; i < srcCount; ++i)
-		if (AL::Source::getState(alSrcs[srcPrio[i]]) != AL_PLAYING)
-			break;
+	SoundDecodeJob *job = pendingJobs.value(filename, 0);
 
-	/* If we didn't find any, try to find the lowest priority source
-	 * with the same buffer to overtake */
-	if (i == srcCount)
-		for (size_t j = 0; j < srcCount; ++j)
-			if (atchBufs[srcPrio[j]] == buffer)
-				i = j;
+	if (job)
+	{
+		SoundDecodeJob::Play play = { _volume, _pitch, priority };
+		job->plays.push_back(play);
+	}
 
-	/* If we didn't find any, overtake the one with lowest priority */
-	if (i == srcCount)
-		i = 0;
+	SDL_UnlockMutex(mutex);
 
-	size_t srcIndex = srcPrio[i];
+	if (!job)
+		startDecode(filename, true, _volume, _pitch, priority);
+}
 
-	/* Only detach/reattach if it's actually a different buffer */
-	bool switchBuffer = (atchBufs[srcIndex] != buffer);
+void SoundEmitter::preload(const std::string &filename)
+{
+	SDL_LockMutex(mutex);
+	bool needed = !bufferHash.contains(filename) && !pendingJobs.contains(filename);
+	SDL_UnlockMutex(mutex);
 
-	/* Push the used source to the back of the priority list */
-	arrayPushBack(srcPrio, srcCount, i);
+	if (needed)
+		startDecode(filename, false);
+}
 
-	AL::Source::ID src = alSrcs[srcIndex];
-	AL::Source::stop(src);
+void SoundEmitter::stop()
+{
+	SDL_LockMutex(mutex);
 
-	if (switchBuffer)
-		AL::Source::detachBuffer(src);
+	for (size_t i = 0; i < voices.size(); i++)
+	{
+		AL::Source::stop(voices[i].src);
+		voices[i].endTicks = voices[i].startTicks;
+	}
+
+	/* Sounds still decoding will only be cached */
+	JobHash::const_iterator iter;
+	for (iter = pendingJobs.cbegin(); iter != pendingJobs.cend(); ++iter)
+		iter->second->plays.clear();
 
-	SoundBuffer *old = atchBufs[srcIndex];
+	SDL_UnlockMutex(mutex);
+}
 
-	if (old)
-		SoundBuffer::deref(old);
+size_t SoundEmitter::voiceCount() const
+{
+	SDL_LockMutex(mutex);
+	size_t result = voices.size();
+	SDL_UnlockMutex(mutex);
 
-	atchBufs[srcIndex] = SoundBuffer::ref(buffer);
+	return result;
+}
 
-	if (switchBuffer)
-		AL::Source::attachBuffer(src, buffer->alBuffer);
+void SoundEmitter::setVoiceCount(size_t count)
+{
+	count = clamp<size_t>(count, 1, 64);
 
-	AL::Source::setVolume(src, _volume * GLOBAL_VOLUME);
-	AL::Source::setPitch(src, _pitch);
+	SDL_LockMutex(mutex);
 
-	AL::Source::play(src);
+	for (size_t i = count; i < voices.size(); ++i)
+		releaseVoice(voices[i]);
+
+	size_t oldCount = voices.size();
+	voices.resize(count);
+
+	for (size_t i = oldCount; i < count; ++i)
+		initVoice(voices[i]);
+
+	SDL_UnlockMutex(mutex);
 }
 
-void SoundEmitter::stop()
+size_t SoundEmitter::activeVoices()
 {
-	for (size_t i = 0; i < srcCount; i++)
-		AL::Source::stop(alSrcs[i]);
+	uint32_t now = SDL_GetTicks();
+	size_t active = 0;
+
+	SDL_LockMutex(mutex);
+
+	for (size_t i = 0; i < voices.size(); ++i)
+		if (ticksBefore(now, voices[i].endTicks))
+			++active;
+
+	SDL_UnlockMutex(mutex);
+
+	return active;
+}
+
+uint32_t SoundEmitter::cacheBytes()
+{
+	SDL_LockMutex(mutex);
+	uint32_t result = bufferBytes;
+	SDL_UnlockMutex(mutex);
+
+	return result;
+}
+
+SoundEmitter::Stats SoundEmitter::queryStats()
+{
+	SDL_LockMutex(mutex);
+	Stats result = stats;
+	SDL_UnlockMutex(mutex);
+
+	return result;
+}
+
+void SoundEmitter::initVoice(Voice &voice)
+{
+	voice.src = AL::Source::gen();
+	voice.buffer = 0;
+	voice.startTicks = voice.endTicks = SDL_GetTicks();
+	voice.priority = 0;
+
+	AL::Source::setAuxEffectSlot(voice.src, effectSlot);
+
+	if (!AL::Filter::isNullFilter(curfilter))
+		AL::Source::setFilter(voice.src, curfilter);
+}
+
+void SoundEmitter::releaseVoice(Voice &voice)
+{
+	AL::Source::stop(voice.src);
+	AL::Source::del(voice.src);
+
+	if (voice.buffer)
+		SoundBuffer::deref(voice.buffer);
 }
 
 void SoundEmitter::setALFilter(AL::Filter::ID filter) {
-	for (size_t i = 0; i < srcCount; ++i)
+	SDL_LockMutex(mutex);
+	for (size_t i = 0; i < voices.size(); ++i)
 	{
-		AL::Source::setFilter(alSrcs[i], filter);
+		AL::Source::setFilter(voices[i].src, filter);
 	}
+	SDL_UnlockMutex(mutex);
 	if(!(curfilter == filter) && !AL::Filter::isNullFilter(curfilter)) {
 		AL::Filter::del(curfilter);
 	}
@@ -207,95 +357,254 @@ void SoundEmitter::setALEffect(ALuint effect) {
 	cureffect = effect;
 }
 
+void SoundEmitter::playBuffer(SoundBuffer *buffer, float volume, float pitch, int priority)
+{
+	uint32_t now = SDL_GetTicks();
+	Voice *voice = 0;
+
+	/* Prefer a free voice that already has the buffer attached */
+	for (size_t i = 0; i < voices.size(); ++i)
+	{
+		Voice &v = voices[i];
+
+		if (ticksBefore(now, v.endTicks))
+			continue;
+
+		if (!voice || v.buffer == buffer)
+			voice = &v;
+
+		if (v.buffer == buffer)
+			break;
+	}
+
+	if (!voice)
+	{
+		/* Overtake the oldest voice with the lowest priority */
+		for (size_t i = 0; i < voices.size(); ++i)
+		{
+			Voice &v = voices[i];
+
+			if (!voice || v.priority < voice->priority ||
+			    (v.priority == voice->priority && ticksBefore(v.startTicks, voice->startTicks)))
+				voice = &v;
+		}
+
+		if (voice->priority > priority)
+		{
+			++stats.dropped;
+			return;
+		}
+
+		++stats.steals;
+	}
+
+	AL::Source::ID src = voice->src;
+	AL::Source::stop(src);
+
+	/* Only detach/reattach if it's actually a different buffer */
+	if (voice->buffer != buffer)
+	{
+		AL::Source::detachBuffer(src);
+
+		if (voice->buffer)
+			SoundBuffer::deref(voice->buffer);
+
+		voice->buffer = SoundBuffer::ref(buffer);
+		AL::Source::attachBuffer(src, buffer->alBuffer);
+	}
+
+	AL::Source::setVolume(src, volume * GLOBAL_VOLUME);
+	AL::Source::setPitch(src, pitch);
+
+	AL::Source::play(src);
+
+	voice->startTicks = now;
+	voice->endTicks = now + (uint32_t) (buffer->durationMs / pitch);
+	voice->priority = priority;
+}
+
 struct SoundOpenHandler : FileSystem::OpenHandler
 {
-	SoundBuffer *buffer;
+	SoundDecodeJob *job;
 
 	SoundOpenHandler()
-	    : buffer(0)
+	    : job(0)
 	{}
 
 	bool tryRead(SDL_RWops &ops, const char *ext)
 	{
-		Sound_Sample *sample = Sound_NewSample(&ops, ext, 0, STREAM_BUF_SIZE);
+		/* Slurp the file so the worker doesn't have to
+		 * touch the file system */
+		Sint64 size = SDL_RWsize(&ops);
+		std::vector<uint8_t> data(size > 0 ? size : 0);
+
+		if (size > 0)
+			SDL_RWread(&ops, &data[0], 1, size);
+
+		SDL_RWclose(&ops);
+
+		if (data.empty())
+			return false;
+
+		SDL_RWops *memOps = SDL_RWFromConstMem(&data[0], data.size());
+		Sound_Sample *sample = Sound_NewSample(memOps, ext, 0, STREAM_BUF_SIZE);
 
 		if (!sample)
 		{
-			SDL_RWclose(&ops);
+			SDL_RWclose(memOps);
 			return false;
 		}
 
-		/* Do all of the decoding in the handler so we don't have
-		 * to keep the source ops around */
-		uint32_t decBytes = Sound_DecodeAll(sample);
-		uint8_t sampleSize = formatSampleSize(sample->actual.format);
-		uint32_t sampleCount = decBytes / sampleSize;
+		/* 'data' is moved without reallocating, so
+		 * 'memOps' stays valid */
+		job = new SoundDecodeJob;
+		job->data.swap(data);
+		job->sample = sample;
+
+		return true;
+	}
+};
+
+static SoundBuffer *decodeSample(Sound_Sample *sample)
+{
+	uint32_t decBytes = Sound_DecodeAll(sample);
+	uint8_t sampleSize = formatSampleSize(sample->actual.format);
+	uint32_t sampleCount = decBytes / sampleSize;
 
-		buffer = new SoundBuffer;
-		buffer->bytes = sampleSize * sampleCount;
+	SoundBuffer *buffer = new SoundBuffer;
+	buffer->bytes = sampleSize * sampleCount;
 
-		ALenum alFormat = chooseALFormat(sampleSize, sample->actual.channels);
+	uint32_t frames = sampleCount / std::max<int>(sample->actual.channels, 1);
+	buffer->durationMs = ((uint64_t) frames * 1000) / std::max<uint32_t>(sample->actual.rate, 1);
 
-		AL::Buffer::uploadData(buffer->alBuffer, alFormat, sample->buffer,
-							   buffer->bytes, sample->actual.rate);
+	ALenum alFormat = chooseALFormat(sampleSize, sample->actual.channels);
 
-		Sound_FreeSample(sample);
+	AL::Buffer::uploadData(buffer->alBuffer, alFormat, sample->buffer,
+						   buffer->bytes, sample->actual.rate);
 
-		return true;
-	}
-};
+	Sound_FreeSample(sample);
 
-SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
+	return buffer;
+}
+
+void SoundEmitter::startDecode(const std::string &filename, bool play,
+                               float volume, float pitch, int priority)
 {
-	SoundBuffer *buffer = bufferHash.value(filename, 0);
+	SoundOpenHandler handler;
+	shState->fileSystem().openRead(handler, filename.c_str());
+	SoundDecodeJob *job = handler.job;
 
-	if (buffer)
+	if (!job)
 	{
-		/* Buffer still in cashe.
-		 * Move to front of priority list */
-		buffers.remove(buffer->link);
-		buffers.append(buffer->link);
+		char buf[512];
+		snprintf(buf, sizeof(buf), "Unable to decode sound: %s: %s",
+		         filename.c_str(), Sound_GetError());
+		Debug() << buf;
 
-		return buffer;
+		return;
 	}
-	else
+
+	job->key = filename;
+
+	if (play)
 	{
-		/* Buffer not in cache, needs to be loaded */
-		SoundOpenHandler handler;
-		shState->fileSystem().openRead(handler, filename.c_str());
-		buffer = handler.buffer;
+		SoundDecodeJob::Play p = { volume, pitch, priority };
+		job->plays.push_back(p);
+	}
 
-		if (!buffer)
-		{
-			char buf[512];
-			snprintf(buf, sizeof(buf), "Unable to decode sound: %s: %s",
-			         filename.c_str(), Sound_GetError());
-			Debug() << buf;
+	if (workers.empty())
+	{
+		SoundBuffer *buffer = decodeSample(job->sample);
 
-			return 0;
-		}
+		SDL_LockMutex(mutex);
+		finishDecode(job, buffer);
+		SDL_UnlockMutex(mutex);
 
-		buffer->key = filename;
-		uint32_t wouldBeBytes = bufferBytes + buffer->bytes;
+		return;
+	}
 
-		/* If memory limit is reached, delete lowest priority buffer
-		 * until there is room or no buffers left */
-		while (wouldBeBytes > SE_CACHE_MEM && !buffers.isEmpty())
-		{
-			SoundBuffer *last = buffers.tail();
-			bufferHash.remove(last->key);
-			buffers.remove(last->link);
+	SDL_LockMutex(mutex);
 
-			wouldBeBytes -= last->bytes;
+	pendingJobs.insert(filename, job);
+	jobQueue.push_back(job);
+	SDL_CondSignal(jobCond);
 
-			SoundBuffer::deref(last);
-		}
+	SDL_UnlockMutex(mutex);
+}
+
+void SoundEmitter::decodeWorker()
+{
+	SDL_LockMutex(mutex);
 
-		bufferHash.insert(filename, buffer);
-		buffers.prepend(buffer->link);
+	while (true)
+	{
+		while (!quitWorkers && jobQueue.empty())
+			SDL_CondWait(jobCond, mutex);
 
-		bufferBytes = wouldBeBytes;
+		if (quitWorkers)
+			break;
 
-		return buffer;
+		SoundDecodeJob *job = jobQueue.front();
+		jobQueue.pop_front();
+
+		SDL_UnlockMutex(mutex);
+		SoundBuffer *buffer = decodeSample(job->sample);
+		SDL_LockMutex(mutex);
+
+		finishDecode(job, buffer);
+	}
+
+	SDL_UnlockMutex(mutex);
+}
+
+void SoundEmitter::finishDecode(SoundDecodeJob *job, SoundBuffer *buffer)
+{
+	pendingJobs.remove(job->key);
+
+	buffer->key = job->key;
+	insertBuffer(buffer);
+
+	for (size_t i = 0; i < job->plays.size(); ++i)
+		playBuffer(buffer, job->plays[i].volume, job->plays[i].pitch,
+		           job->plays[i].priority);
+
+	delete job;
+}
+
+SoundBuffer *SoundEmitter::findBuffer(const std::string &filename)
+{
+	SoundBuffer *buffer = bufferHash.value(filename, 0);
+
+	if (!buffer)
+		return 0;
+
+	/* Buffer still in cashe.
+	 * Move to front of priority list */
+	buffers.remove(buffer->link);
+	buffers.prepend(buffer->link);
+
+	return buffer;
+}
+
+void SoundEmitter::insertBuffer(SoundBuffer *buffer)
+{
+	uint32_t wouldBeBytes = bufferBytes + buffer->bytes;
+
+	/* If memory limit is reached, delete lowest priority buffer
+	 * until there is room or no buffers left */
+	while (wouldBeBytes > cacheBudget && !buffers.isEmpty())
+	{
+		SoundBuffer *last = buffers.tail();
+		bufferHash.remove(last->key);
+		buffers.remove(last->link);
+
+		wouldBeBytes -= last->bytes;
+
+		SoundBuffer::deref(last);
 	}
+
+	bufferHash.insert(buffer->key, buffer);
+	buffers.prepend(buffer->link);
+
+	bufferBytes = wouldBeBytes;
 }
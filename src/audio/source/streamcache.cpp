@@ -0,0 +1,634 @@
+/*
+** streamcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2014 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streamcache.h"
+
+#include "aldatasource.h"
+#include "sharedstate.h"
+#include "filesystem.h"
+#include "exception.h"
+#include "config.h"
+#include "util.h"
+#include "sdl-util.h"
+#include "debugwriter.h"
+
+#include <SDL2/SDL_rwops.h>
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+/* Idle decoders kept around per cached file */
+#define MAX_IDLE_DECODERS 2
+
+/* Encoded file contents shared between decoders */
+struct EncodedFile
+{
+	std::vector<uint8_t> data;
+
+	EncodedFile()
+	{
+		SDL_AtomicSet(&refCount, 1);
+	}
+
+	static EncodedFile *ref(EncodedFile *file)
+	{
+		SDL_AtomicIncRef(&file->refCount);
+
+		return file;
+	}
+
+	static void deref(EncodedFile *file)
+	{
+		if (SDL_AtomicDecRef(&file->refCount))
+			delete file;
+	}
+
+private:
+	SDL_atomic_t refCount;
+};
+
+/* In-place read-only ops over an EncodedFile, which
+ * (like the PhysFS ops) don't free themselves on close */
+static inline EncodedFile *memFile(SDL_RWops *ops)
+{
+	return static_cast<EncodedFile*>(ops->hidden.unknown.data1);
+}
+
+static inline Sint64 memPos(SDL_RWops *ops)
+{
+	return reinterpret_cast<intptr_t>(ops->hidden.unknown.data2);
+}
+
+static inline void setMemPos(SDL_RWops *ops, Sint64 pos)
+{
+	ops->hidden.unknown.data2 = reinterpret_cast<void*>(static_cast<intptr_t>(pos));
+}
+
+static Sint64 memSize(SDL_RWops *ops)
+{
+	return memFile(ops)->data.size();
+}
+
+static Sint64 memSeek(SDL_RWops *ops, Sint64 offset, int whence)
+{
+	Sint64 size = memSize(ops);
+	Sint64 base;
+
+	switch (whence)
+	{
+	case RW_SEEK_SET :
+		base = 0;
+		break;
+	case RW_SEEK_CUR :
+		base = memPos(ops);
+		break;
+	case RW_SEEK_END :
+		base = size;
+		break;
+	default:
+		return -1;
+	}
+
+	setMemPos(ops, clamp<Sint64>(base + offset, 0, size));
+
+	return memPos(ops);
+}
+
+static size_t memRead(SDL_RWops *ops, void *buffer, size_t size, size_t maxnum)
+{
+	if (size == 0)
+		return 0;
+
+	const std::vector<uint8_t> &data = memFile(ops)->data;
+	Sint64 pos = memPos(ops);
+
+	size_t num = std::min<size_t>(maxnum, (data.size() - pos) / size);
+
+	if (num > 0)
+		memcpy(buffer, &data[pos], num * size);
+
+	setMemPos(ops, pos + num * size);
+
+	return num;
+}
+
+static size_t memWrite(SDL_RWops *, const void *, size_t, size_t)
+{
+	return 0;
+}
+
+static int memClose(SDL_RWops *ops)
+{
+	EncodedFile *file = memFile(ops);
+
+	if (file)
+		EncodedFile::deref(file);
+
+	ops->hidden.unknown.data1 = 0;
+
+	return 0;
+}
+
+/* Takes over the passed reference to 'file' */
+static void initMemOps(SDL_RWops &ops, EncodedFile *file)
+{
+	memset(&ops, 0, sizeof(ops));
+
+	ops.size  = memSize;
+	ops.seek  = memSeek;
+	ops.read  = memRead;
+	ops.write = memWrite;
+	ops.close = memClose;
+
+	ops.type = SDL_RWOPS_UNKNOWN;
+	ops.hidden.unknown.data1 = file;
+	setMemPos(&ops, 0);
+}
+
+/* A data source together with the ops it reads from */
+struct StreamDecoder
+{
+	SDL_RWops ops;
+	ALDataSource *source;
+
+	StreamDecoder()
+	    : source(0)
+	{}
+
+	~StreamDecoder()
+	{
+		/* This also closes 'ops' */
+		delete source;
+	}
+
+	bool open(const char *ext, bool looped, std::string &errorMsg)
+	{
+		/* Try to read ogg file signature */
+		char sig[5] = { 0 };
+		SDL_RWread(&ops, sig, 1, 4);
+		SDL_RWseek(&ops, 0, RW_SEEK_SET);
+
+		try
+		{
+			if (!strcmp(sig, "OggS"))
+				source = createVorbisSource(ops, looped);
+			else
+				source = createSDLSource(ops, ext, STREAM_BUF_SIZE, looped);
+		}
+		catch (const Exception &e)
+		{
+			/* All source constructors will close the passed ops
+			 * before throwing errors */
+			errorMsg = e.msg;
+			return false;
+		}
+
+		return true;
+	}
+};
+
+struct StreamCacheEntry
+{
+	std::string key;
+	std::string ext;
+	bool looped;
+
+	/* Exactly one of these is set */
+	PCMClip *clip;
+	EncodedFile *file;
+
+	/* Decoders over 'file' not currently in use */
+	std::vector<StreamDecoder*> idle;
+
+	uint32_t bytes;
+
+	IntruListLink<StreamCacheEntry> link;
+
+	StreamCacheEntry()
+	    : looped(false), clip(0), file(0), bytes(0), link(this)
+	{}
+
+	~StreamCacheEntry()
+	{
+		for (size_t i = 0; i < idle.size(); ++i)
+			delete idle[i];
+
+		if (clip)
+			PCMClip::deref(clip);
+
+		if (file)
+			EncodedFile::deref(file);
+	}
+};
+
+/* Hands its decoder back to the cache when deleted */
+struct CachedSource : ALDataSource
+{
+	StreamCache *cache;
+	std::string key;
+	StreamDecoder *decoder;
+
+	CachedSource(StreamCache *cache,
+	             const std::string &key,
+	             StreamDecoder *decoder)
+	    : cache(cache), key(key), decoder(decoder)
+	{}
+
+	~CachedSource()
+	{
+		cache->release(key, decoder);
+	}
+
+	Status fillBuffer(AL::Buffer::ID alBuffer)
+	{
+		return decoder->source->fillBuffer(alBuffer);
+	}
+
+	int sampleRate()
+	{
+		return decoder->source->sampleRate();
+	}
+
+	void seekToOffset(float seconds)
+	{
+		decoder->source->seekToOffset(seconds);
+	}
+
+	uint32_t loopStartFrames()
+	{
+		return decoder->source->loopStartFrames();
+	}
+
+	bool setPitch(float value)
+	{
+		return decoder->source->setPitch(value);
+	}
+
+	void setBufferSize(uint32_t bytes)
+	{
+		decoder->source->setBufferSize(bytes);
+	}
+};
+
+struct StreamOpenHandler : FileSystem::OpenHandler
+{
+	bool looped;
+
+	/* Files up to this size are read into memory */
+	uint32_t maxFileBytes;
+
+	StreamDecoder *decoder;
+	EncodedFile *file;
+	std::string ext;
+	std::string errorMsg;
+
+	StreamOpenHandler(bool looped, uint32_t maxFileBytes)
+	    : looped(looped), maxFileBytes(maxFileBytes),
+	      decoder(0), file(0)
+	{}
+
+	bool tryRead(SDL_RWops &ops, const char *ext)
+	{
+		Sint64 size = SDL_RWsize(&ops);
+
+		decoder = new StreamDecoder;
+
+		if (size > 0 && size <= maxFileBytes)
+		{
+			file = new EncodedFile;
+			file->data.resize(size);
+
+			size_t read = SDL_RWread(&ops, &file->data[0], 1, size);
+			file->data.resize(read);
+			SDL_RWclose(&ops);
+
+			initMemOps(decoder->ops, EncodedFile::ref(file));
+		}
+		else
+		{
+			/* Copy this because we need to keep it around,
+			 * as we will continue reading data from it later */
+			decoder->ops = ops;
+		}
+
+		if (!decoder->open(ext, looped, errorMsg))
+		{
+			delete decoder;
+			decoder = 0;
+
+			if (file)
+				EncodedFile::deref(file);
+
+			file = 0;
+
+			return false;
+		}
+
+		this->ext = ext ? ext : "";
+
+		return true;
+	}
+};
+
+StreamCache::StreamCache(const Config &conf)
+    : budget(conf.streamCache.size * 1024 * 1024),
+      decodeSeconds(conf.streamCache.decodeSeconds),
+      bytes(0),
+      hits(0),
+      misses(0),
+      quitWorker(false),
+      worker(0)
+{
+	mutex = SDL_CreateMutex();
+	jobCond = SDL_CreateCond();
+
+	if (budget > 0 && decodeSeconds > 0)
+		worker = createSDLThread
+			<StreamCache, &StreamCache::decodeWorker>(this, "stream_decode");
+}
+
+StreamCache::~StreamCache()
+{
+	SDL_LockMutex(mutex);
+	quitWorker = true;
+	SDL_CondBroadcast(jobCond);
+	SDL_UnlockMutex(mutex);
+
+	if (worker)
+		SDL_WaitThread(worker, 0);
+
+	/* Jobs the worker didn't get to anymore */
+	for (size_t i = 0; i < jobQueue.size(); ++i)
+		EncodedFile::deref(jobQueue[i].file);
+
+	while (!entries.isEmpty())
+		removeEntry(entries.tail());
+
+	SDL_DestroyCond(jobCond);
+	SDL_DestroyMutex(mutex);
+}
+
+ALDataSource *StreamCache::open(const std::string &filename,
+                                bool looped,
+                                std::string &errorMsg)
+{
+	std::string key = filename + (looped ? "|looped" : "");
+
+	SDL_LockMutex(mutex);
+
+	StreamCacheEntry *entry = entryHash.value(key, 0);
+
+	if (entry)
+	{
+		++hits;
+
+		entries.remove(entry->link);
+		entries.prepend(entry->link);
+
+		if (entry->clip)
+		{
+			ALDataSource *source = createPCMSource(PCMClip::ref(entry->clip), looped);
+			SDL_UnlockMutex(mutex);
+
+			return source;
+		}
+
+		if (!entry->idle.empty())
+		{
+			/* Rewound by ALStream before playing */
+			StreamDecoder *decoder = entry->idle.back();
+			entry->idle.pop_back();
+			SDL_UnlockMutex(mutex);
+
+			return new CachedSource(this, key, decoder);
+		}
+
+		/* Parsing the headers takes a while; hold on to the
+		 * contents so they stay alive without the lock */
+		EncodedFile *file = EncodedFile::ref(entry->file);
+		std::string ext = entry->ext;
+
+		SDL_UnlockMutex(mutex);
+
+		StreamDecoder *decoder = new StreamDecoder;
+		initMemOps(decoder->ops, file);
+
+		if (!decoder->open(ext.c_str(), looped, errorMsg))
+		{
+			delete decoder;
+			return 0;
+		}
+
+		return new CachedSource(this, key, decoder);
+	}
+
+	++misses;
+
+	SDL_UnlockMutex(mutex);
+
+	/* Don't let a single file flush out everything else */
+	StreamOpenHandler handler(looped, budget / 4);
+	shState->fileSystem().openRead(handler, filename.c_str());
+
+	if (!handler.decoder)
+	{
+		errorMsg = handler.errorMsg;
+		return 0;
+	}
+
+	/* Too large to keep around */
+	if (!handler.file)
+		return new CachedSource(this, std::string(), handler.decoder);
+
+	entry = new StreamCacheEntry;
+	entry->key = key;
+	entry->ext = handler.ext;
+	entry->looped = looped;
+	entry->file = handler.file;
+	entry->bytes = handler.file->data.size();
+
+	SDL_LockMutex(mutex);
+
+	insertEntry(entry);
+
+	/* Play right away from the encoded contents; if the
+	 * stream is short enough, the worker decodes it for
+	 * the next plays */
+	if (worker)
+	{
+		DecodeJob job;
+		job.key = key;
+		job.ext = handler.ext;
+		job.looped = looped;
+		job.file = EncodedFile::ref(handler.file);
+
+		jobQueue.push_back(job);
+		SDL_CondSignal(jobCond);
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	return new CachedSource(this, key, handler.decoder);
+}
+
+StreamCache::Stats StreamCache::stats()
+{
+	SDL_LockMutex(mutex);
+
+	Stats st;
+	st.hits = hits;
+	st.misses = misses;
+	st.entries = entries.getSize();
+	st.bytes = bytes;
+
+	SDL_UnlockMutex(mutex);
+
+	return st;
+}
+
+void StreamCache::release(const std::string &key, StreamDecoder *decoder)
+{
+	SDL_LockMutex(mutex);
+
+	StreamCacheEntry *entry = key.empty() ? 0 : entryHash.value(key, 0);
+
+	if (entry && entry->file && entry->idle.size() < MAX_IDLE_DECODERS)
+	{
+		entry->idle.push_back(decoder);
+		SDL_UnlockMutex(mutex);
+
+		return;
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	delete decoder;
+}
+
+void StreamCache::insertEntry(StreamCacheEntry *entry)
+{
+	/* Opened twice concurrently, or too large */
+	if (entryHash.contains(entry->key) || entry->bytes > budget)
+	{
+		delete entry;
+		return;
+	}
+
+	while (bytes + entry->bytes > budget && !entries.isEmpty())
+		removeEntry(entries.tail());
+
+	entryHash.insert(entry->key, entry);
+	entries.prepend(entry->link);
+
+	bytes += entry->bytes;
+}
+
+void StreamCache::storeClip(StreamCacheEntry *entry, PCMClip *clip)
+{
+	/* Taken out and inserted again, so the
+	 * budget is enforced for the new size */
+	entryHash.remove(entry->key);
+	entries.remove(entry->link);
+	bytes -= entry->bytes;
+
+	/* Decoders still in use get deleted once released */
+	for (size_t i = 0; i < entry->idle.size(); ++i)
+		delete entry->idle[i];
+
+	entry->idle.clear();
+
+	EncodedFile::deref(entry->file);
+	entry->file = 0;
+
+	entry->clip = clip;
+	entry->bytes = clip->data.size();
+
+	insertEntry(entry);
+}
+
+PCMClip *StreamCache::decodeClip(const DecodeJob &job)
+{
+	/* A decoder of its own, the one playing
+	 * the stream meanwhile is left alone */
+	StreamDecoder decoder;
+	initMemOps(decoder.ops, EncodedFile::ref(job.file));
+
+	std::string errorMsg;
+
+	if (!decoder.open(job.ext.c_str(), job.looped, errorMsg))
+	{
+		Debug() << "Stream cache: decoding" << job.key << "failed:" << errorMsg;
+		return 0;
+	}
+
+	return decoder.source->decodeAll(decodeSeconds);
+}
+
+void StreamCache::decodeWorker()
+{
+	SDL_LockMutex(mutex);
+
+	while (true)
+	{
+		while (!quitWorker && jobQueue.empty())
+			SDL_CondWait(jobCond, mutex);
+
+		if (quitWorker)
+			break;
+
+		DecodeJob job = jobQueue.front();
+		jobQueue.pop_front();
+
+		SDL_UnlockMutex(mutex);
+
+		PCMClip *clip = decodeClip(job);
+
+		SDL_LockMutex(mutex);
+
+		/* The entry might have been evicted (and even
+		 * cached again) while decoding */
+		StreamCacheEntry *entry = entryHash.value(job.key, 0);
+
+		if (clip && entry && entry->file == job.file)
+		{
+			storeClip(entry, clip);
+			clip = 0;
+		}
+
+		if (clip)
+			PCMClip::deref(clip);
+
+		EncodedFile::deref(job.file);
+	}
+
+	SDL_UnlockMutex(mutex);
+}
+
+void StreamCache::removeEntry(StreamCacheEntry *entry)
+{
+	entryHash.remove(entry->key);
+	entries.remove(entry->link);
+
+	bytes -= entry->bytes;
+
+	delete entry;
+}
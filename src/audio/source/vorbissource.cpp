@@ -280,6 +280,59 @@ struct VorbisSource : ALDataSource
 	{
 		return false;
 	}
+
+	void setBufferSize(uint32_t bytes)
+	{
+		sampleBuf.resize(bytes);
+	}
+
+	PCMClip *decodeAll(float maxSeconds)
+	{
+		ogg_int64_t total = ov_pcm_total(&vf, -1);
+
+		if (total < 0 || total > maxSeconds * info.rate)
+			return 0;
+
+		if (ov_raw_seek(&vf, 0) != 0)
+			return 0;
+
+		PCMClip *clip = new PCMClip;
+		std::vector<uint8_t> &data = clip->data;
+		data.resize(total * info.frameSize);
+
+		size_t used = 0;
+
+		while (used < data.size())
+		{
+			long res = ov_read(&vf, reinterpret_cast<char*>(&data[used]),
+			                   data.size() - used, 0, sizeof(int16_t), 1, 0);
+
+			if (res < 0)
+			{
+				PCMClip::deref(clip);
+				return 0;
+			}
+
+			if (res == 0)
+				break;
+
+			used += res;
+		}
+
+		data.resize(used);
+
+		clip->format = info.alFormat;
+		clip->rate = info.rate;
+		clip->frameSize = info.frameSize;
+
+		if (loop.valid)
+		{
+			clip->loopStart = loop.start;
+			clip->loopEnd = loop.end;
+		}
+
+		return clip;
+	}
 };
 
 ALDataSource *createVorbisSource(SDL_RWops &ops,
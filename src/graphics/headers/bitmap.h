@@ -102,6 +102,13 @@ public:
 
 	IntRect textSize(const char *str);
 
+	/* Word wraps 'str' to the width of 'rect' (splitting words
+	 * that are too long by themselves), and draws as many lines
+	 * as fit into it in one go, clipped to 'rect'. A 'lineHeight'
+	 * of 0 uses the font's line skip. Returns the number of lines */
+	int drawTextWrapped(const IntRect &rect, const char *str,
+	                    int align = Left, int lineHeight = 0);
+
 	DECL_ATTR(Font, Font&)
 
 	/* Sets initial reference without copying by value,
@@ -120,6 +127,10 @@ public:
 	/* Adds 'rect' to tainted area */
 	void taintArea(const IntRect &rect);
 
+	/* Stamp that changes with every modification, and
+	 * is never shared with any other bitmap */
+	unsigned int version() const;
+
 	sigc::signal<void> modified;
 
 private:
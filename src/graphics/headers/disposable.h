@@ -54,6 +54,8 @@ public:
 		releaseResources();
 		disposed = true;
 		wasDisposed();
+
+		shState->bumpSceneGeneration();
 	}
 
 	bool isDisposed() const
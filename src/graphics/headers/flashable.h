@@ -24,6 +24,7 @@
 
 #include "etc.h"
 #include "etc-internal.h"
+#include "sharedstate.h"
 
 class Flashable
 {
@@ -41,6 +42,8 @@ public:
 		if (duration < 1)
 			return;
 
+		shState->bumpSceneGeneration();
+
 		flashing = true;
 		this->duration = duration;
 		counter = 0;
@@ -60,6 +63,9 @@ public:
 		if (!flashing)
 			return;
 
+		/* Flash color (or visibility) changes every frame */
+		shState->bumpSceneGeneration();
+
 		if (++counter > duration)
 		{
 			/* Flash finished. Cleanup */
@@ -47,11 +47,25 @@ public:
 	void initFontSetCB(SDL_RWops &ops,
 	                   const std::string &filename);
 
+	/* The returned font stays open at least until the next
+	 * call; afterwards, only while 'poolGeneration()' is
+	 * unchanged (the least recently requested font is
+	 * closed once the pool is full), unless 'pinned' */
 	_TTF_Font *getFont(std::string family,
-	                   int size);
+	                   int size, bool pinned = false);
+
+	unsigned int poolGeneration() const;
 
 	bool fontPresent(std::string family) const;
 
+	/* Least recently used cache of text measurements, keyed by
+	 * 'font' (as returned from getFont()) including its current
+	 * style, and the measured string */
+	bool cachedTextSize(_TTF_Font *font, const std::string &str,
+	                    int &w, int &h);
+	void cacheTextSize(_TTF_Font *font, const std::string &str,
+	                   int w, int h);
+
 private:
 	SharedFontStatePrivate *p;
 };
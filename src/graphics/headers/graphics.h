@@ -25,6 +25,8 @@
 #include "util.h"
 #include "gl-util.h"
 
+#include <stdint.h>
+
 class Scene;
 class Bitmap;
 class Disposable;
@@ -32,6 +34,66 @@ struct RGSSThreadData;
 struct GraphicsPrivate;
 struct AtomicFlag;
 
+/* Distribution of the error between actual and ideal
+ * frame intervals, as measured by the frame limiter */
+struct FrameTimingStats
+{
+	enum
+	{
+		BucketCount = 32,
+
+		/* Bucket i covers errors in [BucketMinUs + i*BucketUs,
+		 * BucketMinUs + (i+1)*BucketUs) microseconds; the first
+		 * and last bucket also collect everything beyond */
+		BucketUs = 250,
+		BucketMinUs = -2000
+	};
+
+	uint64_t buckets[BucketCount];
+	uint64_t samples;
+
+	int64_t minUs;
+	int64_t maxUs;
+	int64_t sumUs;
+	int64_t sumAbsUs;
+
+	FrameTimingStats()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		for (int i = 0; i < BucketCount; ++i)
+			buckets[i] = 0;
+
+		samples = 0;
+		minUs = maxUs = 0;
+		sumUs = sumAbsUs = 0;
+	}
+
+	void addSample(int64_t errUs)
+	{
+		int64_t i = (errUs - BucketMinUs) / BucketUs;
+
+		if (errUs < BucketMinUs)
+			i = 0;
+		else if (i >= BucketCount)
+			i = BucketCount-1;
+
+		++buckets[i];
+
+		if (samples == 0 || errUs < minUs)
+			minUs = errUs;
+		if (samples == 0 || errUs > maxUs)
+			maxUs = errUs;
+
+		sumUs += errUs;
+		sumAbsUs += errUs < 0 ? -errUs : errUs;
+		++samples;
+	}
+};
+
 class Graphics
 {
 public:
@@ -65,6 +127,19 @@ public:
 	DECL_ATTR( Smooth,     bool )
 	DECL_ATTR( Frameskip,  bool )
 
+	/* Scene elements drawn / skipped by culling
+	 * during the last frame (for profiling) */
+	int drawnElements() const;
+	int culledElements() const;
+
+	/* Counts every update, like frame_count but
+	 * untouched by scripts assigning to that */
+	unsigned int frameSerial() const;
+
+	/* Frame pacing accuracy since startup / the last reset */
+	const FrameTimingStats &frameTiming() const;
+	void resetFrameTiming();
+
 	/* <internal> */
 	Scene *getScreen() const;
 	/* Repaint screen with static image until exitCond
@@ -75,6 +150,10 @@ public:
 
 	const TEX::ID &obscuredTex() const;
 
+	/* Called by scenes for every visible element
+	 * they composite */
+	void countElement(bool culled);
+
 private:
 	Graphics(RGSSThreadData *data);
 	~Graphics();
@@ -0,0 +1,97 @@
+/*
+** particlesystem.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include "scene.h"
+#include "disposable.h"
+#include "viewport.h"
+#include "util.h"
+
+class Bitmap;
+struct Rect;
+
+struct ParticleSystemPrivate;
+
+/* A single emitter of identical particles (rain drops, snow
+ * flakes, embers...), simulated natively and drawn in one batch.
+ *
+ * Particles spawn at random positions inside 'emitRect' (offset
+ * by ox/oy, so that, like the old RPG::Weather sprites, they stay
+ * in place when the scene scrolls), move with a randomized initial
+ * velocity plus gravity, and fade linearly from 'opacityStart' to
+ * 'opacityEnd' over their lifetime (in frames). 'update()' advances
+ * the simulation by one frame. */
+class ParticleSystem : public ViewportElement, public Disposable
+{
+public:
+	ParticleSystem(Viewport *viewport = 0);
+	~ParticleSystem();
+
+	void update();
+
+	/* Spawns 'count' particles at once, regardless of spawn rate */
+	void emit(int count);
+	void clear();
+
+	/* Particles currently alive */
+	int getCount() const;
+
+	DECL_ATTR( Bitmap,          Bitmap* )
+	DECL_ATTR( EmitRect,        Rect&   )
+	DECL_ATTR( OX,              int     )
+	DECL_ATTR( OY,              int     )
+	DECL_ATTR( Opacity,         int     )
+	DECL_ATTR( BlendType,       int     )
+
+	/* Particles spawned per frame (may be fractional) */
+	DECL_ATTR( SpawnRate,       float   )
+	DECL_ATTR( MaxParticles,    int     )
+
+	DECL_ATTR( VelocityX,       float   )
+	DECL_ATTR( VelocityY,       float   )
+	DECL_ATTR( VelocitySpreadX, float   )
+	DECL_ATTR( VelocitySpreadY, float   )
+	DECL_ATTR( GravityX,        float   )
+	DECL_ATTR( GravityY,        float   )
+
+	DECL_ATTR( Lifetime,        int     )
+	DECL_ATTR( LifetimeSpread,  int     )
+	DECL_ATTR( OpacityStart,    int     )
+	DECL_ATTR( OpacityEnd,      int     )
+
+	void initDynAttribs();
+
+private:
+	ParticleSystemPrivate *p;
+
+	void draw();
+	void onGeometryChange(const Scene::Geometry &);
+	bool isCulled() const;
+
+	void releaseResources();
+	const char *klassName() const { return "particle system"; }
+
+	ABOUT_TO_ACCESS_DISP
+};
+
+#endif // PARTICLESYSTEM_H
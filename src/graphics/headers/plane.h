@@ -56,6 +56,7 @@ private:
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	bool isCulled() const;
 
 	void releaseResources();
 	const char *klassName() const { return "plane"; }
@@ -0,0 +1,71 @@
+/*
+** preparable.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PREPARABLE_H
+#define PREPARABLE_H
+
+#include "intrulist.h"
+#include "sharedstate.h"
+
+/* Anything that has to do work (vertex generation, FBO
+ * rendering, visibility checks) immediately before a frame
+ * is drawn. Instead of being polled every frame, it queues
+ * itself into SharedState's prepare list whenever its state
+ * changes, and gets 'prepare()'d exactly once before the
+ * next frame draw. */
+class Preparable
+{
+public:
+	Preparable()
+	    : prepareLink(this)
+	{}
+
+	virtual ~Preparable()
+	{
+		shState->dequeuePrepare(*this);
+	}
+
+	/* Safe to call any number of times per frame.
+	 * Also invalidates the last composited frame */
+	void requestPrepare()
+	{
+		shState->bumpSceneGeneration();
+
+		if (isPrepareQueued())
+			return;
+
+		shState->queuePrepare(*this);
+	}
+
+	bool isPrepareQueued() const
+	{
+		return prepareLink.next != 0;
+	}
+
+	virtual void prepare() = 0;
+
+private:
+	friend struct SharedState;
+
+	IntruListLink<Preparable> prepareLink;
+};
+
+#endif // PREPARABLE_H
@@ -27,7 +27,10 @@
 #include "etc.h"
 #include "etc-internal.h"
 
+#include <vector>
+
 class SceneElement;
+class SceneLayerStrip;
 class Viewport;
 class WindowVX;
 class Window;
@@ -76,13 +79,36 @@ protected:
 	/* Notify all elements that geometry has changed */
 	void notifyGeometryChange();
 
+	bool isEmpty() const;
+
+	/* Restores the draw order after elements changed
+	 * their sort keys without being reinserted */
+	void sortElements();
+	static bool elementLess(const SceneElement *a, const SceneElement *b);
+
 	IntruList<SceneElement> elements;
+	IntruList<SceneLayerStrip> strips;
 	Geometry geometry;
 
 	friend class SceneElement;
+	friend class SceneLayerStrip;
 	friend class Window;
 	friend class WindowVX;
-	friend struct ZLayer;
+
+private:
+	/* Draws strip layers ordered before 'next'
+	 * (or all remaining ones if null) */
+	void drawStripLayers(const SceneElement *next);
+
+	/* Per strip draw position during composite() */
+	struct StripCursor
+	{
+		SceneLayerStrip *strip;
+		size_t next;
+		size_t count;
+	};
+
+	std::vector<StripCursor> stripCursors;
 };
 
 class SceneElement
@@ -114,11 +140,17 @@ protected:
 	 * cleanup (and therefore you should expect dirty state).
 	 * Do NOT touch the FBO::Draw binding. If you have to do work
 	 * immediately before drawing that touches this (such as flushing
-	 * Bitmaps), use the 'prepareDraw' signal in SharedState that
-	 * will fire immediately before each frame draw.
+	 * Bitmaps), derive from Preparable and queue yourself with
+	 * 'requestPrepare()'; you will be prepared once right before
+	 * the next frame draw.
 	 */
 	virtual void draw() = 0;
 
+	/* Whether drawing this element would have no visible
+	 * effect this frame (eg. it lies completely outside
+	 * its scene). Culled elements are skipped entirely */
+	virtual bool isCulled() const { return false; }
+
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
@@ -129,6 +161,13 @@ protected:
 	void setSpriteY(int value);
 	void unlink();
 
+	/* For batched updates: change the sort keys without reinserting
+	 * the element, returning whether they changed. The affected
+	 * scenes have to be fixed up with 'sortScene()' afterwards */
+	bool setZUnsorted(int value);
+	bool setSpriteYUnsorted(int value);
+	static void sortScene(Scene &scene);
+
 	IntruListLink<SceneElement> link;
 	const unsigned int creationStamp;
 	int z;
@@ -136,6 +175,7 @@ protected:
 	Scene *scene;
 
 	friend class Scene;
+	friend class SceneLayerStrip;
 	friend class Viewport;
 	friend struct TilemapPrivate;
 
@@ -153,10 +193,55 @@ private:
 	int spriteY;
 };
 
+/* A set of layers living at different Z values that is merged
+ * into its scene's draw order during composition, instead of
+ * taking up one SceneElement per layer. Each layer is ordered as
+ * if it was an element of its own (with a sprite Y of 0) created
+ * together with the strip. Layers that end up next to each other
+ * in the draw order are drawn in one go */
+class SceneLayerStrip
+{
+public:
+	SceneLayerStrip(Scene &scene);
+	virtual ~SceneLayerStrip();
+
+	void setVisible(bool value);
+
+protected:
+	/* Number of layers and their Z values, which
+	 * have to be ascending */
+	virtual size_t layerCount() const = 0;
+	virtual int layerZ(size_t index) const = 0;
+
+	/* Draws layers 'first' up to (excluding) 'last' */
+	virtual void drawLayers(size_t first, size_t last) = 0;
+
+	/* Whether layer 'index' comes before element 'o' */
+	bool layerBefore(size_t index, const SceneElement &o) const;
+
+	IntruListLink<SceneLayerStrip> link;
+	const unsigned int creationStamp;
+	bool visible;
+	Scene *scene;
+
+	friend class Scene;
+};
+
 #define ABOUT_TO_ACCESS_NOOP \
 	void aboutToAccess() const {}
 
 #define ABOUT_TO_ACCESS_DISP \
 	void aboutToAccess() const { guardDisposed(); }
 
+/* Like DEF_ATTR_SIMPLE, but setting the attribute
+ * invalidates the last composited frame */
+#define DEF_ATTR_SCENE(klass, name, type, location) \
+	DEF_ATTR_RD_SIMPLE(klass, name, type, location) \
+	void klass :: set##name(type value) \
+	{ \
+		guardDisposed(); \
+		location = value; \
+		shState->bumpSceneGeneration(); \
+	}
+
 #endif // SCENE_H
@@ -35,6 +35,28 @@ struct Rect;
 
 struct SpritePrivate;
 
+/* Packed per-sprite values for Sprite::batchSet. Attributes
+ * left null are not touched; 'srcRect' holds 4 ints
+ * (x, y, width, height) per sprite */
+struct SpriteBatch
+{
+	const int *x, *y, *z;
+	const int *ox, *oy;
+	const int *opacity;
+	const float *zoomX, *zoomY;
+	const float *angle;
+	const int *srcRect;
+
+	SpriteBatch()
+	    : x(0), y(0), z(0),
+	      ox(0), oy(0),
+	      opacity(0),
+	      zoomX(0), zoomY(0),
+	      angle(0),
+	      srcRect(0)
+	{}
+};
+
 class Sprite : public ViewportElement, public Flashable, public Disposable
 {
 public:
@@ -72,11 +94,17 @@ public:
 
 	void initDynAttribs();
 
+	/* Applies 'batch' to 'count' sprites; the draw order of
+	 * the affected scenes is only restored once at the end */
+	static void batchSet(Sprite *const *sprites, size_t count,
+	                     const SpriteBatch &batch);
+
 private:
 	SpritePrivate *p;
 
 	void draw();
 	void onGeometryChange(const Scene::Geometry &);
+	bool isCulled() const;
 
 	void releaseResources();
 	const char *klassName() const { return "sprite"; }
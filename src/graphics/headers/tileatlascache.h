@@ -0,0 +1,80 @@
+/*
+** tileatlascache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TILEATLASCACHE_H
+#define TILEATLASCACHE_H
+
+#include "gl-util.h"
+#include "intrulist.h"
+
+#include <vector>
+
+/* Tilemap atlases, shared between all Tilemaps built from the
+ * same tileset and autotiles. Bitmaps are identified by their
+ * version stamps, which are unique across all bitmaps and change
+ * with every modification, so an atlas whose bitmaps have since
+ * changed (or were freed) simply never matches again.
+ * A few unreferenced atlases are kept around, as scripts usually
+ * dispose the old Tilemap before creating the new one when
+ * transferring between maps or returning from menus */
+class TileAtlasCache
+{
+public:
+	typedef std::vector<unsigned int> Key;
+
+	struct Atlas
+	{
+		TEXFBO gl;
+		Key key;
+
+		/* Set once the contents have been assembled */
+		bool built;
+
+		int refCount;
+		IntruListLink<Atlas> idleLink;
+
+		Atlas()
+		    : built(false), refCount(0), idleLink(this)
+		{}
+	};
+
+	TileAtlasCache();
+	~TileAtlasCache();
+
+	/* Returns a referenced, 'width' x 'height' sized atlas for
+	 * 'key'. If it isn't 'built' yet, the caller has to fill it */
+	Atlas *acquire(const Key &key, int width, int height);
+	void release(Atlas *atlas);
+
+private:
+	void destroy(Atlas *atlas);
+
+	std::vector<Atlas*> atlases;
+
+	/* Unreferenced atlases, most recently released first */
+	IntruList<Atlas> idle;
+
+	/* Kept from the last destroyed atlas for reuse */
+	TEXFBO spareTex;
+};
+
+#endif // TILEATLASCACHE_H
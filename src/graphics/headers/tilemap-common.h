@@ -143,7 +143,7 @@ struct FlashMap
 
 		data = value;
 		dataCon.disconnect();
-		dirty = true;
+		setDirty();
 
 		if (!data)
 			return;
@@ -183,7 +183,7 @@ struct FlashMap
 		shader.setAlpha(alpha);
 		shader.setTranslation(trans);
 
-		gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, 0);
+		gl.DrawElements(GL_TRIANGLES, count * 6, shState->globalIBO().type, 0);
 
 		glState.blendMode.pop();
 
@@ -194,6 +194,7 @@ private:
 	void setDirty()
 	{
 		dirty = true;
+		shState->bumpSceneGeneration();
 	}
 
 	size_t quadCount() const
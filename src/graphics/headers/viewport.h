@@ -61,6 +61,7 @@ private:
 	void composite();
 	void draw();
 	void onGeometryChange(const Geometry &);
+	bool isCulled() const;
 	bool isEffectiveViewport(Rect *&, Color *&, Tone *&) const;
 
 	void releaseResources();
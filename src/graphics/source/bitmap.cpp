@@ -44,6 +44,9 @@
 #include "font.h"
 #include "eventthread.h"
 
+#include <vector>
+#include <algorithm>
+
 #define GUARD_MEGA \
 	{ \
 		if (p->megaSurface) \
@@ -102,10 +105,14 @@ struct BitmapPrivate
 	 * ourselves the expensive blending calculation */
 	pixman_region16_t tainted;
 
+	/* See Bitmap::version() */
+	unsigned int version;
+
 	BitmapPrivate(Bitmap *self)
 	    : self(self),
 	      megaSurface(0),
-	      surface(0)
+	      surface(0),
+	      version(shState->genTimeStamp())
 	{
 		format = SDL_AllocFormat(SDL_PIXELFORMAT_ABGR8888);
 
@@ -229,6 +236,9 @@ struct BitmapPrivate
 			surface = 0;
 		}
 
+		version = shState->genTimeStamp();
+
+		shState->bumpSceneGeneration();
 		self->modified();
 	}
 };
@@ -1027,21 +1037,10 @@ static void applyShadow(SDL_Surface *&in, const SDL_PixelFormat &fm, const SDL_C
 	in = out;
 }
 
-void Bitmap::drawText(const IntRect &rect, const char *str, int align)
+/* Renders 'str' in the bitmap's current font, including shadow
+ * and outline. 'rawHeight' receives the height of the plain text */
+static SDL_Surface *renderText(BitmapPrivate *p, const char *str, int &rawHeight)
 {
-	guardDisposed();
-
-	GUARD_MEGA;
-
-	std::string fixed = fixupString(str);
-	str = fixed.c_str();
-
-	if (*str == '\0')
-		return;
-
-	if (str[0] == ' ' && str[1] == '\0')
-		return;
-
 	TTF_Font *font = p->font->getSdlFont();
 	const Color &fontColor = p->font->getColor();
 	const Color &outColor = p->font->getOutColor();
@@ -1049,8 +1048,6 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 	SDL_Color c = fontColor.toSDLColor();
 	c.a = 255;
 
-	float txtAlpha = fontColor.norm.w;
-
 	SDL_Surface *txtSurf;
 
 	if (shState->rtData().config.solidFonts)
@@ -1060,7 +1057,7 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 
 	p->ensureFormat(txtSurf, SDL_PIXELFORMAT_ABGR8888);
 
-	int rawTxtSurfH = txtSurf->h;
+	rawHeight = txtSurf->h;
 
 	if (p->font->getShadow())
 		applyShadow(txtSurf, *p->format, c);
@@ -1090,35 +1087,14 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 		TTF_SetFontOutline(font, 0);
 	}
 
-	int alignX = rect.x;
-
-	switch (align)
-	{
-	default:
-	case Left :
-		break;
-
-	case Center :
-		alignX += (rect.w - txtSurf->w) / 2;
-		break;
-
-	case Right :
-		alignX += rect.w - txtSurf->w;
-		break;
-	}
-
-	if (alignX < rect.x)
-		alignX = rect.x;
-
-	int alignY = rect.y + (rect.h - rawTxtSurfH) / 2;
-
-	float squeeze = (float) rect.w / txtSurf->w;
-
-	if (squeeze > 1)
-		squeeze = 1;
-
-	FloatRect posRect(alignX, alignY, txtSurf->w * squeeze, txtSurf->h);
+	return txtSurf;
+}
 
+/* Blends rendered text into the bitmap at 'posRect',
+ * which is clipped to the bitmap if uploaded directly */
+static void blitText(BitmapPrivate *p, SDL_Surface *txtSurf,
+                     FloatRect &posRect, float squeeze, float txtAlpha)
+{
 	Vec2i gpTexSize;
 	shState->ensureTexSize(txtSurf->w, txtSurf->h, gpTexSize);
 
@@ -1135,8 +1111,8 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 			 * the clipped visible part of it. */
 			SDL_Rect btmRect;
 			btmRect.x = btmRect.y = 0;
-			btmRect.w = width();
-			btmRect.h = height();
+			btmRect.w = p->self->width();
+			btmRect.h = p->self->height();
 
 			SDL_Rect txtRect;
 			txtRect.x = posRect.x;
@@ -1237,6 +1213,56 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 
 		p->popViewport();
 	}
+}
+
+void Bitmap::drawText(const IntRect &rect, const char *str, int align)
+{
+	guardDisposed();
+
+	GUARD_MEGA;
+
+	std::string fixed = fixupString(str);
+	str = fixed.c_str();
+
+	if (*str == '\0')
+		return;
+
+	if (str[0] == ' ' && str[1] == '\0')
+		return;
+
+	int rawTxtSurfH;
+	SDL_Surface *txtSurf = renderText(p, str, rawTxtSurfH);
+
+	int alignX = rect.x;
+
+	switch (align)
+	{
+	default:
+	case Left :
+		break;
+
+	case Center :
+		alignX += (rect.w - txtSurf->w) / 2;
+		break;
+
+	case Right :
+		alignX += rect.w - txtSurf->w;
+		break;
+	}
+
+	if (alignX < rect.x)
+		alignX = rect.x;
+
+	int alignY = rect.y + (rect.h - rawTxtSurfH) / 2;
+
+	float squeeze = (float) rect.w / txtSurf->w;
+
+	if (squeeze > 1)
+		squeeze = 1;
+
+	FloatRect posRect(alignX, alignY, txtSurf->w * squeeze, txtSurf->h);
+
+	blitText(p, txtSurf, posRect, squeeze, p->font->getColor().norm.w);
 
 	SDL_FreeSurface(txtSurf);
 	p->addTaintedArea(posRect);
@@ -1288,6 +1314,29 @@ static uint16_t utf8_to_ucs2(const char *_input,
 	return -1;
 }
 
+/* 'str' must already be fixed up */
+static void measureText(TTF_Font *font, bool italic,
+                        const std::string &str, int &w, int &h)
+{
+	SharedFontState &fontState = shState->fontState();
+
+	if (fontState.cachedTextSize(font, str, w, h))
+		return;
+
+	TTF_SizeUTF8(font, str.c_str(), &w, &h);
+
+	/* If str is one character long, *endPtr == 0 */
+	const char *endPtr;
+	uint16_t ucs2 = utf8_to_ucs2(str.c_str(), &endPtr);
+
+	/* For cursive characters, returning the advance
+	 * as width yields better results */
+	if (italic && *endPtr == '\0')
+		TTF_GlyphMetrics(font, ucs2, 0, 0, 0, 0, &w);
+
+	fontState.cacheTextSize(font, str, w, h);
+}
+
 IntRect Bitmap::textSize(const char *str)
 {
 	guardDisposed();
@@ -1296,22 +1345,222 @@ IntRect Bitmap::textSize(const char *str)
 
 	TTF_Font *font = p->font->getSdlFont();
 
+	int w, h;
+	measureText(font, p->font->getItalic(), fixupString(str), w, h);
+
+	return IntRect(0, 0, w, h);
+}
+
+/* Byte length of the UTF-8 sequence starting with 'lead' */
+static int utf8SeqLength(unsigned char lead)
+{
+	if ((lead & 0xE0) == 0xC0)
+		return 2;
+
+	if ((lead & 0xF0) == 0xE0)
+		return 3;
+
+	if ((lead & 0xF8) == 0xF0)
+		return 4;
+
+	return 1;
+}
+
+/* Puts 'word', which doesn't fit on a line of its own, on as many
+ * lines as needed, split at character boundaries. The last part is
+ * left in 'line' so following words can still go after it */
+static void splitWord(TTF_Font *font, bool italic, const std::string &word,
+                      int maxWidth, size_t maxLines,
+                      std::string &line, std::vector<std::string> &lines)
+{
+	int w, h;
+
+	for (size_t i = 0; i < word.size() && lines.size() < maxLines;)
+	{
+		size_t len = std::min<size_t>(utf8SeqLength(word[i]), word.size() - i);
+		std::string candidate = line + word.substr(i, len);
+		measureText(font, italic, candidate, w, h);
+
+		/* A single character wider than the line
+		 * still has to go somewhere */
+		if (w > maxWidth && !line.empty())
+		{
+			lines.push_back(line);
+			line.clear();
+
+			continue;
+		}
+
+		line.swap(candidate);
+		i += len;
+	}
+}
+
+/* Greedily breaks 'str' into lines no wider than 'maxWidth',
+ * at spaces and line feeds. Words (or text without spaces, like
+ * CJK) that don't fit on a line of their own are split between
+ * characters */
+static void wrapText(TTF_Font *font, bool italic, const char *str,
+                     int maxWidth, size_t maxLines,
+                     std::vector<std::string> &lines)
+{
+	std::string line, word;
+	int w, h;
+
+	for (const char *ch = str; lines.size() < maxLines; ++ch)
+	{
+		if (*ch != ' ' && *ch != '\n' && *ch != '\r' && *ch != '\0')
+		{
+			word += *ch;
+			continue;
+		}
+
+		if (!word.empty())
+		{
+			std::string candidate = line.empty() ? word : line + ' ' + word;
+			measureText(font, italic, candidate, w, h);
+
+			if (w <= maxWidth)
+			{
+				line.swap(candidate);
+			}
+			else
+			{
+				if (!line.empty())
+				{
+					lines.push_back(line);
+					line.clear();
+				}
+
+				measureText(font, italic, word, w, h);
+
+				if (w <= maxWidth)
+					line = word;
+				else
+					splitWord(font, italic, word, maxWidth, maxLines, line, lines);
+			}
+
+			word.clear();
+		}
+
+		if (*ch == '\n' || *ch == '\0')
+		{
+			if (lines.size() < maxLines)
+				lines.push_back(line);
+
+			line.clear();
+		}
+
+		if (*ch == '\0')
+			break;
+	}
+}
+
+int Bitmap::drawTextWrapped(const IntRect &rect, const char *str,
+                            int align, int lineHeight)
+{
+	guardDisposed();
+
+	GUARD_MEGA;
+
+	if (rect.w <= 0 || rect.h <= 0)
+		return 0;
+
 	std::string fixed = fixupString(str);
 	str = fixed.c_str();
 
-	int w, h;
-	TTF_SizeUTF8(font, str, &w, &h);
+	TTF_Font *font = p->font->getSdlFont();
 
-	/* If str is one character long, *endPtr == 0 */
-	const char *endPtr;
-	uint16_t ucs2 = utf8_to_ucs2(str, &endPtr);
+	if (lineHeight <= 0)
+		lineHeight = TTF_FontLineSkip(font);
 
-	/* For cursive characters, returning the advance
-	 * as width yields better results */
-	if (p->font->getItalic() && *endPtr == '\0')
-		TTF_GlyphMetrics(font, ucs2, 0, 0, 0, 0, &w);
+	size_t maxLines = std::max(rect.h / lineHeight, 1);
 
-	return IntRect(0, 0, w, h);
+	std::vector<std::string> lines;
+	wrapText(font, p->font->getItalic(), str, rect.w, maxLines, lines);
+
+	/* Render all lines first, then compose them into a
+	 * single surface, so the bitmap is only drawn to once */
+	std::vector<SDL_Surface*> surfs(lines.size(), (SDL_Surface*) 0);
+	std::vector<SDL_Rect> dstRects(lines.size());
+
+	int compW = 0, compH = 0;
+
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		if (lines[i].empty())
+			continue;
+
+		int rawHeight;
+		SDL_Surface *surf = surfs[i] = renderText(p, lines[i].c_str(), rawHeight);
+
+		int x = 0;
+
+		switch (align)
+		{
+		default:
+		case Left :
+			break;
+
+		case Center :
+			x = (rect.w - surf->w) / 2;
+			break;
+
+		case Right :
+			x = rect.w - surf->w;
+			break;
+		}
+
+		SDL_Rect &dst = dstRects[i];
+		dst.x = std::max(x, 0);
+		dst.y = i * lineHeight + std::max((lineHeight - rawHeight) / 2, 0);
+		dst.w = surf->w;
+		dst.h = surf->h;
+
+		compW = std::max(compW, dst.x + dst.w);
+		compH = std::max(compH, dst.y + dst.h);
+	}
+
+	if (compW == 0)
+		return lines.size();
+
+	/* Whatever reaches below the rect is cut off */
+	compH = std::min(compH, rect.h);
+
+	const SDL_PixelFormat &fm = *p->format;
+	SDL_Surface *comp = SDL_CreateRGBSurface
+		(0, compW, compH, fm.BitsPerPixel, fm.Rmask, fm.Gmask, fm.Bmask, fm.Amask);
+
+	/* Lines are blended so that one line's transparent top rows
+	 * don't wipe out the descenders and outline of the line above.
+	 * Blending into black would darken antialiased edges, so start
+	 * from the (fully transparent) text color instead */
+	SDL_Color c = p->font->getColor().toSDLColor();
+	SDL_FillRect(comp, 0, SDL_MapRGBA(comp->format, c.r, c.g, c.b, 0));
+
+	for (size_t i = 0; i < surfs.size(); ++i)
+	{
+		if (!surfs[i])
+			continue;
+
+		SDL_SetSurfaceBlendMode(surfs[i], SDL_BLENDMODE_BLEND);
+		SDL_BlitSurface(surfs[i], 0, comp, &dstRects[i]);
+		SDL_FreeSurface(surfs[i]);
+	}
+
+	/* Only a character wider than the rect itself can
+	 * overflow, squeeze it in like drawText does */
+	float squeeze = std::min((float) rect.w / compW, 1.0f);
+
+	FloatRect posRect(rect.x, rect.y, compW * squeeze, compH);
+	blitText(p, comp, posRect, squeeze, p->font->getColor().norm.w);
+
+	SDL_FreeSurface(comp);
+	p->addTaintedArea(posRect);
+
+	p->onModified();
+
+	return lines.size();
 }
 
 DEF_ATTR_RD_SIMPLE(Bitmap, Font, Font&, *p->font)
@@ -1354,6 +1603,11 @@ void Bitmap::taintArea(const IntRect &rect)
 	p->addTaintedArea(rect);
 }
 
+unsigned int Bitmap::version() const
+{
+	return p->version;
+}
+
 void Bitmap::releaseResources()
 {
 	if (p->megaSurface)
@@ -27,14 +27,31 @@
 #include "boost-hash.h"
 #include "util.h"
 #include "config.h"
+#include "debugwriter.h"
 
 #include <string>
 #include <utility>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 #include <SDL2/SDL_ttf.h>
 
 typedef std::pair<std::string, int> FontKey;
 
+/* Font handle (face and size), style flags, string */
+typedef std::pair<std::pair<TTF_Font*, int>, std::string> TextSizeKey;
+
+/* Maximum number of cached text measurements */
+#define TEXT_SIZE_CACHE_MAX 4096
+
+struct TextSizeEntry
+{
+	int w, h;
+	std::list<TextSizeKey>::iterator prioIter;
+};
+
 struct FontSet
 {
 	/* 'Regular' style */
@@ -44,6 +61,30 @@ struct FontSet
 	std::string other;
 };
 
+/* A font file read into memory once, and
+ * shared by all opened sizes of it */
+struct FontFile
+{
+	std::vector<uint8_t> data;
+
+	/* Number of pooled fonts reading from 'data' */
+	size_t refCount;
+
+	FontFile()
+	    : refCount(0)
+	{}
+};
+
+struct PoolEntry
+{
+	TTF_Font *font;
+	std::string path;
+
+	/* Pinned fonts are never closed, and not in 'poolPrio' */
+	bool pinned;
+	std::list<FontKey>::iterator prioIter;
+};
+
 struct SharedFontStatePrivate
 {
 	/* Maps: font family name, To: substituted family name,
@@ -54,14 +95,124 @@ struct SharedFontStatePrivate
 	 * font filenames located in "Fonts/" */
 	BoostHash<std::string, FontSet> sets;
 
-	/* Pool of already opened fonts; once opened, they are reused
-	 * and never closed until the termination of the program */
-	BoostHash<FontKey, TTF_Font*> pool;
+	/* Pool of opened fonts, and the keys of unpinned ones
+	 * sorted by last request. Once more than 'poolSize' (unless
+	 * 0) are open, the least recently requested one is closed */
+	BoostHash<FontKey, PoolEntry> pool;
+	std::list<FontKey> poolPrio;
+	size_t poolCount;
+	size_t poolSize;
+
+	/* Changes whenever a pooled font is closed */
+	unsigned int poolGeneration;
+
+	/* Maps: font file path, To: its contents */
+	BoostHash<std::string, FontFile> files;
+	size_t filesBytes;
+
+	/* Measured text sizes, and their keys sorted by last use */
+	BoostHash<TextSizeKey, TextSizeEntry> textSizes;
+	std::list<TextSizeKey> textSizePrio;
+	size_t textSizeCount;
+
+	struct
+	{
+		unsigned int hits;
+		unsigned int opened;
+		unsigned int closed;
+		size_t peakBytes;
+	} stats;
+
+	SharedFontStatePrivate(size_t poolSize)
+	    : poolCount(0),
+	      poolSize(poolSize),
+	      poolGeneration(0),
+	      filesBytes(0),
+	      textSizeCount(0)
+	{
+		stats.hits = stats.opened = stats.closed = 0;
+		stats.peakBytes = 0;
+	}
+
+	FontFile &loadFile(const std::string &path)
+	{
+		FontFile &file = files[path];
+
+		if (!file.data.empty())
+			return file;
+
+		SDL_RWops ops;
+		shState->fileSystem().openReadRaw(ops, path.c_str());
+
+		Sint64 size = SDL_RWsize(&ops);
+
+		if (size > 0)
+		{
+			file.data.resize(size);
+
+			size_t read = SDL_RWread(&ops, &file.data[0], 1, size);
+			file.data.resize(read);
+		}
+
+		SDL_RWclose(&ops);
+
+		filesBytes += file.data.size();
+		stats.peakBytes = std::max(stats.peakBytes, filesBytes);
+
+		return file;
+	}
+
+	void releaseFile(const std::string &path)
+	{
+		FontFile &file = files[path];
+
+		if (--file.refCount > 0)
+			return;
+
+		filesBytes -= file.data.size();
+		files.remove(path);
+	}
+
+	/* Handles of closed fonts might be reused */
+	void purgeTextSizes(TTF_Font *font)
+	{
+		std::list<TextSizeKey>::iterator iter = textSizePrio.begin();
+
+		while (iter != textSizePrio.end())
+		{
+			if (iter->first.first != font)
+			{
+				++iter;
+				continue;
+			}
+
+			textSizes.remove(*iter);
+			iter = textSizePrio.erase(iter);
+			--textSizeCount;
+		}
+	}
+
+	void closeLeastRecent()
+	{
+		FontKey key = poolPrio.back();
+		poolPrio.pop_back();
+
+		PoolEntry entry = pool[key];
+		pool.remove(key);
+		--poolCount;
+
+		purgeTextSizes(entry.font);
+		TTF_CloseFont(entry.font);
+		releaseFile(entry.path);
+
+		++poolGeneration;
+		++stats.closed;
+	}
 };
 
 SharedFontState::SharedFontState(const Config &conf)
 {
-	p = new SharedFontStatePrivate;
+	p = new SharedFontStatePrivate(std::max(conf.fontPoolSize, 0));
 
 	/* Parse font substitutions */
 	for (size_t i = 0; i < conf.fontSubs.size(); ++i)
@@ -81,9 +232,14 @@ SharedFontState::SharedFontState(const Config &conf)
 
 SharedFontState::~SharedFontState()
 {
-	BoostHash<FontKey, TTF_Font*>::const_iterator iter;
+	if (p->stats.opened > 0)
+		Debug() << "Fonts:" << p->stats.opened << "opened," << p->stats.hits << "reused,"
+		        << p->stats.closed << "closed early, peak file memory"
+		        << p->stats.peakBytes / 1024 << "KB";
+
+	BoostHash<FontKey, PoolEntry>::const_iterator iter;
 	for (iter = p->pool.cbegin(); iter != p->pool.cend(); ++iter)
-		TTF_CloseFont(iter->second);
+		TTF_CloseFont(iter->second.font);
 
 	delete p;
 }
@@ -110,7 +266,7 @@ void SharedFontState::initFontSetCB(SDL_RWops &ops,
 }
 
 _TTF_Font *SharedFontState::getFont(std::string family,
-                                    int size)
+                                    int size, bool pinned)
 {
 	/* Check for substitutions */
 	if (p->subs.contains(family))
@@ -127,39 +283,120 @@ _TTF_Font *SharedFontState::getFont(std::string family,
 
 	FontKey key(family, size);
 
-	TTF_Font *font = p->pool.value(key);
+	if (p->pool.contains(key))
+	{
+		PoolEntry &entry = p->pool[key];
+		++p->stats.hits;
 
-	if (font)
-		return font;
+		if (entry.pinned)
+			return entry.font;
 
-	/* Not in pool; open new handle */
-	SDL_RWops *ops;
+		if (pinned)
+		{
+			p->poolPrio.erase(entry.prioIter);
+			--p->poolCount;
+			entry.pinned = true;
+		}
+		else
+		{
+			/* Move to the front */
+			p->poolPrio.splice(p->poolPrio.begin(), p->poolPrio, entry.prioIter);
+		}
+
+		return entry.font;
+	}
 
+	/* Not in pool; open new handle */
 	if (family.empty())
-	{
 		throw Exception(Exception::RGSSError, "font does not exist");
-	}
-	else
-	{
-		/* Use 'other' path as alternative in case
-		 * we have no 'regular' styled font asset */
-		const char *path = !req.regular.empty()
-		                 ? req.regular.c_str() : req.other.c_str();
 
-		ops = SDL_AllocRW();
-		shState->fileSystem().openReadRaw(*ops, path, true);
-	}
+	if (!pinned && p->poolSize > 0 && p->poolCount >= p->poolSize)
+		p->closeLeastRecent();
+
+	/* Use 'other' path as alternative in case
+	 * we have no 'regular' styled font asset */
+	const std::string path = !req.regular.empty() ? req.regular : req.other;
 
-	font = TTF_OpenFontRW(ops, 1, size);
+	/* All sizes of a font read from the same memory */
+	FontFile &file = p->loadFile(path);
+	++file.refCount;
+
+	SDL_RWops *ops = SDL_RWFromConstMem(dataPtr(file.data), file.data.size());
+	TTF_Font *font = TTF_OpenFontRW(ops, 1, size);
 
 	if (!font)
+	{
+		p->releaseFile(path);
 		throw Exception(Exception::SDLError, "%s", SDL_GetError());
+	}
 
-	p->pool.insert(key, font);
+	PoolEntry entry = { font, path, pinned, p->poolPrio.end() };
+
+	if (!pinned)
+	{
+		p->poolPrio.push_front(key);
+		entry.prioIter = p->poolPrio.begin();
+		++p->poolCount;
+	}
+
+	p->pool.insert(key, entry);
+	++p->stats.opened;
 
 	return font;
 }
 
+unsigned int SharedFontState::poolGeneration() const
+{
+	return p->poolGeneration;
+}
+
+static TextSizeKey textSizeKey(TTF_Font *font, const std::string &str)
+{
+	return TextSizeKey(std::make_pair(font, TTF_GetFontStyle(font)), str);
+}
+
+bool SharedFontState::cachedTextSize(_TTF_Font *font, const std::string &str,
+                                     int &w, int &h)
+{
+	TextSizeKey key = textSizeKey(font, str);
+
+	if (!p->textSizes.contains(key))
+		return false;
+
+	TextSizeEntry &entry = p->textSizes[key];
+
+	/* Move to the front */
+	p->textSizePrio.splice(p->textSizePrio.begin(), p->textSizePrio, entry.prioIter);
+
+	w = entry.w;
+	h = entry.h;
+
+	return true;
+}
+
+void SharedFontState::cacheTextSize(_TTF_Font *font, const std::string &str,
+                                    int w, int h)
+{
+	TextSizeKey key = textSizeKey(font, str);
+
+	if (p->textSizes.contains(key))
+		return;
+
+	if (p->textSizeCount == TEXT_SIZE_CACHE_MAX)
+	{
+		/* Evict least recently used measurement */
+		p->textSizes.remove(p->textSizePrio.back());
+		p->textSizePrio.pop_back();
+		--p->textSizeCount;
+	}
+
+	p->textSizePrio.push_front(key);
+
+	TextSizeEntry entry = { w, h, p->textSizePrio.begin() };
+	p->textSizes.insert(key, entry);
+	++p->textSizeCount;
+}
+
 bool SharedFontState::fontPresent(std::string family) const
 {
 	/* Check for substitutions */
@@ -222,8 +459,10 @@ struct FontPrivate
 
 	/* The actual font is opened as late as possible
 	 * (when it is queried by a Bitmap), prior it is
-	 * set to null */
+	 * set to null. It is only valid as long as the
+	 * font pool generation hasn't changed since */
 	TTF_Font *sdlFont;
+	unsigned int sdlFontGen;
 
 	FontPrivate(int size)
 	    : size(size),
@@ -235,7 +474,8 @@ struct FontPrivate
 	      outColor(&outColorTmp),
 	      colorTmp(*defaultColor),
 	      outColorTmp(*defaultOutColor),
-	      sdlFont(0)
+	      sdlFont(0),
+	      sdlFontGen(0)
 	{}
 
 	FontPrivate(const FontPrivate &other)
@@ -249,7 +489,8 @@ struct FontPrivate
 	      outColor(&outColorTmp),
 	      colorTmp(*other.color),
 	      outColorTmp(*other.outColor),
-	      sdlFont(other.sdlFont)
+	      sdlFont(other.sdlFont),
+	      sdlFontGen(other.sdlFontGen)
 	{}
 
 	void operator=(const FontPrivate &o)
@@ -412,9 +653,13 @@ void Font::initDefaults(const SharedFontState &sfs)
 
 _TTF_Font *Font::getSdlFont()
 {
-	if (!p->sdlFont)
-		p->sdlFont = shState->fontState().getFont(p->name.c_str(),
-		                                          p->size);
+	SharedFontState &fontState = shState->fontState();
+
+	if (!p->sdlFont || p->sdlFontGen != fontState.poolGeneration())
+	{
+		p->sdlFont = fontState.getFont(p->name.c_str(), p->size);
+		p->sdlFontGen = fontState.poolGeneration();
+	}
 
 	int style = TTF_STYLE_NORMAL;
 
@@ -29,6 +29,7 @@
 #include "shader.h"
 #include "scene.h"
 #include "quad.h"
+#include "streambuffer.h"
 #include "eventthread.h"
 #include "texpool.h"
 #include "bitmap.h"
@@ -38,6 +39,8 @@
 #include "binding.h"
 #include "debugwriter.h"
 #include "oneshot.h"
+#include "renderthread.h"
+#include "exception.h"
 
 #include <SDL2/SDL_video.h>
 #include <SDL2/SDL_timer.h>
@@ -49,6 +52,9 @@
 #endif
 #include <errno.h>
 #include <algorithm>
+#ifndef _WIN32
+#include <sched.h>
+#endif
 
 #define DEF_SCREEN_W  (rgssVer == 1 ? 640 : 544)
 #define DEF_SCREEN_H  (rgssVer == 1 ? 480 : 416)
@@ -150,6 +156,8 @@ public:
 
 		brightEffect = false;
 		brightnessQuad.setColor(Vec4());
+
+		drawnElements = culledElements = 0;
 	}
 
 	void composite()
@@ -157,6 +165,8 @@ public:
 		const int w = geometry.rect.w;
 		const int h = geometry.rect.h;
 
+		drawnElements = culledElements = 0;
+
 		shState->prepareDraw();
 
 		pp.startRender();
@@ -310,8 +320,13 @@ public:
 			WaterShader &shader = shState->shaders().water;
 			shader.bind();
 			shader.setiTime(water);
+			shader.setWrapEdges(false);
 			shader.applyViewportProj();
+			shader.setTranslation(Vec2i());
 			shader.setTexSize(screenRect.size());
+			shader.setSrcRect(FloatRect(0, 0, screenRect.w, screenRect.h));
+			shader.setTileSize(Vec2(screenRect.w, screenRect.h));
+			shader.setOffset(Vec2());
 
 			TEX::bind(pp.backBuffer().tex);
 
@@ -513,6 +528,11 @@ public:
 		return pp;
 	}
 
+	/* Scene elements drawn / culled during the
+	 * last composition */
+	int drawnElements;
+	int culledElements;
+
 private:
 	PingPong pp;
 	Quad screenQuad;
@@ -524,6 +544,34 @@ private:
 /* Nanoseconds per second */
 #define NS_PER_S 1000000000
 
+/* On Linux, frame pacing runs entirely on CLOCK_MONOTONIC (with
+ * nanosecond ticks), so sleep deadlines can be handed straight to
+ * clock_nanosleep without converting from another clock */
+#if defined(HAVE_NANOSLEEP) && defined(OS_LINUX)
+	#define FPS_MONOTONIC_CLOCK
+#endif
+
+static uint64_t limiterTicks()
+{
+#ifdef FPS_MONOTONIC_CLOCK
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * NS_PER_S + ts.tv_nsec;
+#else
+	return SDL_GetPerformanceCounter();
+#endif
+}
+
+static uint64_t limiterTickFreq()
+{
+#ifdef FPS_MONOTONIC_CLOCK
+	return NS_PER_S;
+#else
+	return SDL_GetPerformanceFrequency();
+#endif
+}
+
 struct FPSLimiter
 {
 	uint64_t lastTickCount;
@@ -540,8 +588,19 @@ struct FPSLimiter
 	/* Ticks per nanosecond */
 	const double tickFreqNS;
 
+	/* Ticks per microsecond */
+	const double tickFreqUS;
+
 	bool disabled;
 
+	/* Ticks before a deadline at which we stop
+	 * sleeping and start spinning */
+	int64_t spinTicks;
+
+	/* Display refresh rate to align the frame time to,
+	 * 0 if unknown / not desired */
+	int refreshRate;
+
 	/* Data for frame timing adjustment */
 	struct
 	{
@@ -554,16 +613,21 @@ struct FPSLimiter
 		bool resetFlag;
 	} adj;
 
+	FrameTimingStats stats;
+
 	FPSLimiter(uint16_t desiredFPS)
-	    : lastTickCount(SDL_GetPerformanceCounter()),
-	      tickFreq(SDL_GetPerformanceFrequency()),
+	    : lastTickCount(limiterTicks()),
+	      tickFreq(limiterTickFreq()),
 	      tickFreqMS(tickFreq / 1000),
 	      tickFreqNS((double) tickFreq / NS_PER_S),
-	      disabled(false)
+	      tickFreqUS((double) tickFreq / 1000000),
+	      disabled(false),
+	      spinTicks(tickFreqMS),
+	      refreshRate(0)
 	{
 		setDesiredFPS(desiredFPS);
 
-		adj.last = SDL_GetPerformanceCounter();
+		adj.last = limiterTicks();
 		adj.idealDiff = 0;
 		adj.resetFlag = false;
 	}
@@ -571,38 +635,62 @@ struct FPSLimiter
 	void setDesiredFPS(uint16_t value)
 	{
 		tpf = tickFreq / value;
-	}
 
-	void delay()
-	{
-		if (disabled)
+		if (refreshRate <= 0)
 			return;
 
-		int64_t tickDelta = SDL_GetPerformanceCounter() - lastTickCount;
-		int64_t toDelay = tpf - tickDelta;
+		/* If the desired frame time is within 2% of a whole
+		 * number of refresh periods, use that exactly instead,
+		 * so presented frames don't drift against vblank */
+		int periods = (refreshRate + value / 2) / value;
+
+		if (periods < 1)
+			return;
 
-		/* Compensate for the last delta
-		 * to the ideal timestep */
-		toDelay -= adj.idealDiff;
+		double ratio = ((double) periods / refreshRate) * value;
+
+		if (ratio > 0.98 && ratio < 1.02)
+			tpf = (tickFreq * periods) / refreshRate;
+	}
+
+	void setSpinTime(int usec)
+	{
+		spinTicks = std::max(usec, 0) * tickFreqUS;
+	}
 
-		if (toDelay < 0)
-			toDelay = 0;
+	void delay()
+	{
+		if (!disabled)
+		{
+			/* Compensate for the last delta
+			 * to the ideal timestep */
+			int64_t deadline = lastTickCount + tpf - adj.idealDiff;
 
-		delayTicks(toDelay);
+			waitUntil(deadline);
+		}
 
-		uint64_t now = lastTickCount = SDL_GetPerformanceCounter();
+		uint64_t now = lastTickCount = limiterTicks();
 		int64_t diff = now - adj.last;
 		adj.last = now;
 
-		/* Recalculate our temporal position
-		 * relative to the ideal timestep */
-		adj.idealDiff = diff - tpf + adj.idealDiff;
-
 		if (adj.resetFlag)
 		{
 			adj.idealDiff = 0;
 			adj.resetFlag = false;
+
+			/* Intervals spanning a reset (loading, window
+			 * dragging...) say nothing about pacing */
+			return;
 		}
+
+		/* Recalculate our temporal position
+		 * relative to the ideal timestep */
+		adj.idealDiff = diff - tpf + adj.idealDiff;
+
+		/* Without a target frame time,
+		 * there's nothing to measure against */
+		if (!disabled)
+			stats.addSample((diff - tpf) / tickFreqUS);
 	}
 
 	void resetFrameAdjust()
@@ -623,9 +711,44 @@ struct FPSLimiter
 	}
 
 private:
-	void delayTicks(uint64_t ticks)
+	/* Sleeps until shortly before 'deadline' (in limiter
+	 * ticks), then spins for the rest, as scheduler
+	 * wakeup latency easily exceeds a millisecond */
+	void waitUntil(int64_t deadline)
 	{
-#if defined(HAVE_NANOSLEEP)
+		int64_t wakeup = deadline - spinTicks;
+
+		if (wakeup > (int64_t) limiterTicks())
+			sleepUntil(wakeup);
+
+		while ((int64_t) limiterTicks() < deadline)
+			yieldCPU();
+	}
+
+	void sleepUntil(int64_t wakeup)
+	{
+#ifdef FPS_MONOTONIC_CLOCK
+		/* Ticks are CLOCK_MONOTONIC nanoseconds, so this is the
+		 * frame's one absolute deadline; retrying after a signal
+		 * interruption sleeps until the very same point */
+		struct timespec req;
+		req.tv_sec = wakeup / NS_PER_S;
+		req.tv_nsec = wakeup % NS_PER_S;
+
+		int err;
+
+		while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, 0)) != 0)
+		{
+			if (err == EINTR)
+				continue;
+
+			Debug() << "clock_nanosleep failed. errno:" << err;
+			SDL_Delay(std::max<int64_t>(wakeup - (int64_t) limiterTicks(), 0) / tickFreqMS);
+			break;
+		}
+#elif defined(HAVE_NANOSLEEP)
+		int64_t ticks = wakeup - (int64_t) limiterTicks();
+
 		struct timespec req;
 		uint64_t nsec = ticks / tickFreqNS;
 		req.tv_sec = nsec / NS_PER_S;
@@ -645,7 +768,16 @@ private:
 			break;
 		}
 #else
-		SDL_Delay(ticks / tickFreqMS);
+		SDL_Delay(std::max<int64_t>(wakeup - (int64_t) limiterTicks(), 0) / tickFreqMS);
+#endif
+	}
+
+	static void yieldCPU()
+	{
+#ifdef OS_W32
+		SDL_Delay(0);
+#else
+		sched_yield();
 #endif
 	}
 };
@@ -675,11 +807,16 @@ struct GraphicsPrivate
 
 	int frameRate;
 	int frameCount;
+	/* Like frameCount, but scripts can't change it */
+	unsigned int frameSerial;
 	int brightness;
 	bool smooth;
 
 	FPSLimiter fpsLimiter;
 
+	/* Only set when pipelined rendering is enabled */
+	RenderThread *renderThread;
+
 	bool frozen;
 	TEXFBO frozenScene;
 	Quad screenQuad;
@@ -689,6 +826,12 @@ struct GraphicsPrivate
 	IntruList<Disposable> dispList;
 
 	TEX::ID obscuredTex;
+	Vec2i obscuredTexSize;
+
+	/* Scene generation at which the PingPong front
+	 * buffer was last composited */
+	unsigned int frontGeneration;
+	bool frontValid;
 
 	GraphicsPrivate(RGSSThreadData *rtData)
 	    : scRes(DEF_SCREEN_W, DEF_SCREEN_H),
@@ -699,9 +842,13 @@ struct GraphicsPrivate
 	      glCtx(SDL_GL_GetCurrentContext()),
 	      frameRate(DEF_FRAMERATE),
 	      frameCount(0),
+	      frameSerial(0),
 	      brightness(255),
 	      fpsLimiter(frameRate),
-	      frozen(false)
+	      renderThread(0),
+	      frozen(false),
+	      frontGeneration(0),
+	      frontValid(false)
 	{
 		recalculateScreenSize(rtData);
 		updateScreenResoRatio(rtData);
@@ -719,14 +866,62 @@ struct GraphicsPrivate
 		TEX::bind(obscuredTex);
 		TEX::setRepeat(false);
 		TEX::setSmooth(false);
-		gl.TexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, 640, 480, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, 0);
+		allocObscuredTex(scRes);
+
+		if (rtData->config.pipelinedRendering)
+		{
+			try
+			{
+				renderThread = new RenderThread(rtData->window, glCtx,
+				                                rtData->config.vsync || rtData->config.syncToRefreshrate);
+			}
+			catch (const Exception &e)
+			{
+				Debug() << "Pipelined rendering unavailable:" << e.msg;
+			}
+		}
 	}
 
 	~GraphicsPrivate()
 	{
+		if (threadData->config.dumpFrameTiming)
+			dumpFrameTiming();
+
+		delete renderThread;
+
 		TEXFBO::fini(frozenScene);
 	}
 
+	void dumpFrameTiming() const
+	{
+		const FrameTimingStats &st = fpsLimiter.stats;
+
+		if (st.samples == 0)
+			return;
+
+		Debug() << "Frame timing over" << st.samples << "frames, error (us):"
+		        << "min" << st.minUs << "max" << st.maxUs
+		        << "mean" << st.sumUs / (int64_t) st.samples
+		        << "mean abs" << st.sumAbsUs / (int64_t) st.samples;
+
+		for (int i = 0; i < FrameTimingStats::BucketCount; ++i)
+		{
+			if (st.buckets[i] == 0)
+				continue;
+
+			int from = FrameTimingStats::BucketMinUs + i * FrameTimingStats::BucketUs;
+
+			Debug() << " " << from << ".." << from + FrameTimingStats::BucketUs << "us:"
+			        << st.buckets[i];
+		}
+
+		const GLCallStats &gs = glCallStats;
+
+		if (gs.frames > 0)
+			Debug() << "GL state calls per frame: issued" << gs.totalIssued / gs.frames
+			        << "skipped" << gs.totalSkipped / gs.frames;
+	}
+
 	void updateScreenResoRatio(RGSSThreadData *rtData)
 	{
 		Vec2 &ratio = rtData->sizeResoRatio;
@@ -787,21 +982,62 @@ struct GraphicsPrivate
 		scriptBinding->terminate();
 	}
 
-	void swapGLBuffer()
+	/* Where the game screen ends up in the window (flipped) */
+	IntRect screenDstRect() const
 	{
+		return IntRect(scOffset.x, scSize.y+scOffset.y, scSize.x, -scSize.y);
+	}
+
+	/* Scales 'frame' onto the window and swaps, either
+	 * directly or by handing it to the render thread */
+	void presentFrame(TEXFBO &frame)
+	{
+		if (renderThread)
+		{
+			fpsLimiter.delay();
+			renderThread->present(frame, screenDstRect(), threadData->config.smoothScaling);
+
+			return;
+		}
+
+		GLMeta::blitBeginScreen(winSize);
+		GLMeta::blitSource(frame);
+
+		FBO::clear();
+		metaBlitBufferFlippedScaled();
+
+		GLMeta::blitEnd();
+
 		fpsLimiter.delay();
 		FBO::unbind();
 		SDL_GL_SwapWindow(threadData->window);
+	}
+
+	void swapGLBuffer(TEXFBO &frame)
+	{
+		presentFrame(frame);
 
 		++frameCount;
+		glCallStats.endFrame();
+		shState->streamBuffer().endFrame();
 
 		threadData->ethread->notifyFrame();
 	}
 
-	void compositeToBuffer(TEXFBO &buffer)
+	void compositeScreen()
 	{
 		screen.composite();
 
+		/* Sampled afterwards, so that elements requeuing
+		 * themselves while preparing don't count as changes */
+		frontGeneration = shState->sceneGeneration();
+		frontValid = true;
+	}
+
+	void compositeToBuffer(TEXFBO &buffer)
+	{
+		compositeScreen();
+
 		GLMeta::blitBegin(buffer);
 		GLMeta::blitSource(screen.getPP().frontBuffer());
 		GLMeta::blitRectangle(IntRect(0, 0, scRes.x, scRes.y), Vec2i());
@@ -811,29 +1047,47 @@ struct GraphicsPrivate
 	void metaBlitBufferFlippedScaled()
 	{
 		GLMeta::blitRectangle(IntRect(0, 0, scRes.x, scRes.y),
-		                      IntRect(scOffset.x, scSize.y+scOffset.y, scSize.x, -scSize.y),
+		                      screenDstRect(),
 		                      threadData->config.smoothScaling);
 	}
 
+	void allocObscuredTex(const Vec2i &size)
+	{
+		TEX::bind(obscuredTex);
+		gl.TexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, size.x, size.y, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, 0);
+		obscuredTexSize = size;
+	}
+
 	void redrawScreen()
 	{
-		if (shState->oneshot().obscuredDirty)
+		Oneshot &oneshot = shState->oneshot();
+
+		if (oneshot.obscuredDirty)
 		{
-			TEX::bind(obscuredTex);
-			TEX::uploadSubImage(0, 0, 640, 480, shState->oneshot().obscuredMap().data(), GL_LUMINANCE);
-			shState->oneshot().obscuredDirty = false;
-		}
-		screen.composite();
+			Vec2i size(oneshot.obscuredWidth(), oneshot.obscuredHeight());
 
-		GLMeta::blitBeginScreen(winSize);
-		GLMeta::blitSource(screen.getPP().frontBuffer());
+			if (size != obscuredTexSize)
+				allocObscuredTex(size);
 
-		FBO::clear();
-		metaBlitBufferFlippedScaled();
+			/* Only upload the rows that changed */
+			int top = oneshot.obscuredDirtyTop;
+			int rows = oneshot.obscuredDirtyBottom - top;
 
-		GLMeta::blitEnd();
+			TEX::bind(obscuredTex);
+			gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			TEX::uploadSubImage(0, top, size.x, rows, &oneshot.obscuredMap()[top * size.x], GL_LUMINANCE);
+			gl.PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			oneshot.obscuredDirty = false;
+			shState->bumpSceneGeneration();
+		}
+
+		/* If nothing changed since the last composition, the
+		 * front buffer still holds the frame we'd produce */
+		if (!frontValid || frontGeneration != shState->sceneGeneration())
+			compositeScreen();
 
-		swapGLBuffer();
+		swapGLBuffer(screen.getPP().frontBuffer());
 	}
 
 	void checkSyncLock()
@@ -844,6 +1098,9 @@ struct GraphicsPrivate
 		/* Releasing the GL context before sleeping and making it
 		 * current again on wakeup seems to avoid the context loss
 		 * when the app moves into the background on Android */
+		if (renderThread)
+			renderThread->flush();
+
 		SDL_GL_MakeCurrent(threadData->window, 0);
 		threadData->syncPoint.waitMainSync();
 		SDL_GL_MakeCurrent(threadData->window, glCtx);
@@ -856,10 +1113,18 @@ Graphics::Graphics(RGSSThreadData *data)
 {
 	p = new GraphicsPrivate(data);
 
+	p->fpsLimiter.setSpinTime(data->config.framePacingSpin);
+
+	if (data->config.alignFramerate)
+		p->fpsLimiter.refreshRate = data->refreshRate;
+
 	if (data->config.syncToRefreshrate)
 	{
 		p->frameRate = data->refreshRate;
 		p->fpsLimiter.disabled = true;
+
+		/* Only used as the reference for timing stats */
+		p->fpsLimiter.setDesiredFPS(data->refreshRate);
 	}
 	else if (data->config.fixedFramerate > 0)
 	{
@@ -869,6 +1134,11 @@ Graphics::Graphics(RGSSThreadData *data)
 	{
 		p->fpsLimiter.disabled = true;
 	}
+	else if (p->fpsLimiter.refreshRate > 0)
+	{
+		/* Realign the default rate */
+		p->fpsLimiter.setDesiredFPS(p->frameRate);
+	}
 }
 
 Graphics::~Graphics()
@@ -881,6 +1151,8 @@ void Graphics::update(bool limitFps)
 	p->checkShutDownReset();
 	p->checkSyncLock();
 
+	++p->frameSerial;
+
 	if (p->frozen)
 		return;
 
@@ -910,7 +1182,7 @@ void Graphics::update(bool limitFps)
 			return;
 	}
 
-	shState->oneshot().update();
+	shState->oneshot().update(p->scRes.x, p->scRes.y);
 
 	p->checkResize();
 	p->redrawScreen();
@@ -942,7 +1214,7 @@ void Graphics::transition(int duration,
 	setBrightness(255);
 
 	/* Capture new scene */
-	p->screen.composite();
+	p->compositeScreen();
 
 	/* The PP frontbuffer will hold the current scene after the
 	 * composition step. Since the backbuffer is unused during
@@ -1030,15 +1302,7 @@ void Graphics::transition(int duration,
 		p->checkResize();
 
 		/* Then blit it flipped and scaled to the screen */
-		FBO::unbind();
-		FBO::clear();
-
-		GLMeta::blitBeginScreen(Vec2i(p->winSize));
-		GLMeta::blitSource(transBuffer);
-		p->metaBlitBufferFlippedScaled();
-		GLMeta::blitEnd();
-
-		p->swapGLBuffer();
+		p->swapGLBuffer(transBuffer);
 	}
 
 	glState.blend.pop();
@@ -1094,15 +1358,7 @@ void Graphics::fadeout(int duration)
 
 		if (p->frozen)
 		{
-			GLMeta::blitBeginScreen(p->scSize);
-			GLMeta::blitSource(p->frozenScene);
-
-			FBO::clear();
-			p->metaBlitBufferFlippedScaled();
-
-			GLMeta::blitEnd();
-
-			p->swapGLBuffer();
+			p->swapGLBuffer(p->frozenScene);
 		}
 		else
 		{
@@ -1124,15 +1380,7 @@ void Graphics::fadein(int duration)
 
 		if (p->frozen)
 		{
-			GLMeta::blitBeginScreen(p->scSize);
-			GLMeta::blitSource(p->frozenScene);
-
-			FBO::clear();
-			p->metaBlitBufferFlippedScaled();
-
-			GLMeta::blitEnd();
-
-			p->swapGLBuffer();
+			p->swapGLBuffer(p->frozenScene);
 		}
 		else
 		{
@@ -1153,6 +1401,11 @@ Bitmap *Graphics::snapToBitmap()
 	return bitmap;
 }
 
+unsigned int Graphics::frameSerial() const
+{
+	return p->frameSerial;
+}
+
 int Graphics::width() const
 {
 	return p->scRes.x;
@@ -1176,6 +1429,7 @@ void Graphics::resizeScreen(int width, int height)
 	p->scRes = size;
 
 	p->screen.setResolution(width, height);
+	p->frontValid = false;
 
 	TEXFBO::allocEmpty(p->frozenScene, width, height);
 
@@ -1201,6 +1455,8 @@ void Graphics::setBrightness(int value)
 
 	p->brightness = value;
 	p->screen.setBrightness(value / 255.0);
+
+	shState->bumpSceneGeneration();
 }
 
 void Graphics::reset()
@@ -1221,6 +1477,7 @@ void Graphics::reset()
 	p->fpsLimiter.resetFrameAdjust();
 	p->frozen = false;
 	p->screen.getPP().clearBuffers();
+	p->frontValid = false;
 
 	setFrameRate(DEF_FRAMERATE);
 	setBrightness(255);
@@ -1266,6 +1523,26 @@ void Graphics::setShowCursor(bool value)
 	p->threadData->ethread->requestShowCursor(value);
 }
 
+int Graphics::drawnElements() const
+{
+	return p->screen.drawnElements;
+}
+
+int Graphics::culledElements() const
+{
+	return p->screen.culledElements;
+}
+
+const FrameTimingStats &Graphics::frameTiming() const
+{
+	return p->fpsLimiter.stats;
+}
+
+void Graphics::resetFrameTiming()
+{
+	p->fpsLimiter.stats.reset();
+}
+
 Scene *Graphics::getScreen() const
 {
 	return &p->screen;
@@ -1278,8 +1555,6 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset)
 
 	/* Repaint the screen with the last good frame we drew */
 	TEXFBO &lastFrame = p->screen.getPP().frontBuffer();
-	GLMeta::blitBeginScreen(p->winSize);
-	GLMeta::blitSource(lastFrame);
 
 	while (!exitCond)
 	{
@@ -1288,15 +1563,10 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset)
 		if (checkReset)
 			shState->checkReset();
 
-		FBO::clear();
-		p->metaBlitBufferFlippedScaled();
-		SDL_GL_SwapWindow(p->threadData->window);
-		p->fpsLimiter.delay();
+		p->presentFrame(lastFrame);
 
 		p->threadData->ethread->notifyFrame();
 	}
-
-	GLMeta::blitEnd();
 }
 
 void Graphics::addDisposable(Disposable *d)
@@ -1313,3 +1583,11 @@ const TEX::ID &Graphics::obscuredTex() const
 {
 	return p->obscuredTex;
 }
+
+void Graphics::countElement(bool culled)
+{
+	if (culled)
+		++p->screen.culledElements;
+	else
+		++p->screen.drawnElements;
+}
@@ -0,0 +1,429 @@
+/*
+** particlesystem.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "particlesystem.h"
+
+#include "sharedstate.h"
+#include "preparable.h"
+#include "bitmap.h"
+#include "etc.h"
+#include "etc-internal.h"
+#include "util.h"
+
+#include "gl-util.h"
+#include "quad.h"
+#include "quadarray.h"
+#include "shader.h"
+#include "glstate.h"
+
+#include <SDL2/SDL_timer.h>
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+/* Upper bound for 'maxParticles' */
+#define PARTICLES_MAX 65536
+
+/* Particle state, one array per attribute so the
+ * simulation loops run over contiguous memory */
+struct ParticleArrays
+{
+	std::vector<float> x, y;
+	std::vector<float> velX, velY;
+	std::vector<int> age, life;
+
+	size_t count;
+
+	ParticleArrays()
+	    : count(0)
+	{}
+
+	void reserve(size_t size)
+	{
+		x.resize(size);
+		y.resize(size);
+		velX.resize(size);
+		velY.resize(size);
+		age.resize(size);
+		life.resize(size);
+	}
+
+	/* Moves the last particle into slot 'i' */
+	void remove(size_t i)
+	{
+		size_t last = --count;
+
+		x[i] = x[last];
+		y[i] = y[last];
+		velX[i] = velX[last];
+		velY[i] = velY[last];
+		age[i] = age[last];
+		life[i] = life[last];
+	}
+};
+
+struct ParticleSystemPrivate : public Preparable
+{
+	Bitmap *bitmap;
+
+	Rect *emitRect;
+
+	int ox, oy;
+	NormValue opacity;
+	BlendType blendType;
+
+	float spawnRate;
+	int maxParticles;
+
+	Vec2 velocity;
+	Vec2 velocitySpread;
+	Vec2 gravity;
+
+	int lifetime;
+	int lifetimeSpread;
+	NormValue opacityStart;
+	NormValue opacityEnd;
+
+	ParticleArrays parts;
+
+	/* Fractional particles left over from previous frames */
+	float spawnAccum;
+
+	uint32_t randState;
+
+	ColorQuadArray qArray;
+
+	/* Offset of the parent scene's contents */
+	Vec2i sceneOffset;
+
+	EtcTemps tmp;
+
+	ParticleSystemPrivate()
+	    : bitmap(0),
+	      emitRect(&tmp.rect),
+	      ox(0), oy(0),
+	      opacity(255),
+	      blendType(BlendNormal),
+	      spawnRate(0),
+	      maxParticles(100),
+	      lifetime(60),
+	      lifetimeSpread(0),
+	      opacityStart(255),
+	      opacityEnd(255),
+	      spawnAccum(0)
+	{
+		/* Must never be zero */
+		randState = (SDL_GetTicks() ^ (uint32_t) (uintptr_t) this) | 1;
+
+		parts.reserve(maxParticles);
+	}
+
+	/* xorshift32 */
+	uint32_t nextRand()
+	{
+		randState ^= randState << 13;
+		randState ^= randState >> 17;
+		randState ^= randState << 5;
+
+		return randState;
+	}
+
+	/* Uniform in [0, 1) */
+	float randUnit()
+	{
+		return (nextRand() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	/* Uniform in [-spread, spread] */
+	float randSpread(float spread)
+	{
+		return (randUnit() * 2 - 1) * spread;
+	}
+
+	void setMaxParticles(int value)
+	{
+		maxParticles = clamp(value, 0, PARTICLES_MAX);
+
+		if (parts.count > (size_t) maxParticles)
+			parts.count = maxParticles;
+
+		parts.reserve(maxParticles);
+	}
+
+	void spawn(int count)
+	{
+		count = std::min<int>(count, maxParticles - parts.count);
+
+		for (int n = 0; n < count; ++n)
+		{
+			size_t i = parts.count++;
+
+			parts.x[i] = ox + emitRect->x + randUnit() * emitRect->width;
+			parts.y[i] = oy + emitRect->y + randUnit() * emitRect->height;
+			parts.velX[i] = velocity.x + randSpread(velocitySpread.x);
+			parts.velY[i] = velocity.y + randSpread(velocitySpread.y);
+			parts.age[i] = 0;
+			parts.life[i] = std::max(1, lifetime + (int) roundf(randSpread(lifetimeSpread)));
+		}
+	}
+
+	void step()
+	{
+		const size_t count = parts.count;
+
+		float *x = dataPtr(parts.x), *y = dataPtr(parts.y);
+		float *velX = dataPtr(parts.velX), *velY = dataPtr(parts.velY);
+		int *age = dataPtr(parts.age);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			velX[i] += gravity.x;
+			velY[i] += gravity.y;
+			x[i] += velX[i];
+			y[i] += velY[i];
+			++age[i];
+		}
+
+		/* Backwards, so moved-in particles were already checked */
+		for (size_t i = count; i-- > 0;)
+			if (parts.age[i] >= parts.life[i])
+				parts.remove(i);
+
+		spawnAccum += spawnRate;
+		int spawnCount = spawnAccum;
+		spawnAccum -= spawnCount;
+
+		spawn(spawnCount);
+	}
+
+	void prepare()
+	{
+		if (parts.count == 0 || nullOrDisposed(bitmap))
+			return;
+
+		qArray.resize(parts.count);
+
+		FloatRect tex(0, 0, bitmap->width(), bitmap->height());
+		float opStart = opacityStart.norm * opacity.norm;
+		float opEnd = opacityEnd.norm * opacity.norm;
+
+		for (size_t i = 0; i < parts.count; ++i)
+		{
+			Vertex *vert = &qArray.vertices[i*4];
+			float t = (float) parts.age[i] / parts.life[i];
+
+			FloatRect pos(parts.x[i], parts.y[i], tex.w, tex.h);
+			Quad::setTexPosRect(vert, tex, pos);
+			Quad::setColor(vert, Vec4(1, 1, 1, opStart + (opEnd - opStart) * t));
+		}
+
+		qArray.commit();
+	}
+};
+
+ParticleSystem::ParticleSystem(Viewport *viewport)
+    : ViewportElement(viewport)
+{
+	p = new ParticleSystemPrivate();
+
+	onGeometryChange(scene->getGeometry());
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	dispose();
+}
+
+DEF_ATTR_RD_SIMPLE(ParticleSystem, Bitmap,       Bitmap*, p->bitmap)
+DEF_ATTR_RD_SIMPLE(ParticleSystem, OX,           int,     p->ox)
+DEF_ATTR_RD_SIMPLE(ParticleSystem, OY,           int,     p->oy)
+DEF_ATTR_RD_SIMPLE(ParticleSystem, Opacity,      int,     p->opacity)
+DEF_ATTR_RD_SIMPLE(ParticleSystem, BlendType,    int,     p->blendType)
+DEF_ATTR_RD_SIMPLE(ParticleSystem, MaxParticles, int,     p->maxParticles)
+
+DEF_ATTR_SIMPLE(ParticleSystem, EmitRect,        Rect&,   *p->emitRect)
+DEF_ATTR_SIMPLE(ParticleSystem, SpawnRate,       float,   p->spawnRate)
+DEF_ATTR_SIMPLE(ParticleSystem, VelocityX,       float,   p->velocity.x)
+DEF_ATTR_SIMPLE(ParticleSystem, VelocityY,       float,   p->velocity.y)
+DEF_ATTR_SIMPLE(ParticleSystem, VelocitySpreadX, float,   p->velocitySpread.x)
+DEF_ATTR_SIMPLE(ParticleSystem, VelocitySpreadY, float,   p->velocitySpread.y)
+DEF_ATTR_SIMPLE(ParticleSystem, GravityX,        float,   p->gravity.x)
+DEF_ATTR_SIMPLE(ParticleSystem, GravityY,        float,   p->gravity.y)
+DEF_ATTR_SIMPLE(ParticleSystem, Lifetime,        int,     p->lifetime)
+DEF_ATTR_SIMPLE(ParticleSystem, LifetimeSpread,  int,     p->lifetimeSpread)
+DEF_ATTR_SIMPLE(ParticleSystem, OpacityStart,    int,     p->opacityStart)
+DEF_ATTR_SIMPLE(ParticleSystem, OpacityEnd,      int,     p->opacityEnd)
+
+void ParticleSystem::update()
+{
+	guardDisposed();
+
+	/* Nothing to simulate, don't invalidate the frame */
+	if (p->parts.count == 0 && p->spawnRate <= 0)
+		return;
+
+	p->step();
+	p->requestPrepare();
+}
+
+void ParticleSystem::emit(int count)
+{
+	guardDisposed();
+
+	if (count <= 0)
+		return;
+
+	p->spawn(count);
+	p->requestPrepare();
+}
+
+void ParticleSystem::clear()
+{
+	guardDisposed();
+
+	p->parts.count = 0;
+	p->spawnAccum = 0;
+	shState->bumpSceneGeneration();
+}
+
+int ParticleSystem::getCount() const
+{
+	guardDisposed();
+
+	return p->parts.count;
+}
+
+void ParticleSystem::setBitmap(Bitmap *value)
+{
+	guardDisposed();
+
+	p->bitmap = value;
+
+	if (value)
+		value->ensureNonMega();
+
+	p->requestPrepare();
+}
+
+void ParticleSystem::setOX(int value)
+{
+	guardDisposed();
+
+	if (p->ox == value)
+		return;
+
+	p->ox = value;
+	shState->bumpSceneGeneration();
+}
+
+void ParticleSystem::setOY(int value)
+{
+	guardDisposed();
+
+	if (p->oy == value)
+		return;
+
+	p->oy = value;
+	shState->bumpSceneGeneration();
+}
+
+void ParticleSystem::setOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->opacity == value)
+		return;
+
+	/* Baked into the vertex colors */
+	p->opacity = value;
+	p->requestPrepare();
+}
+
+void ParticleSystem::setMaxParticles(int value)
+{
+	guardDisposed();
+
+	p->setMaxParticles(value);
+	p->requestPrepare();
+}
+
+void ParticleSystem::setBlendType(int value)
+{
+	guardDisposed();
+
+	shState->bumpSceneGeneration();
+
+	switch (value)
+	{
+	default :
+	case BlendNormal :
+		p->blendType = BlendNormal;
+		return;
+	case BlendAddition :
+		p->blendType = BlendAddition;
+		return;
+	case BlendSubstraction :
+		p->blendType = BlendSubstraction;
+		return;
+	}
+}
+
+void ParticleSystem::initDynAttribs()
+{
+	p->emitRect = new Rect;
+}
+
+void ParticleSystem::draw()
+{
+	if (nullOrDisposed(p->bitmap))
+		return;
+
+	SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(p->sceneOffset - Vec2i(p->ox, p->oy));
+
+	glState.blendMode.pushSet(p->blendType);
+
+	p->bitmap->bindTex(shader);
+	p->qArray.draw();
+
+	glState.blendMode.pop();
+}
+
+bool ParticleSystem::isCulled() const
+{
+	return nullOrDisposed(p->bitmap) || !p->opacity || p->parts.count == 0;
+}
+
+void ParticleSystem::onGeometryChange(const Scene::Geometry &geo)
+{
+	p->sceneOffset = geo.offset();
+}
+
+void ParticleSystem::releaseResources()
+{
+	unlink();
+
+	delete p;
+}
@@ -29,20 +29,19 @@
 
 #include "gl-util.h"
 #include "quad.h"
-#include "quadarray.h"
 #include "transform.h"
-#include "etc-internal.h"
 #include "shader.h"
 #include "glstate.h"
 
-#include <sigc++/connection.h>
-
 static float fwrap(float value, float range)
 {
 	float res = fmod(value, range);
 	return res < 0 ? res + range : res;
 }
 
+/* The plane is drawn as a single quad covering its scene, with
+ * the source rect repeated by the plane shaders. Scrolling and
+ * zooming only change shader uniforms */
 struct PlanePrivate
 {
 	Bitmap *bitmap;
@@ -61,15 +60,10 @@ struct PlanePrivate
 
 	Scene::Geometry sceneGeo;
 
-	bool quadSourceDirty;
-
-	SimpleQuadArray qArray;
+	Quad quad;
 
 	EtcTemps tmp;
 
-	sigc::connection prepareCon;
-	sigc::connection srcRectCon;
-
 	PlanePrivate()
 	    : bitmap(0),
 	      srcRect(&tmp.rect),
@@ -79,94 +73,23 @@ struct PlanePrivate
 	      tone(&tmp.tone),
 	      ox(0), oy(0),
 	      zoomX(1), zoomY(1),
-	      quadSourceDirty(false),
 		  waterTime(0.0)
-	{
-		updateSrcRectCon();
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &PlanePrivate::prepare));
-
-		qArray.resize(1);
-	}
-
-	~PlanePrivate()
-	{
-		srcRectCon.disconnect();
-		prepareCon.disconnect();
-	}
-
-	void onSrcRectChange()
-	{
-		quadSourceDirty = true;
-	}
-
-	void updateSrcRectCon()
-	{
-		/* Cut old connection */
-		srcRectCon.disconnect();
-		/* Create new one */
-		srcRectCon = srcRect->valueChanged.connect
-				(sigc::mem_fun(this, &PlanePrivate::onSrcRectChange));
-	}
+	{}
 
-	void updateQuadSource()
+	void setGeometryUniforms(PlaneShaderBase &shader)
 	{
-		if (nullOrDisposed(bitmap))
-			return;
-
-		if (gl.npot_repeat && srcRect->toIntRect() == bitmap->rect())
-		{
-			FloatRect srcRect;
-			srcRect.x = (sceneGeo.orig.x + ox) / zoomX;
-			srcRect.y = (sceneGeo.orig.y + oy) / zoomY;
-			srcRect.w = sceneGeo.rect.w / zoomX;
-			srcRect.h = sceneGeo.rect.h / zoomY;
-
-			Quad::setTexRect(&qArray.vertices[0], srcRect);
-			qArray.commit();
-
-			return;
-		}
-
-		/* Scaled (zoomed) bitmap dimensions */
-		float sw = srcRect->width  * zoomX;
-		float sh = srcRect->height * zoomY;
-
-		/* Plane offset wrapped by scaled bitmap dims */
-		float wox = fwrap(ox, sw);
-		float woy = fwrap(oy, sh);
-
-		/* Viewport dimensions */
-		int vpw = sceneGeo.rect.w;
-		int vph = sceneGeo.rect.h;
+		FloatRect src = srcRect->toFloatRect();
 
-		/* Amount the scaled bitmap is tiled (repeated) */
-		size_t tilesX = ceil((vpw - sw + wox) / sw) + 1;
-		size_t tilesY = ceil((vph - sh + woy) / sh) + 1;
+		/* Zoomed source rect dimensions */
+		Vec2 tileSize(src.w * zoomX, src.h * zoomY);
 
-		FloatRect tex = srcRect->toFloatRect();
+		/* Wrapped here so the shader never sees large offsets */
+		Vec2 offset(fwrap(sceneGeo.orig.x + ox, tileSize.x),
+		            fwrap(sceneGeo.orig.y + oy, tileSize.y));
 
-		qArray.resize(tilesX * tilesY);
-
-		for (size_t y = 0; y < tilesY; ++y)
-			for (size_t x = 0; x < tilesX; ++x)
-			{
-				SVertex *vert = &qArray.vertices[(y*tilesX + x) * 4];
-				FloatRect pos(x*sw - wox, y*sh - woy, sw, sh);
-
-				Quad::setTexPosRect(vert, tex, pos);
-			}
-
-		qArray.commit();
-	}
-
-	void prepare()
-	{
-		if (quadSourceDirty)
-		{
-			updateQuadSource();
-			quadSourceDirty = false;
-		}
+		shader.setSrcRect(src);
+		shader.setTileSize(tileSize);
+		shader.setOffset(offset);
 	}
 };
 
@@ -185,11 +108,11 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, SrcRect,   Rect&,  *p->srcRect)
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
-DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
-DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Plane, WaterTime, float, p->waterTime)
+DEF_ATTR_SCENE(Plane, SrcRect,   Rect&,  *p->srcRect)
+DEF_ATTR_SCENE(Plane, Opacity,   int,     p->opacity)
+DEF_ATTR_SCENE(Plane, Color,     Color&, *p->color)
+DEF_ATTR_SCENE(Plane, Tone,      Tone&,  *p->tone)
+DEF_ATTR_SCENE(Plane, WaterTime, float, p->waterTime)
 
 Plane::~Plane()
 {
@@ -201,6 +124,7 @@ void Plane::setBitmap(Bitmap *value)
 	guardDisposed();
 
 	p->bitmap = value;
+	shState->bumpSceneGeneration();
 
 	if (!value)
 		return;
@@ -208,7 +132,6 @@ void Plane::setBitmap(Bitmap *value)
 	value->ensureNonMega();
 
 	*p->srcRect = value->rect();
-	p->onSrcRectChange();
 }
 
 void Plane::setOX(int value)
@@ -219,7 +142,7 @@ void Plane::setOX(int value)
 	        return;
 
 	p->ox = value;
-	p->quadSourceDirty = true;
+	shState->bumpSceneGeneration();
 }
 
 void Plane::setOY(int value)
@@ -230,7 +153,7 @@ void Plane::setOY(int value)
 	        return;
 
 	p->oy = value;
-	p->quadSourceDirty = true;
+	shState->bumpSceneGeneration();
 }
 
 void Plane::setZoomX(float value)
@@ -241,7 +164,7 @@ void Plane::setZoomX(float value)
 	        return;
 
 	p->zoomX = value;
-	p->quadSourceDirty = true;
+	shState->bumpSceneGeneration();
 }
 
 void Plane::setZoomY(float value)
@@ -252,13 +175,15 @@ void Plane::setZoomY(float value)
 	        return;
 
 	p->zoomY = value;
-	p->quadSourceDirty = true;
+	shState->bumpSceneGeneration();
 }
 
 void Plane::setBlendType(int value)
 {
 	guardDisposed();
 
+	shState->bumpSceneGeneration();
+
 	switch (value)
 	{
 	default :
@@ -279,8 +204,6 @@ void Plane::initDynAttribs()
 	p->srcRect = new Rect;
 	p->color = new Color;
 	p->tone = new Tone;
-
-	p->updateSrcRectCon();
 }
 
 void Plane::draw()
@@ -291,24 +214,23 @@ void Plane::draw()
 	if (!p->opacity)
 		return;
 
-	ShaderBase *base;
+	PlaneShaderBase *base;
 
 	if (p->waterTime != 0)
 	{
 		WaterShader &shader = shState->shaders().water;
 		shader.bind();
-		shader.applyViewportProj();
 		shader.setiTime(p->waterTime);
 		shader.setOpacity(p->opacity.norm);
+		shader.setWrapEdges(true);
 
 		base = &shader;
 	}
-	else if (p->color->hasEffect() || p->tone->hasEffect() || p->opacity != 255)
+	else
 	{
 		PlaneShader &shader = shState->shaders().plane;
 
 		shader.bind();
-		shader.applyViewportProj();
 		shader.setTone(p->tone->norm);
 		shader.setColor(p->color->norm);
 		shader.setFlash(Vec4());
@@ -316,39 +238,35 @@ void Plane::draw()
 
 		base = &shader;
 	}
-	else
-	{
-		SimpleShader &shader = shState->shaders().simple;
 
-		shader.bind();
-		shader.applyViewportProj();
-		shader.setTranslation(Vec2i());
-
-		base = &shader;
-	}
+	base->applyViewportProj();
+	base->setTranslation(Vec2i());
+	p->setGeometryUniforms(*base);
 
 	glState.blendMode.pushSet(p->blendType);
 
 	p->bitmap->bindTex(*base);
-
-	if (gl.npot_repeat)
-		TEX::setRepeat(true);
-
-	p->qArray.draw();
-
-	if (gl.npot_repeat)
-		TEX::setRepeat(false);
+	p->quad.draw();
 
 	glState.blendMode.pop();
 }
 
+bool Plane::isCulled() const
+{
+	/* A plane always covers its entire scene */
+	return nullOrDisposed(p->bitmap) || !p->opacity ||
+	       p->sceneGeo.rect.w <= 0 || p->sceneGeo.rect.h <= 0 ||
+	       p->zoomX == 0 || p->zoomY == 0 ||
+	       p->srcRect->width <= 0 || p->srcRect->height <= 0;
+}
+
 void Plane::onGeometryChange(const Scene::Geometry &geo)
 {
-	if (gl.npot_repeat)
-		Quad::setPosRect(&p->qArray.vertices[0], FloatRect(geo.rect));
+	/* Texture coordinates are plane pixel positions */
+	p->quad.setTexPosRect(FloatRect(0, 0, geo.rect.w, geo.rect.h),
+	                      FloatRect(geo.rect));
 
 	p->sceneGeo = geo;
-	p->quadSourceDirty = true;
 }
 
 void Plane::releaseResources()
@@ -21,6 +21,10 @@
 
 #include "scene.h"
 #include "sharedstate.h"
+#include "graphics.h"
+
+#include <vector>
+#include <algorithm>
 
 Scene::Scene()
 {}
@@ -34,12 +38,21 @@ Scene::~Scene()
 	{
 		iter->data->scene = 0;
 	}
+
+	IntruListLink<SceneLayerStrip> *stripIter;
+
+	for (stripIter = strips.begin(); stripIter != strips.end(); stripIter = stripIter->next)
+	{
+		stripIter->data->scene = 0;
+	}
 }
 
 void Scene::insert(SceneElement &element)
 {
 	IntruListLink<SceneElement> *iter;
 
+	shState->bumpSceneGeneration();
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
@@ -58,6 +71,8 @@ void Scene::insertAfter(SceneElement &element, SceneElement &after)
 {
 	IntruListLink<SceneElement> *iter;
 
+	shState->bumpSceneGeneration();
+
 	for (iter = &after.link; iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
@@ -82,22 +97,169 @@ void Scene::notifyGeometryChange()
 {
 	IntruListLink<SceneElement> *iter;
 
+	shState->bumpSceneGeneration();
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		iter->data->onGeometryChange(geometry);
 	}
 }
 
+bool Scene::elementLess(const SceneElement *a, const SceneElement *b)
+{
+	return *a < *b;
+}
+
+void Scene::sortElements()
+{
+	IntruListLink<SceneElement> *iter;
+	std::vector<SceneElement*> sorted;
+	sorted.reserve(elements.getSize());
+
+	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
+		sorted.push_back(iter->data);
+
+	std::stable_sort(sorted.begin(), sorted.end(), elementLess);
+
+	elements.clear();
+
+	for (size_t i = 0; i < sorted.size(); ++i)
+		elements.append(sorted[i]->link);
+
+	shState->bumpSceneGeneration();
+}
+
+bool Scene::isEmpty() const
+{
+	return elements.getSize() == 0 && strips.isEmpty();
+}
+
 void Scene::composite()
 {
 	IntruListLink<SceneElement> *iter;
+	Graphics &graphics = shState->graphics();
+
+	/* Set up merge cursors for all strips with something to draw */
+	stripCursors.clear();
+
+	for (IntruListLink<SceneLayerStrip> *stripIter = strips.begin();
+	     stripIter != strips.end(); stripIter = stripIter->next)
+	{
+		SceneLayerStrip *strip = stripIter->data;
+
+		if (!strip->visible)
+			continue;
+
+		StripCursor cursor = { strip, 0, strip->layerCount() };
+
+		if (cursor.count > 0)
+			stripCursors.push_back(cursor);
+	}
 
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		if (e->isCulled())
+		{
+			graphics.countElement(true);
+			continue;
+		}
+
+		if (!stripCursors.empty())
+			drawStripLayers(e);
+
+		e->draw();
+		graphics.countElement(false);
+	}
+
+	if (!stripCursors.empty())
+		drawStripLayers(0);
+}
+
+/* Strip layers among each other are ordered like elements
+ * with equal sprite Y: by Z, then by creation time */
+static bool stripLayerLess(int z, unsigned int stamp,
+                           int oz, unsigned int ostamp)
+{
+	if (z != oz)
+		return z < oz;
+
+	return stamp < ostamp;
+}
+
+void Scene::drawStripLayers(const SceneElement *next)
+{
+	Graphics &graphics = shState->graphics();
+
+	while (true)
+	{
+		/* Find the strip whose next pending layer comes first */
+		StripCursor *first = 0;
+		int firstZ = 0;
+
+		for (size_t i = 0; i < stripCursors.size(); ++i)
+		{
+			StripCursor &c = stripCursors[i];
+
+			if (c.next == c.count)
+				continue;
+
+			if (next && !c.strip->layerBefore(c.next, *next))
+				continue;
+
+			int z = c.strip->layerZ(c.next);
+
+			if (!first || stripLayerLess(z, c.strip->creationStamp,
+			                             firstZ, first->strip->creationStamp))
+			{
+				first = &c;
+				firstZ = z;
+			}
+		}
+
+		if (!first)
+			return;
+
+		/* Extend the run for as long as neither 'next' nor
+		 * a layer of another strip has to come in between */
+		SceneLayerStrip *strip = first->strip;
+		size_t end = first->next + 1;
+
+		for (; end < first->count; ++end)
+		{
+			if (next && !strip->layerBefore(end, *next))
+				break;
+
+			int z = strip->layerZ(end);
+			bool interrupted = false;
+
+			for (size_t i = 0; i < stripCursors.size(); ++i)
+			{
+				StripCursor &c = stripCursors[i];
+
+				if (&c == first || c.next == c.count)
+					continue;
+
+				if (stripLayerLess(c.strip->layerZ(c.next), c.strip->creationStamp,
+				                   z, strip->creationStamp))
+				{
+					interrupted = true;
+					break;
+				}
+			}
+
+			if (interrupted)
+				break;
+		}
+
+		strip->drawLayers(first->next, end);
+		graphics.countElement(false);
+
+		first->next = end;
 	}
 }
 
@@ -158,7 +320,11 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
+	if (visible == value)
+		return;
+
 	visible = value;
+	shState->bumpSceneGeneration();
 }
 
 bool SceneElement::operator<(const SceneElement &o) const
@@ -195,8 +361,79 @@ void SceneElement::setSpriteY(int value)
 	scene->reinsert(*this);
 }
 
+bool SceneElement::setZUnsorted(int value)
+{
+	if (z == value)
+		return false;
+
+	z = value;
+
+	return true;
+}
+
+bool SceneElement::setSpriteYUnsorted(int value)
+{
+	if (spriteY == value)
+		return false;
+
+	spriteY = value;
+
+	return true;
+}
+
+void SceneElement::sortScene(Scene &scene)
+{
+	scene.sortElements();
+}
+
 void SceneElement::unlink()
 {
-	if (scene)
-		scene->elements.remove(link);
+	if (!scene)
+		return;
+
+	scene->elements.remove(link);
+	shState->bumpSceneGeneration();
+}
+
+
+SceneLayerStrip::SceneLayerStrip(Scene &scene)
+    : link(this),
+      creationStamp(shState->genTimeStamp()),
+      visible(true),
+      scene(&scene)
+{
+	scene.strips.append(link);
+	shState->bumpSceneGeneration();
+}
+
+SceneLayerStrip::~SceneLayerStrip()
+{
+	if (!scene)
+		return;
+
+	scene->strips.remove(link);
+	shState->bumpSceneGeneration();
+}
+
+void SceneLayerStrip::setVisible(bool value)
+{
+	if (visible == value)
+		return;
+
+	visible = value;
+	shState->bumpSceneGeneration();
+}
+
+bool SceneLayerStrip::layerBefore(size_t index, const SceneElement &o) const
+{
+	/* Same rules as SceneElement::operator< */
+	int z = layerZ(index);
+
+	if (z != o.z)
+		return z < o.z;
+
+	if (rgssVer >= 2 && o.spriteY != 0)
+		return 0 < o.spriteY;
+
+	return creationStamp < o.creationStamp;
 }
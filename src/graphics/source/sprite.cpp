@@ -22,6 +22,7 @@
 #include "sprite.h"
 
 #include "sharedstate.h"
+#include "preparable.h"
 #include "bitmap.h"
 #include "etc.h"
 #include "etc-internal.h"
@@ -37,6 +38,8 @@
 #include "debugwriter.h"
 
 #include <math.h>
+#include <vector>
+#include <algorithm>
 
 #include <SDL2/SDL_rect.h>
 
@@ -46,7 +49,7 @@
 	#define M_PI 3.14159265358979323846
 #endif
 
-struct SpritePrivate
+struct SpritePrivate : public Preparable
 {
 	Bitmap *bitmap;
 
@@ -64,8 +67,11 @@ struct SpritePrivate
 	NormValue opacity;
 	BlendType blendType;
 
+	/* Clipping rectangle of the parent scene */
 	IntRect sceneRect;
-	Vec2i sceneOrig;
+
+	/* Size of the (clamped) source rect as drawn */
+	Vec2i quadSize;
 
 	/* Would this sprite be visible on
 	 * the screen if drawn? */
@@ -93,8 +99,6 @@ struct SpritePrivate
 
 	EtcTemps tmp;
 
-	sigc::connection prepareCon;
-
 	SpritePrivate()
 	    : bitmap(0),
 	      srcRect(&tmp.rect),
@@ -112,24 +116,26 @@ struct SpritePrivate
 	      tone(&tmp.tone)
 
 	{
-		sceneRect.x = sceneRect.y = 0;
-
 		updateSrcRectCon();
 
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &SpritePrivate::prepare));
-
 		wave.amp = 0;
 		wave.length = 180;
 		wave.speed = 360;
 		wave.phase = 0.0f;
 		wave.dirty = false;
+
+		requestPrepare();
 	}
 
 	~SpritePrivate()
 	{
 		srcRectCon.disconnect();
-		prepareCon.disconnect();
+	}
+
+	void markWaveDirty()
+	{
+		wave.dirty = true;
+		requestPrepare();
 	}
 
 	void recomputeBushDepth()
@@ -172,9 +178,10 @@ struct SpritePrivate
 		quad.setTexRect(getMirroredTexRect(rect));
 
 		quad.setPosRect(FloatRect(0, 0, rect.w, rect.h));
+		quadSize = Vec2i(rect.w, rect.h);
 		recomputeBushDepth();
 
-		wave.dirty = true;
+		markWaveDirty();
 	}
 
 	void updateSrcRectCon()
@@ -196,29 +203,18 @@ struct SpritePrivate
 		if (!opacity)
 			return;
 
-		if (wave.active)
-		{
-			/* Don't do expensive wave bounding box
-			 * calculations */
-			isVisible = true;
-			return;
-		}
-
 		/* Compare sprite bounding box against the scene */
+		FloatRect local(0, 0, quadSize.x, quadSize.y);
 
-		/* If sprite is zoomed/rotated, just opt out for now
-		 * for simplicity's sake */
-		const Vec2 &scale = trans.getScale();
-		if (scale.x != 1 || scale.y != 1 || trans.getRotation() != 0)
+		/* Wave chunks get shifted sideways by
+		 * at most the (positive) amplitude */
+		if (wave.active && wave.amp > 0)
 		{
-			isVisible = true;
-			return;
+			local.x -= wave.amp;
+			local.w += wave.amp * 2;
 		}
 
-		IntRect self;
-		self.setPos(trans.getPositionI() - (trans.getOriginI() + sceneOrig));
-		self.w = bitmap->width();
-		self.h = bitmap->height();
+		IntRect self = trans.getBoundingRect(local);
 
 		isVisible = SDL_HasIntersection(&self, &sceneRect);
 	}
@@ -357,13 +353,13 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
-DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
-DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
-DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Sprite, Obscured,    bool,    p->obscured)
-DEF_ATTR_SIMPLE(Sprite, Scanned,    bool,    p->scanned)
+DEF_ATTR_SCENE(Sprite, BushOpacity, int,     p->bushOpacity)
+DEF_ATTR_RD_SIMPLE(Sprite, Opacity,  int,     p->opacity)
+DEF_ATTR_SCENE(Sprite, SrcRect,     Rect&,  *p->srcRect)
+DEF_ATTR_SCENE(Sprite, Color,       Color&, *p->color)
+DEF_ATTR_SCENE(Sprite, Tone,        Tone&,  *p->tone)
+DEF_ATTR_SCENE(Sprite, Obscured,    bool,    p->obscured)
+DEF_ATTR_SCENE(Sprite, Scanned,    bool,    p->scanned)
 
 void Sprite::setBitmap(Bitmap *bitmap)
 {
@@ -373,6 +369,7 @@ void Sprite::setBitmap(Bitmap *bitmap)
 		return;
 
 	p->bitmap = bitmap;
+	p->requestPrepare();
 
 	if (nullOrDisposed(bitmap))
 		return;
@@ -383,7 +380,7 @@ void Sprite::setBitmap(Bitmap *bitmap)
 	p->onSrcRectChange();
 	p->quad.setPosRect(p->srcRect->toFloatRect());
 
-	p->wave.dirty = true;
+	p->markWaveDirty();
 }
 
 void Sprite::setX(int value)
@@ -394,6 +391,7 @@ void Sprite::setX(int value)
 		return;
 
 	p->trans.setPosition(Vec2(value, getY()));
+	p->requestPrepare();
 }
 
 void Sprite::setY(int value)
@@ -405,10 +403,72 @@ void Sprite::setY(int value)
 
 	p->trans.setPosition(Vec2(getX(), value));
 
-	p->wave.dirty = true;
+	p->markWaveDirty();
 	setSpriteY(value);
 }
 
+void Sprite::batchSet(Sprite *const *sprites, size_t count,
+                      const SpriteBatch &batch)
+{
+	/* Checked up front, so a disposed sprite can't leave
+	 * the batch half applied and its scenes unsorted */
+	for (size_t i = 0; i < count; ++i)
+		sprites[i]->guardDisposed();
+
+	/* Scenes whose elements changed their sort keys */
+	std::vector<Scene*> unsorted;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sprite *s = sprites[i];
+
+		bool resort = false;
+
+		if (batch.x)
+			s->setX(batch.x[i]);
+
+		if (batch.y && s->p->trans.getPosition().y != batch.y[i])
+		{
+			s->p->trans.setPosition(Vec2(s->getX(), batch.y[i]));
+			s->p->markWaveDirty();
+			resort |= s->setSpriteYUnsorted(batch.y[i]);
+		}
+
+		if (batch.z)
+			resort |= s->setZUnsorted(batch.z[i]);
+
+		if (batch.ox)
+			s->setOX(batch.ox[i]);
+
+		if (batch.oy)
+			s->setOY(batch.oy[i]);
+
+		if (batch.zoomX)
+			s->setZoomX(batch.zoomX[i]);
+
+		if (batch.zoomY)
+			s->setZoomY(batch.zoomY[i]);
+
+		if (batch.angle)
+			s->setAngle(batch.angle[i]);
+
+		if (batch.opacity)
+			s->setOpacity(batch.opacity[i]);
+
+		if (batch.srcRect)
+		{
+			const int *r = &batch.srcRect[i*4];
+			s->p->srcRect->set(r[0], r[1], r[2], r[3]);
+		}
+
+		if (resort && std::find(unsorted.begin(), unsorted.end(), s->scene) == unsorted.end())
+			unsorted.push_back(s->scene);
+	}
+
+	for (size_t i = 0; i < unsorted.size(); ++i)
+		sortScene(*unsorted[i]);
+}
+
 void Sprite::setOX(int value)
 {
 	guardDisposed();
@@ -417,6 +477,7 @@ void Sprite::setOX(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(value, getOY()));
+	p->requestPrepare();
 }
 
 void Sprite::setOY(int value)
@@ -427,6 +488,7 @@ void Sprite::setOY(int value)
 		return;
 
 	p->trans.setOrigin(Vec2(getOX(), value));
+	p->requestPrepare();
 }
 
 void Sprite::setZoomX(float value)
@@ -437,6 +499,7 @@ void Sprite::setZoomX(float value)
 		return;
 
 	p->trans.setScale(Vec2(value, getZoomY()));
+	p->requestPrepare();
 }
 
 void Sprite::setZoomY(float value)
@@ -449,7 +512,7 @@ void Sprite::setZoomY(float value)
 	p->trans.setScale(Vec2(getZoomX(), value));
 	p->recomputeBushDepth();
 
-	p->wave.dirty = true;
+	p->markWaveDirty();
 }
 
 void Sprite::setAngle(float value)
@@ -460,6 +523,7 @@ void Sprite::setAngle(float value)
 		return;
 
 	p->trans.setRotation(value);
+	p->requestPrepare();
 }
 void Sprite::setVMirror(bool vmirrored)
 {
@@ -482,6 +546,19 @@ void Sprite::setMirror(bool mirrored)
 	p->onSrcRectChange();
 }
 
+void Sprite::setOpacity(int value)
+{
+	guardDisposed();
+
+	if (p->opacity == value)
+		return;
+
+	p->opacity = value;
+
+	/* Zero opacity culls the sprite */
+	p->requestPrepare();
+}
+
 void Sprite::setBushDepth(int value)
 {
 	guardDisposed();
@@ -491,12 +568,16 @@ void Sprite::setBushDepth(int value)
 
 	p->bushDepth = value;
 	p->recomputeBushDepth();
+
+	shState->bumpSceneGeneration();
 }
 
 void Sprite::setBlendType(int type)
 {
 	guardDisposed();
 
+	shState->bumpSceneGeneration();
+
 	switch (type)
 	{
 	default :
@@ -519,7 +600,7 @@ void Sprite::setBlendType(int type)
 		if (p->wave.name == value) \
 			return; \
 		p->wave.name = value; \
-		p->wave.dirty = true; \
+		p->markWaveDirty(); \
 	}
 
 DEF_WAVE_SETTER(Amp,    amp,    int)
@@ -546,13 +627,18 @@ void Sprite::update()
 	Flashable::update();
 
 	p->wave.phase += p->wave.speed / 180;
-	p->wave.dirty = true;
+
+	/* Most sprites never wave; don't queue them every frame */
+	if (p->wave.amp != 0)
+		p->markWaveDirty();
 }
 
 /* SceneElement */
 void Sprite::draw()
 {
-	if (!p->isVisible)
+	/* Visibility is only recomputed on state changes,
+	 * so we might not have noticed the bitmap dying yet */
+	if (nullOrDisposed(p->bitmap))
 		return;
 
 	if (emptyFlashFlag)
@@ -636,14 +722,20 @@ void Sprite::draw()
 	glState.blendMode.pop();
 }
 
+bool Sprite::isCulled() const
+{
+	return !p->isVisible;
+}
+
 void Sprite::onGeometryChange(const Scene::Geometry &geo)
 {
 	/* Offset at which the sprite will be drawn
 	 * relative to screen origin */
 	p->trans.setGlobalOffset(geo.offset());
 
-	p->sceneRect.setSize(geo.rect.size());
-	p->sceneOrig = geo.orig;
+	p->sceneRect = geo.rect;
+
+	p->requestPrepare();
 }
 
 void Sprite::releaseResources()
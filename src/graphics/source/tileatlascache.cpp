@@ -0,0 +1,112 @@
+/*
+** tileatlascache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "tileatlascache.h"
+
+#include <algorithm>
+
+/* Unreferenced atlases kept around */
+#define MAX_IDLE_ATLASES 2
+
+TileAtlasCache::TileAtlasCache()
+{
+	TEXFBO::init(spareTex);
+}
+
+TileAtlasCache::~TileAtlasCache()
+{
+	for (size_t i = 0; i < atlases.size(); ++i)
+	{
+		TEXFBO::fini(atlases[i]->gl);
+		delete atlases[i];
+	}
+
+	TEXFBO::fini(spareTex);
+}
+
+TileAtlasCache::Atlas *TileAtlasCache::acquire(const Key &key, int width, int height)
+{
+	for (size_t i = 0; i < atlases.size(); ++i)
+	{
+		Atlas *atlas = atlases[i];
+
+		if (atlas->key != key || atlas->gl.width != width || atlas->gl.height != height)
+			continue;
+
+		if (atlas->refCount++ == 0)
+			idle.remove(atlas->idleLink);
+
+		return atlas;
+	}
+
+	Atlas *atlas = new Atlas;
+	atlas->key = key;
+	atlas->refCount = 1;
+
+	if (spareTex.width == width && spareTex.height == height)
+	{
+		atlas->gl = spareTex;
+		TEXFBO::init(spareTex);
+	}
+	else
+	{
+		TEXFBO::init(atlas->gl);
+		TEXFBO::allocEmpty(atlas->gl, width, height);
+		TEXFBO::linkFBO(atlas->gl);
+	}
+
+	atlases.push_back(atlas);
+
+	return atlas;
+}
+
+void TileAtlasCache::release(Atlas *atlas)
+{
+	if (--atlas->refCount > 0)
+		return;
+
+	/* Half assembled atlases are of no use to anyone */
+	if (!atlas->built)
+	{
+		destroy(atlas);
+		return;
+	}
+
+	idle.prepend(atlas->idleLink);
+
+	if (idle.getSize() > MAX_IDLE_ATLASES)
+	{
+		Atlas *oldest = idle.tail();
+		idle.remove(oldest->idleLink);
+		destroy(oldest);
+	}
+}
+
+void TileAtlasCache::destroy(Atlas *atlas)
+{
+	atlases.erase(std::find(atlases.begin(), atlases.end(), atlas));
+
+	TEXFBO::fini(spareTex);
+	spareTex = atlas->gl;
+
+	delete atlas;
+}
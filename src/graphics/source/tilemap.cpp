@@ -26,6 +26,7 @@
 #include "table.h"
 
 #include "sharedstate.h"
+#include "preparable.h"
 #include "config.h"
 #include "glstate.h"
 #include "gl-util.h"
@@ -37,6 +38,7 @@
 #include "quad.h"
 #include "vertex.h"
 #include "tileatlas.h"
+#include "tileatlascache.h"
 #include "tilemap-common.h"
 
 #include <sigc++/connection.h>
@@ -78,7 +80,9 @@ static const int tsLaneW = tilesetW / 2;
  *   be drawn from one texture (for performance reasons).
  *   This means that we have to watch the 'modified' signals
  *   of all Bitmaps that make up the atlas, and update it
- *   as required during runtime.
+ *   as required during runtime. Atlases are shared through
+ *   SharedState's TileAtlasCache by all tilemaps using the
+ *   same bitmaps, so recreating a tilemap doesn't rebuild it.
  *   The atlas is tightly packed, with the autotiles located
  *   in the top left corener and the tileset image filing the
  *   remaining open space (below the autotiles as well as
@@ -130,8 +134,8 @@ static const int tsLaneW = tilesetW / 2;
  *
  * Elements:
  *   Even though the Tilemap carries similarities with other
- *   SceneElements, it is not one itself but composed of multiple
- *   such elements (GroundLayer and ZLayers).
+ *   SceneElements, it is not one itself but composed of a
+ *   GroundLayer element and a ZLayerStrip.
  *
  * GroundLayer:
  *   Every tile with priority=0 is drawn at z=0, so we
@@ -146,6 +150,9 @@ static const int tsLaneW = tilesetW / 2;
  *   'zlayers'. They're drawn from the top part of the map
  *   (lowest z) to the bottom part (highest z).
  *   Objects that would end up on the same zlayer are eg. trees.
+ *   All zlayers together form one SceneLayerStrip, which the
+ *   scene merges with its other elements while compositing,
+ *   drawing adjacent zlayers with a single call.
  *
  * Map viewport:
  *   This rectangle describes the subregion of the map that is
@@ -197,38 +204,18 @@ struct GroundLayer : public ViewportElement
 	ABOUT_TO_ACCESS_NOOP
 };
 
-struct ZLayer : public ViewportElement
+struct ZLayerStrip : public SceneLayerStrip
 {
-	size_t index;
-	GLintptr vboOffset;
-	GLsizei vboCount;
 	TilemapPrivate *p;
 
-	/* If this layer is part of a batch and not
-	 * the head, it is 'muted' via this flag */
-	bool batchedFlag;
-
-	/* If this layer is a batch head, this variable
-	 * holds the element count of the entire batch */
-	GLsizei vboBatchCount;
-
-	ZLayer(TilemapPrivate *p, Viewport *viewport);
-	ZLayer();
-
-	void setIndex(int value);
-
-	void draw();
-	void drawInt();
+	ZLayerStrip(TilemapPrivate *p, Viewport *viewport);
 
-	static int calculateZ(TilemapPrivate *p, int index);
-
-	void initUpdateZ();
-	void finiUpdateZ(ZLayer *prev);
-
-	ABOUT_TO_ACCESS_NOOP
+	size_t layerCount() const;
+	int layerZ(size_t index) const;
+	void drawLayers(size_t first, size_t last);
 };
 
-struct TilemapPrivate
+struct TilemapPrivate : public Preparable
 {
 	Viewport *viewport;
 
@@ -246,7 +233,8 @@ struct TilemapPrivate
 
 	/* Tile atlas */
 	struct {
-		TEXFBO gl;
+		/* Shared with other tilemaps using the same bitmaps */
+		TileAtlasCache::Atlas *shared;
 
 		Vec2i size;
 
@@ -275,9 +263,9 @@ struct TilemapPrivate
 	FlashMap flashMap;
 	uint8_t flashAlphaIdx;
 
-	/* Affected by: autotiles, tileset */
+	/* Affected by: tileset(.changed) */
 	bool atlasSizeDirty;
-	/* Affected by: autotiles(.changed), tileset(.changed), allocateAtlas */
+	/* Affected by: autotiles(.changed, .disposed) */
 	bool atlasDirty;
 	/* Affected by: mapData(.changed), priorities(.changed) */
 	bool buffersDirty;
@@ -305,9 +293,10 @@ struct TilemapPrivate
 	struct
 	{
 		GroundLayer *ground;
-		std::vector<ZLayer*> zlayers;
-		/* Used layers out of 'zlayers' (rest is hidden) */
-		size_t activeLayers;
+		ZLayerStrip *zlayers;
+		/* Indices of non-empty zlayers, and their z values */
+		std::vector<size_t> activeLayers;
+		std::vector<int> layerZ;
 		Scene::Geometry sceneGeo;
 	} elem;
 	SVVector* zlayerVert;
@@ -322,9 +311,6 @@ struct TilemapPrivate
 	/* Dispose watches */
 	sigc::connection autotilesDispCon[autotileCount];
 
-	/* Draw prepare call */
-	sigc::connection prepareCon;
-
 	TilemapPrivate(Viewport *viewport, int argxSize, int argySize)
 	    : viewport(viewport),
 	      tileset(0),
@@ -352,12 +338,11 @@ struct TilemapPrivate
 		 * in the shared buffer */
 		zlayerBases = new size_t[zlayersMax+1];
 
-		elem.zlayers.resize(zlayersMax);
-
 		memset(autotiles, 0, sizeof(autotiles));
 
 		atlas.animatedATs.reserve(autotileCount);
 		atlas.efTilesetH = 0;
+		atlas.shared = 0;
 
 		tiles.animated = false;
 		tiles.frameIdx = 0;
@@ -374,23 +359,21 @@ struct TilemapPrivate
 
 		elem.ground = new GroundLayer(this, viewport);
 
-		for (size_t i = 0; i < zlayersMax; ++i)
-			elem.zlayers[i] = new ZLayer(this, viewport);
-
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &TilemapPrivate::prepare));
+		elem.zlayers = new ZLayerStrip(this, viewport);
 
 		updateFlashMapViewport();
+
+		requestPrepare();
 	}
 
 	~TilemapPrivate()
 	{
 		/* Destroy elements */
 		delete elem.ground;
-		for (size_t i = 0; i < zlayersMax; ++i)
-			delete elem.zlayers[i];
+		delete elem.zlayers;
 
-		shState->releaseAtlasTex(atlas.gl);
+		if (atlas.shared)
+			shState->atlasCache().release(atlas.shared);
 
 		/* Destroy tile buffers */
 		GLMeta::vaoFini(tiles.vao);
@@ -405,8 +388,6 @@ struct TilemapPrivate
 		}
 		mapDataCon.disconnect();
 		prioritiesCon.disconnect();
-
-		prepareCon.disconnect();
 	}
 
 	void updateFlashMapViewport()
@@ -439,6 +420,7 @@ struct TilemapPrivate
 		std::vector<uint8_t> &animatedATs = atlas.animatedATs;
 
 		usableATs.clear();
+		animatedATs.clear();
 
 		for (int i = 0; i < autotileCount; ++i)
 		{
@@ -460,22 +442,33 @@ struct TilemapPrivate
 	void updateSceneGeometry(const Scene::Geometry &geo)
 	{
 		elem.sceneGeo = geo;
+		invalidateMapViewport();
+	}
+
+	/* Tilemaps stay queued for preparation permanently,
+	 * so they have to invalidate the frame themselves */
+	void invalidateMapViewport()
+	{
 		mapViewportDirty = true;
+		shState->bumpSceneGeneration();
 	}
 
 	void invalidateAtlasSize()
 	{
 		atlasSizeDirty = true;
+		shState->bumpSceneGeneration();
 	}
 
 	void invalidateAtlasContents()
 	{
 		atlasDirty = true;
+		shState->bumpSceneGeneration();
 	}
 
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		shState->bumpSceneGeneration();
 	}
 
 	/* Checks for the minimum amount of data needed to display */
@@ -490,27 +483,62 @@ struct TilemapPrivate
 		return true;
 	}
 
-	/* Allocates correctly sized TexFBO for atlas */
-	void allocateAtlas()
+	/* Identifies the exact tileset / autotile contents
+	 * the atlas is built from */
+	TileAtlasCache::Key atlasKey()
+	{
+		TileAtlasCache::Key key;
+		key.reserve(2 + autotileCount);
+
+		/* Which autotiles are used at all */
+		unsigned int usedMask = 0;
+		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
+			usedMask |= 1 << atlas.usableATs[i];
+
+		key.push_back(usedMask);
+		key.push_back(tileset->version());
+
+		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
+			key.push_back(autotiles[atlas.usableATs[i]]->version());
+
+		return key;
+	}
+
+	/* Picks up the shared atlas matching the current
+	 * bitmaps, assembling it first if nobody else has */
+	void updateAtlas()
 	{
 		updateAtlasInfo();
+		updateAutotileInfo();
 
-		/* Aquire atlas tex */
-		shState->releaseAtlasTex(atlas.gl);
-		shState->requestAtlasTex(atlas.size.x, atlas.size.y, atlas.gl);
+		TileAtlasCache::Key key = atlasKey();
 
-		atlasDirty = true;
+		if (atlas.shared && atlas.shared->key == key)
+			return;
+
+		TileAtlasCache &cache = shState->atlasCache();
+
+		if (atlas.shared)
+			cache.release(atlas.shared);
+
+		atlas.shared = cache.acquire(key, atlas.size.x, atlas.size.y);
+
+		if (atlas.shared->built)
+			return;
+
+		buildAtlas();
+		atlas.shared->built = true;
 	}
 
 	/* Assembles atlas from tileset and autotile bitmaps */
 	void buildAtlas()
 	{
-		updateAutotileInfo();
+		TEXFBO &atlasGL = atlas.shared->gl;
 
 		TileAtlas::BlitVec blits = TileAtlas::calcBlits(atlas.efTilesetH, atlas.size);
 
 		/* Clear atlas */
-		FBO::bind(atlas.gl.fbo);
+		FBO::bind(atlasGL.fbo);
 		glState.clearColor.pushSet(Vec4());
 		glState.scissorTest.pushSet(false);
 
@@ -519,7 +547,7 @@ struct TilemapPrivate
 		glState.scissorTest.pop();
 		glState.clearColor.pop();
 
-		GLMeta::blitBegin(atlas.gl);
+		GLMeta::blitBegin(atlasGL);
 
 		/* Blit autotiles */
 		for (size_t i = 0; i < atlas.usableATs.size(); ++i)
@@ -558,7 +586,7 @@ struct TilemapPrivate
 			if (shState->config().subImageFix)
 			{
 				/* Implementation for broken GL drivers */
-				FBO::bind(atlas.gl.fbo);
+				FBO::bind(atlasGL.fbo);
 				glState.blend.pushSet(false);
 				glState.viewport.pushSet(IntRect(0, 0, atlas.size.x, atlas.size.y));
 
@@ -593,7 +621,7 @@ struct TilemapPrivate
 			else
 			{
 				/* Clean implementation */
-				TEX::bind(atlas.gl.tex);
+				TEX::bind(atlasGL.tex);
 
 				for (size_t i = 0; i < blits.size(); ++i)
 				{
@@ -610,7 +638,7 @@ struct TilemapPrivate
 		else
 		{
 			/* Regular tileset */
-			GLMeta::blitBegin(atlas.gl);
+			GLMeta::blitBegin(atlasGL);
 			GLMeta::blitSource(tileset->getGLTypes());
 
 			for (size_t i = 0; i < blits.size(); ++i)
@@ -807,110 +835,39 @@ struct TilemapPrivate
 
 	void bindAtlas(ShaderBase &shader)
 	{
-		TEX::bind(atlas.gl.tex);
+		TEX::bind(atlas.shared->gl.tex);
 		shader.setTexSize(atlas.size);
 	}
 
-	void updateActiveElements(std::vector<int> &zlayerInd)
+	void updateSceneElements()
 	{
 		elem.ground->updateVboCount();
 
-		for (size_t i = 0; i < zlayersMax; ++i)
-		{
-			if (i < zlayerInd.size())
-			{
-				int index = zlayerInd[i];
-				elem.zlayers[i]->setVisible(visible);
-				elem.zlayers[i]->setIndex(index);
-			}
-			else
-			{
-				/* Hide unused layers */
-				elem.zlayers[i]->setVisible(false);
-			}
-		}
-	}
-
-	void updateSceneElements()
-	{
-		/* Only allocate elements for non-emtpy zlayers */
-		std::vector<int> zlayerInd;
+		/* Only non-empty zlayers become strip layers */
+		elem.activeLayers.clear();
 
 		for (size_t i = 0; i < zlayersMax; ++i)
 			if (zlayerVert[i].size() > 0)
-				zlayerInd.push_back(i);
+				elem.activeLayers.push_back(i);
 
-		updateActiveElements(zlayerInd);
-		elem.activeLayers = zlayerInd.size();
-		zOrderDirty = false;
+		updateZOrder();
+		elem.zlayers->setVisible(visible);
 	}
 
 	void hideElements()
 	{
 		elem.ground->setVisible(false);
-
-		for (size_t i = 0; i < zlayersMax; ++i)
-			elem.zlayers[i]->setVisible(false);
+		elem.zlayers->setVisible(false);
 	}
 
 	void updateZOrder()
 	{
-		if (elem.activeLayers == 0)
-			return;
-
-		for (size_t i = 0; i < elem.activeLayers; ++i)
-			elem.zlayers[i]->initUpdateZ();
-
-		ZLayer *prev = elem.zlayers[0];
-		prev->finiUpdateZ(0);
-
-		for (size_t i = 1; i < elem.activeLayers; ++i)
-		{
-			ZLayer *layer = elem.zlayers[i];
-			layer->finiUpdateZ(prev);
-			prev = layer;
-		}
-	}
-
-	/* When there are two or more zlayers with no other
-	 * elements between them in the scene list, we can
-	 * render them in a batch (as the zlayer data itself
-	 * is ordered sequentially in VRAM). Every frame, we
-	 * scan the scene list for such sequential layers and
-	 * batch them up for drawing. The first layer of the batch
-	 * (the "batch head") executes the draw call, all others
-	 * are muted via the 'batchedFlag'. For simplicity,
-	 * single sized batches are possible. */
-	void prepareZLayerBatches()
-	{
-		std::vector<ZLayer*> const zlayers = elem.zlayers;
-
-		for (size_t i = 0; i < elem.activeLayers; ++i)
-		{
-			ZLayer *batchHead = zlayers[i];
-			batchHead->batchedFlag = false;
-
-			GLsizei vboBatchCount = batchHead->vboCount;
-			IntruListLink<SceneElement> *iter = &batchHead->link;
-
-			for (i = i+1; i < elem.activeLayers; ++i)
-			{
-				iter = iter->next;
-				ZLayer *layer = zlayers[i];
+		elem.layerZ.resize(elem.activeLayers.size());
 
-				/* Check if the next SceneElement is also
-				 * the next zlayer in our list. If not,
-				 * the current batch is complete */
-				if (iter != &layer->link)
-					break;
+		for (size_t i = 0; i < elem.activeLayers.size(); ++i)
+			elem.layerZ[i] = 32 * (elem.activeLayers[i] + viewpPos.y + 1) - origin.y;
 
-				vboBatchCount += layer->vboCount;
-				layer->batchedFlag = true;
-			}
-
-			batchHead->vboBatchCount = vboBatchCount;
-			--i;
-		}
+		zOrderDirty = false;
 	}
 
 	void updateMapViewport()
@@ -930,6 +887,11 @@ struct TilemapPrivate
 
 	void prepare()
 	{
+		/* Unlike other elements, tilemaps stay queued for good:
+		 * tileset disposal isn't watched. There are never more
+		 * than a handful of them alive */
+		requestPrepare();
+
 		if (!verifyResources())
 		{
 			if (tilemapReady)
@@ -939,15 +901,10 @@ struct TilemapPrivate
 			return;
 		}
 
-		if (atlasSizeDirty)
+		if (atlasSizeDirty || atlasDirty)
 		{
-			allocateAtlas();
+			updateAtlas();
 			atlasSizeDirty = false;
-		}
-
-		if (atlasDirty)
-		{
-			buildAtlas();
 			atlasDirty = false;
 		}
 
@@ -968,12 +925,7 @@ struct TilemapPrivate
 		flashMap.prepare();
 
 		if (zOrderDirty)
-		{
 			updateZOrder();
-			zOrderDirty = false;
-		}
-
-		prepareZLayerBatches();
 
 		tilemapReady = true;
 	}
@@ -1014,7 +966,7 @@ void GroundLayer::draw()
 
 void GroundLayer::drawInt()
 {
-	gl.DrawElements(GL_TRIANGLES, vboCount, _GL_INDEX_TYPE, (GLvoid*) 0);
+	gl.DrawElements(GL_TRIANGLES, vboCount, shState->globalIBO().type, (GLvoid*) 0);
 }
 
 void GroundLayer::onGeometryChange(const Scene::Geometry &geo)
@@ -1022,30 +974,27 @@ void GroundLayer::onGeometryChange(const Scene::Geometry &geo)
 	p->updateSceneGeometry(geo);
 }
 
-ZLayer::ZLayer(TilemapPrivate *p, Viewport *viewport)
-    : ViewportElement(viewport, 0),
-      index(0),
-      vboOffset(0),
-      vboCount(0),
-      p(p),
-      vboBatchCount(0)
+ZLayerStrip::ZLayerStrip(TilemapPrivate *p, Viewport *viewport)
+    : SceneLayerStrip(viewport ? *viewport : *shState->screen()),
+      p(p)
 {}
 
-void ZLayer::setIndex(int value)
+size_t ZLayerStrip::layerCount() const
 {
-	index = value;
-
-	z = calculateZ(p, index);
-	scene->reinsert(*this);
+	return p->elem.activeLayers.size();
+}
 
-	vboOffset = p->zlayerBases[index] * sizeof(index_t) * 6;
-	vboCount = p->zlayerSize(index) * 6;
+int ZLayerStrip::layerZ(size_t index) const
+{
+	return p->elem.layerZ[index];
 }
 
-void ZLayer::draw()
+void ZLayerStrip::drawLayers(size_t first, size_t last)
 {
-	if (batchedFlag)
-		return;
+	/* Zlayers are stored sequentially in the VBO, and
+	 * the skipped (empty) ones don't take up any space */
+	size_t firstBase = p->zlayerBases[p->elem.activeLayers[first]];
+	size_t lastBase = p->zlayerBases[p->elem.activeLayers[last-1]+1];
 
 	ShaderBase *shader;
 
@@ -1055,36 +1004,13 @@ void ZLayer::draw()
 	GLMeta::vaoBind(p->tiles.vao);
 
 	shader->setTranslation(p->dispPos);
-	drawInt();
+	GlobalIBO &ibo = shState->globalIBO();
+	gl.DrawElements(GL_TRIANGLES, (lastBase - firstBase) * 6, ibo.type,
+	                ibo.quadOffset(firstBase));
 
 	GLMeta::vaoUnbind(p->tiles.vao);
 }
 
-void ZLayer::drawInt()
-{
-	gl.DrawElements(GL_TRIANGLES, vboBatchCount, _GL_INDEX_TYPE, (GLvoid*) vboOffset);
-}
-
-int ZLayer::calculateZ(TilemapPrivate *p, int index)
-{
-	return 32 * (index + p->viewpPos.y + 1) - p->origin.y;
-}
-
-void ZLayer::initUpdateZ()
-{
-	unlink();
-}
-
-void ZLayer::finiUpdateZ(ZLayer *prev)
-{
-	z = calculateZ(p, index);
-
-	if (prev)
-		scene->insertAfter(*this, *prev);
-	else
-		scene->insert(*this);
-}
-
 void Tilemap::Autotiles::set(int i, Bitmap *bitmap)
 {
 	if (!p)
@@ -1144,10 +1070,16 @@ void Tilemap::update()
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
 
+	if (p->flashMap.getData())
+		shState->bumpSceneGeneration();
+
 	/* Animate autotiles */
 	if (!p->tiles.animated)
 		return;
 
+	if (p->tiles.frameIdx != atAnimation[p->tiles.aniIdx])
+		shState->bumpSceneGeneration();
+
 	p->tiles.frameIdx = atAnimation[p->tiles.aniIdx];
 
 	if (++p->tiles.aniIdx >= atAnimationN)
@@ -1167,7 +1099,7 @@ DEF_ATTR_RD_SIMPLE(Tilemap, MapData, Table*, p->mapData)
 DEF_ATTR_RD_SIMPLE(Tilemap, FlashData, Table*, p->flashMap.getData())
 DEF_ATTR_RD_SIMPLE(Tilemap, Priorities, Table*, p->priorities)
 DEF_ATTR_RD_SIMPLE(Tilemap, Visible, bool, p->visible)
-DEF_ATTR_SIMPLE(Tilemap, Wrapping, bool, p->wrapping)
+DEF_ATTR_SCENE(Tilemap, Wrapping, bool, p->wrapping)
 DEF_ATTR_RD_SIMPLE(Tilemap, OX, int, p->origin.x)
 DEF_ATTR_RD_SIMPLE(Tilemap, OY, int, p->origin.y)
 
@@ -1179,6 +1111,7 @@ void Tilemap::setTileset(Bitmap *value)
 		return;
 
 	p->tileset = value;
+	shState->bumpSceneGeneration();
 
 	if (!value)
 		return;
@@ -1199,6 +1132,7 @@ void Tilemap::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
+	shState->bumpSceneGeneration();
 
 	if (!value)
 		return;
@@ -1224,6 +1158,7 @@ void Tilemap::setPriorities(Table *value)
 		return;
 
 	p->priorities = value;
+	shState->bumpSceneGeneration();
 
 	if (!value)
 		return;
@@ -1242,13 +1177,13 @@ void Tilemap::setVisible(bool value)
 		return;
 
 	p->visible = value;
+	shState->bumpSceneGeneration();
 
 	if (!p->tilemapReady)
 		return;
 
 	p->elem.ground->setVisible(value);
-	for (size_t i = 0; i < p->elem.activeLayers; ++i)
-		p->elem.zlayers[i]->setVisible(value);
+	p->elem.zlayers->setVisible(value);
 }
 
 void Tilemap::setOX(int value)
@@ -1259,7 +1194,7 @@ void Tilemap::setOX(int value)
 		return;
 
 	p->origin.x = value;
-	p->mapViewportDirty = true;
+	p->invalidateMapViewport();
 }
 
 void Tilemap::setOY(int value)
@@ -1271,7 +1206,7 @@ void Tilemap::setOY(int value)
 
 	p->origin.y = value;
 	p->zOrderDirty = true;
-	p->mapViewportDirty = true;
+	p->invalidateMapViewport();
 }
 
 void Tilemap::releaseResources()
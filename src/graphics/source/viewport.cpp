@@ -167,16 +167,16 @@ void Viewport::update()
 DEF_ATTR_RD_SIMPLE(Viewport, OX,   int,   geometry.orig.x)
 DEF_ATTR_RD_SIMPLE(Viewport, OY,   int,   geometry.orig.y)
 
-DEF_ATTR_SIMPLE(Viewport, Rect,  Rect&,  *p->rect)
-DEF_ATTR_SIMPLE(Viewport, Color, Color&, *p->color)
-DEF_ATTR_SIMPLE(Viewport, Tone,  Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Viewport, Scanned, bool, p->scanned)
-DEF_ATTR_SIMPLE(Viewport, CubicTime, float, p->cubicTime)
-DEF_ATTR_SIMPLE(Viewport, BinaryStrength, float, p->binaryStrength)
-DEF_ATTR_SIMPLE(Viewport, WaterTime, float, p->waterTime)
-DEF_ATTR_SIMPLE(Viewport, RGBOffsetx, Vec4, p->rgbOffsetx)
-DEF_ATTR_SIMPLE(Viewport, RGBOffsety, Vec4, p->rgbOffsety)
-DEF_ATTR_SIMPLE(Viewport, Zoom, Vec2, p->zoom)
+DEF_ATTR_SCENE(Viewport, Rect,  Rect&,  *p->rect)
+DEF_ATTR_SCENE(Viewport, Color, Color&, *p->color)
+DEF_ATTR_SCENE(Viewport, Tone,  Tone&,  *p->tone)
+DEF_ATTR_SCENE(Viewport, Scanned, bool, p->scanned)
+DEF_ATTR_SCENE(Viewport, CubicTime, float, p->cubicTime)
+DEF_ATTR_SCENE(Viewport, BinaryStrength, float, p->binaryStrength)
+DEF_ATTR_SCENE(Viewport, WaterTime, float, p->waterTime)
+DEF_ATTR_SCENE(Viewport, RGBOffsetx, Vec4, p->rgbOffsetx)
+DEF_ATTR_SCENE(Viewport, RGBOffsety, Vec4, p->rgbOffsety)
+DEF_ATTR_SCENE(Viewport, Zoom, Vec2, p->zoom)
 
 void Viewport::setOX(int value)
 {
@@ -217,7 +217,7 @@ void Viewport::composite()
 
 	bool renderEffect = p->needsEffectRender(flashing);
 
-	if (elements.getSize() == 0 && !renderEffect)
+	if (isEmpty() && !renderEffect)
 		return;
 
 	/* Setup scissor */
@@ -242,6 +242,13 @@ void Viewport::draw()
 	composite();
 }
 
+bool Viewport::isCulled() const
+{
+	/* Off-screen or empty viewports can neither show
+	 * any of their children nor any effects */
+	return !p->isOnScreen;
+}
+
 void Viewport::onGeometryChange(const Geometry &geo)
 {
 	p->screenRect = geo.rect;
@@ -23,6 +23,7 @@
 
 #include "viewport.h"
 #include "sharedstate.h"
+#include "preparable.h"
 #include "bitmap.h"
 #include "etc.h"
 #include "etc-internal.h"
@@ -34,6 +35,8 @@
 #include "texpool.h"
 #include "glstate.h"
 
+#include <SDL2/SDL_rect.h>
+
 #include <sigc++/connection.h>
 
 template<typename T>
@@ -166,7 +169,7 @@ struct QuadChunk
  *   quad array directly to the screen.
  */
 
-struct WindowPrivate
+struct WindowPrivate : public Preparable
 {
 	Bitmap *windowskin;
 
@@ -180,6 +183,7 @@ struct WindowPrivate
 	sigc::connection cursorRectCon;
 
 	Vec2i sceneOffset;
+	IntRect sceneRect;
 
 	Vec2i position;
 	Vec2i size;
@@ -220,6 +224,11 @@ struct WindowPrivate
 			p->drawControls();
 		}
 
+		bool isCulled() const
+		{
+			return !p->isOnScreen();
+		}
+
 		void release()
 		{
 			unlink();
@@ -246,8 +255,6 @@ struct WindowPrivate
 
 	EtcTemps tmp;
 
-	sigc::connection prepareCon;
-
 	WindowPrivate(Viewport *viewport = 0)
 	    : windowskin(0),
 	      contents(0),
@@ -273,20 +280,38 @@ struct WindowPrivate
 		cursorVert.count = 9;
 		pauseAniVert.count = 1;
 
-		prepareCon = shState->prepareDraw.connect
-		        (sigc::mem_fun(this, &WindowPrivate::prepare));
+		requestPrepare();
 	}
 
 	~WindowPrivate()
 	{
 		shState->texPool().release(baseTex);
 		cursorRectCon.disconnect();
-		prepareCon.disconnect();
+	}
+
+	void markBaseVertDirty()
+	{
+		baseVertDirty = true;
+		requestPrepare();
+	}
+
+	void markOpacityDirty()
+	{
+		opacityDirty = true;
+		requestPrepare();
 	}
 
 	void markControlVertDirty()
 	{
 		controlsVertDirty = true;
+		shState->bumpSceneGeneration();
+	}
+
+	/* Cursor blink / pause arrow animation
+	 * changes the window every frame */
+	bool isAnimating() const
+	{
+		return (active && cursorVert.vert) || (pause && pauseAniVert.vert);
 	}
 
 	void refreshCursorRectCon()
@@ -548,6 +573,14 @@ struct WindowPrivate
 		}
 	}
 
+	/* Base and controls are both clipped to the window rect */
+	bool isOnScreen() const
+	{
+		const IntRect windowRect(position + sceneOffset, size);
+
+		return SDL_HasIntersection(&windowRect, &sceneRect);
+	}
+
 	void drawBase()
 	{
 		if (nullOrDisposed(windowskin))
@@ -695,11 +728,14 @@ void Window::update()
 
 	p->updateControls();
 	p->stepAnimations();
+
+	if (p->isAnimating())
+		shState->bumpSceneGeneration();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
-DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
+DEF_ATTR_SCENE(Window, X,          int,     p->position.x)
+DEF_ATTR_SCENE(Window, Y,          int,     p->position.y)
+DEF_ATTR_SCENE(Window, CursorRect, Rect&,  *p->cursorRect)
 
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(Window, Contents,        Bitmap*, p->contents)
@@ -719,6 +755,7 @@ void Window::setWindowskin(Bitmap *value)
 	guardDisposed();
 
 	p->windowskin = value;
+	shState->bumpSceneGeneration();
 
 	if (nullOrDisposed(value))
 		return;
@@ -734,7 +771,7 @@ void Window::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
-	p->controlsVertDirty = true;
+	p->markControlVertDirty();
 
 	if (nullOrDisposed(value))
 		return;
@@ -751,7 +788,7 @@ void Window::setStretch(bool value)
 		return;
 
 	p->bgStretch = value;
-	p->baseVertDirty = true;
+	p->markBaseVertDirty();
 }
 
 void Window::setActive(bool value)
@@ -763,6 +800,8 @@ void Window::setActive(bool value)
 
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
+
+	shState->bumpSceneGeneration();
 }
 
 void Window::setPause(bool value)
@@ -775,7 +814,7 @@ void Window::setPause(bool value)
 	p->pause = value;
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
-	p->controlsVertDirty = true;
+	p->markControlVertDirty();
 }
 
 void Window::setWidth(int value)
@@ -786,7 +825,7 @@ void Window::setWidth(int value)
 		return;
 
 	p->size.x = value;
-	p->baseVertDirty = true;
+	p->markBaseVertDirty();
 }
 
 void Window::setHeight(int value)
@@ -797,7 +836,7 @@ void Window::setHeight(int value)
 		return;
 
 	p->size.y = value;
-	p->baseVertDirty = true;
+	p->markBaseVertDirty();
 }
 
 void Window::setOX(int value)
@@ -808,7 +847,7 @@ void Window::setOX(int value)
 		return;
 
 	p->contentsOffset.x = value;
-	p->controlsVertDirty = true;
+	p->markControlVertDirty();
 }
 
 void Window::setOY(int value)
@@ -819,7 +858,7 @@ void Window::setOY(int value)
 		return;
 
 	p->contentsOffset.y = value;
-	p->controlsVertDirty = true;
+	p->markControlVertDirty();
 }
 
 void Window::setOpacity(int value)
@@ -830,7 +869,7 @@ void Window::setOpacity(int value)
 		return;
 
 	p->opacity = value;
-	p->opacityDirty = true;
+	p->markOpacityDirty();
 }
 
 void Window::setBackOpacity(int value)
@@ -841,7 +880,7 @@ void Window::setBackOpacity(int value)
 		return;
 
 	p->backOpacity = value;
-	p->opacityDirty = true;
+	p->markOpacityDirty();
 }
 
 void Window::setContentsOpacity(int value)
@@ -853,6 +892,8 @@ void Window::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+
+	shState->bumpSceneGeneration();
 }
 
 void Window::initDynAttribs()
@@ -870,6 +911,12 @@ void Window::draw()
 void Window::onGeometryChange(const Scene::Geometry &geo)
 {
 	p->sceneOffset = geo.offset();
+	p->sceneRect = geo.rect;
+}
+
+bool Window::isCulled() const
+{
+	return !p->isOnScreen();
 }
 
 void Window::setZ(int value)
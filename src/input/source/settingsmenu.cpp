@@ -1109,7 +1109,7 @@ SettingsMenu::SettingsMenu(RGSSThreadData &rtData)
 	p->winSurf = SDL_GetWindowSurface(p->window);
 	p->winID = SDL_GetWindowID(p->window);
 
-	p->font = shState->fontState().getFont(getFontName(), getFontSize());
+	p->font = shState->fontState().getFont(getFontName(), getFontSize(), true);
 
 
 	p->rgb = p->winSurf->format;
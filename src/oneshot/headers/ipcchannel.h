@@ -0,0 +1,70 @@
+#ifndef IPCCHANNEL_H
+#define IPCCHANNEL_H
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Channel carrying length prefixed messages between the game and a
+ * companion process it spawned. One side listens, the other one
+ * connects, and the connection then stays open for all messages.
+ *
+ * A message is sent with a single write, and incoming data is read
+ * in batches without blocking; 'wait()' sleeps until data arrives,
+ * so readers don't have to poll.
+ *
+ * Unix domain stream socket on POSIX, named pipe on Windows.
+ * Sockets are created in a directory private to the user, and
+ * peers running as another user are turned away */
+class IPCChannel
+{
+public:
+	IPCChannel();
+	~IPCChannel();
+
+	/* Server side: creates the endpoint 'name', then waits up
+	 * to 'timeoutMs' for the other side to connect */
+	bool listen(const char *name);
+	bool accept(int timeoutMs);
+
+	/* Client side: connects to the endpoint 'name', retrying
+	 * for up to 'timeoutMs' if it doesn't exist yet */
+	bool connect(const char *name, int timeoutMs);
+
+	bool send(const void *data, uint32_t size);
+	bool send(const std::string &msg);
+
+	/* Returns true once a complete message can be received,
+	 * or false after 'timeoutMs' or if the connection broke */
+	bool wait(int timeoutMs);
+
+	/* Takes the next complete message, if any */
+	bool receive(std::string &msg);
+
+	bool isConnected() const;
+	void close();
+
+private:
+	bool fill();
+	bool hasMessage() const;
+
+	std::string path;
+	bool server;
+
+	/* Received bytes not yet taken out as messages */
+	std::vector<char> buffer;
+
+#ifdef _WIN32
+	HANDLE handle;
+	bool connected;
+#else
+	int listenFd;
+	int fd;
+#endif
+};
+
+#endif // IPCCHANNEL_H
@@ -46,7 +46,8 @@ public:
 		GRADIENT_VERTICAL,
 	};
 
-	void update();
+	//Tracks the parts of the window moved offscreen
+	void update(int screenW, int screenH);
 
 	//Accessors
 	const std::string &os() const;
@@ -57,6 +58,8 @@ public:
 	const std::string &gamePath() const;
 	const std::string &journal() const;
 	const std::vector<uint8_t> &obscuredMap() const;
+	int obscuredWidth() const;
+	int obscuredHeight() const;
 	bool obscuredCleared() const;
 	bool allowExit() const;
 	bool exiting() const;
@@ -72,14 +75,18 @@ public:
 	bool msgbox(int type, const char *body, const char *title);
 	std::string textinput(const char* prompt, int char_limit, const char* fontName);
 
-	//Dirty flag for obscured texture
+	//Dirty flag for obscured texture, and the range of
+	//rows [top, bottom) that changed since it was cleared
 	bool obscuredDirty;
+	int obscuredDirtyTop, obscuredDirtyBottom;
 
 #ifdef __linux__
 	std::string desktopEnv;
 #endif
 
 private:
+	void markObscuredRows(int top, int bottom);
+
 	OneshotPrivate *p;
 	RGSSThreadData &threadData;
 };
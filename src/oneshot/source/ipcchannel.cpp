@@ -0,0 +1,601 @@
+#include "ipcchannel.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#define HEADER_SIZE sizeof(uint32_t)
+#define MAX_MESSAGE_SIZE (1024 * 1024)
+#define READ_CHUNK 4096
+#define RETRY_INTERVAL 10
+/* How long a send waits for a reader that stopped taking data */
+#define SEND_TIMEOUT 500
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+#ifndef _WIN32
+/* Sockets live in a directory only the user can enter, so nobody
+ * else can claim an endpoint first or connect to it. Keep this in
+ * sync with get_channel_dir() in journal/unix/journal.py */
+static std::string endpointDir(const char *name)
+{
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	const char *home = getenv("HOME");
+
+	std::string dir;
+
+	if (runtime && *runtime)
+		dir = std::string(runtime) + "/oneshot";
+	else if (home && *home)
+		dir = std::string(home) + "/.oneshot";
+
+	/* Too long for a socket path (with "/", ".sock" and the
+	 * terminator), or no home at all */
+	if (dir.empty() || dir.size() + strlen(name) + 7 > sizeof(sockaddr_un().sun_path))
+	{
+		std::string tmp(P_tmpdir);
+
+		if (!tmp.empty() && tmp[tmp.size()-1] == '/')
+			tmp.erase(tmp.size()-1);
+
+		char uid[32];
+		snprintf(uid, sizeof(uid), "%u", (unsigned) getuid());
+
+		dir = tmp + "/oneshot-" + uid;
+	}
+
+	return dir;
+}
+
+/* Makes sure 'dir' exists, belongs to us and is private */
+static bool prepareDir(const std::string &dir)
+{
+	mkdir(dir.c_str(), 0700);
+
+	struct stat st;
+
+	if (lstat(dir.c_str(), &st) < 0)
+		return false;
+
+	if (!S_ISDIR(st.st_mode) || st.st_uid != getuid())
+		return false;
+
+	if ((st.st_mode & 077) && chmod(dir.c_str(), 0700) < 0)
+		return false;
+
+	return true;
+}
+
+/* Whether the other end of 'fd' runs as the same user */
+static bool peerIsUs(int fd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return false;
+
+	return cred.uid == getuid();
+#else
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(fd, &uid, &gid) < 0)
+		return false;
+
+	return uid == getuid();
+#endif
+}
+#endif
+
+static std::string endpointPath(const char *name)
+{
+#ifdef _WIN32
+	return std::string("\\\\.\\pipe\\") + name;
+#else
+	return endpointDir(name) + "/" + name + ".sock";
+#endif
+}
+
+#ifndef _WIN32
+static bool fillAddress(sockaddr_un &addr, const std::string &path)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(addr.sun_path))
+		return false;
+
+	strcpy(addr.sun_path, path.c_str());
+
+	return true;
+}
+
+static void setupFd(int fd, bool nonBlocking)
+{
+	/* Don't leak into spawned processes */
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	if (nonBlocking)
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+#endif
+
+IPCChannel::IPCChannel()
+    : server(false),
+#ifdef _WIN32
+      handle(INVALID_HANDLE_VALUE),
+      connected(false)
+#else
+      listenFd(-1),
+      fd(-1)
+#endif
+{}
+
+IPCChannel::~IPCChannel()
+{
+	close();
+}
+
+bool IPCChannel::listen(const char *name)
+{
+	close();
+	buffer.clear();
+
+	path = endpointPath(name);
+	server = true;
+
+#ifdef _WIN32
+	/* Non-blocking, so neither accepting nor sending can hang */
+	handle = CreateNamedPipeA(path.c_str(),
+	                          PIPE_ACCESS_DUPLEX,
+	                          PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_NOWAIT,
+	                          1, READ_CHUNK, READ_CHUNK, 0, NULL);
+
+	return handle != INVALID_HANDLE_VALUE;
+#else
+	sockaddr_un addr;
+
+	if (!fillAddress(addr, path) || !prepareDir(endpointDir(name)))
+		return false;
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listenFd < 0)
+		return false;
+
+	setupFd(listenFd, false);
+
+	/* Left behind by a previous run that crashed */
+	unlink(path.c_str());
+
+	if (bind(listenFd, (sockaddr*) &addr, sizeof(addr)) < 0 ||
+	    chmod(path.c_str(), 0600) < 0 ||
+	    ::listen(listenFd, 1) < 0)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+bool IPCChannel::accept(int timeoutMs)
+{
+#ifdef _WIN32
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	/* The pipe doesn't block, so this only checks for a client */
+	for (int waited = 0;; waited += RETRY_INTERVAL)
+	{
+		if (ConnectNamedPipe(handle, NULL))
+			break;
+
+		DWORD error = GetLastError();
+
+		if (error == ERROR_PIPE_CONNECTED)
+			break;
+
+		/* A client came and already went; make room for the next */
+		if (error == ERROR_NO_DATA)
+			DisconnectNamedPipe(handle);
+		else if (error != ERROR_PIPE_LISTENING)
+			return false;
+
+		if (timeoutMs >= 0 && waited >= timeoutMs)
+			return false;
+
+		Sleep(RETRY_INTERVAL);
+	}
+
+	connected = true;
+
+	return connected;
+#else
+	if (listenFd < 0)
+		return false;
+
+	for (;;)
+	{
+		pollfd pfd = { listenFd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, timeoutMs) <= 0)
+			return false;
+
+		fd = ::accept(listenFd, 0, 0);
+
+		if (fd < 0)
+			return false;
+
+		if (peerIsUs(fd))
+			break;
+
+		/* Somebody else got in; keep waiting for the real client */
+		::close(fd);
+		fd = -1;
+	}
+
+	setupFd(fd, true);
+
+	/* Only ever one client */
+	::close(listenFd);
+	listenFd = -1;
+	unlink(path.c_str());
+
+	return true;
+#endif
+}
+
+bool IPCChannel::connect(const char *name, int timeoutMs)
+{
+	close();
+	buffer.clear();
+
+	path = endpointPath(name);
+	server = false;
+
+#ifdef _WIN32
+	for (int waited = 0;; waited += RETRY_INTERVAL)
+	{
+		handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+		                     0, NULL, OPEN_EXISTING, 0, NULL);
+
+		if (handle != INVALID_HANDLE_VALUE)
+			break;
+
+		if (waited >= timeoutMs)
+			return false;
+
+		Sleep(RETRY_INTERVAL);
+	}
+
+	DWORD mode = PIPE_READMODE_BYTE | PIPE_NOWAIT;
+	SetNamedPipeHandleState(handle, &mode, NULL, NULL);
+
+	connected = true;
+
+	return true;
+#else
+	sockaddr_un addr;
+
+	if (!fillAddress(addr, path))
+		return false;
+
+	for (int waited = 0;; waited += RETRY_INTERVAL)
+	{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			return false;
+
+		if (::connect(fd, (sockaddr*) &addr, sizeof(addr)) == 0 && peerIsUs(fd))
+			break;
+
+		::close(fd);
+		fd = -1;
+
+		if (waited >= timeoutMs)
+			return false;
+
+		usleep(RETRY_INTERVAL * 1000);
+	}
+
+	setupFd(fd, true);
+
+	return true;
+#endif
+}
+
+bool IPCChannel::send(const void *data, uint32_t size)
+{
+	if (!isConnected())
+		return false;
+
+	/* Header and payload go out in one write */
+	std::vector<char> frame(HEADER_SIZE + size);
+	memcpy(&frame[0], &size, HEADER_SIZE);
+
+	if (size > 0)
+		memcpy(&frame[HEADER_SIZE], data, size);
+
+	size_t sent = 0;
+#ifdef _WIN32
+	DWORD progress = GetTickCount();
+#endif
+
+	while (sent < frame.size())
+	{
+#ifdef _WIN32
+		DWORD written = 0;
+
+		if (!WriteFile(handle, &frame[sent], frame.size() - sent, &written, NULL))
+		{
+			close();
+			return false;
+		}
+
+		sent += written;
+
+		if (written > 0)
+		{
+			progress = GetTickCount();
+			continue;
+		}
+
+		/* Pipe buffer is full; wait for room, but not
+		 * forever if the reader stopped reading altogether */
+		if (GetTickCount() - progress >= SEND_TIMEOUT)
+		{
+			close();
+			return false;
+		}
+
+		Sleep(1);
+#else
+		ssize_t written = ::send(fd, &frame[sent], frame.size() - sent, SEND_FLAGS);
+
+		if (written >= 0)
+		{
+			sent += written;
+			continue;
+		}
+
+		if (errno == EINTR)
+			continue;
+
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			/* Reader is behind, wait for room, but not
+			 * forever if it stopped reading altogether */
+			pollfd pfd = { fd, POLLOUT, 0 };
+			int result = poll(&pfd, 1, SEND_TIMEOUT);
+
+			if (result > 0 || (result < 0 && errno == EINTR))
+				continue;
+		}
+
+		close();
+		return false;
+#endif
+	}
+
+	return true;
+}
+
+bool IPCChannel::send(const std::string &msg)
+{
+	return send(msg.c_str(), msg.size());
+}
+
+bool IPCChannel::wait(int timeoutMs)
+{
+	if (hasMessage())
+		return true;
+
+#ifdef _WIN32
+	/* Named pipes can't be waited on without overlapped I/O,
+	 * so fall back to checking at a short interval */
+	DWORD start = GetTickCount();
+
+	for (;;)
+	{
+		if (!fill())
+			return false;
+
+		if (hasMessage())
+			return true;
+
+		if ((int) (GetTickCount() - start) >= timeoutMs)
+			return false;
+
+		Sleep(1);
+	}
+#else
+	for (;;)
+	{
+		if (!isConnected())
+			return false;
+
+		pollfd pfd = { fd, POLLIN, 0 };
+		int result = poll(&pfd, 1, timeoutMs);
+
+		if (result < 0 && errno == EINTR)
+			continue;
+
+		if (result <= 0)
+			return false;
+
+		fill();
+
+		return hasMessage();
+	}
+#endif
+}
+
+bool IPCChannel::receive(std::string &msg)
+{
+	if (!hasMessage() && isConnected())
+		fill();
+
+	if (!hasMessage())
+		return false;
+
+	uint32_t size;
+	memcpy(&size, &buffer[0], HEADER_SIZE);
+
+	msg.assign(&buffer[HEADER_SIZE], size);
+	buffer.erase(buffer.begin(), buffer.begin() + HEADER_SIZE + size);
+
+	return true;
+}
+
+bool IPCChannel::isConnected() const
+{
+#ifdef _WIN32
+	return connected;
+#else
+	return fd >= 0;
+#endif
+}
+
+void IPCChannel::close()
+{
+	/* Already received messages stay in the buffer */
+#ifdef _WIN32
+	if (handle != INVALID_HANDLE_VALUE)
+	{
+		if (server && connected)
+			DisconnectNamedPipe(handle);
+
+		CloseHandle(handle);
+	}
+
+	handle = INVALID_HANDLE_VALUE;
+	connected = false;
+#else
+	if (fd >= 0)
+		::close(fd);
+
+	if (listenFd >= 0)
+	{
+		::close(listenFd);
+		unlink(path.c_str());
+	}
+
+	fd = listenFd = -1;
+#endif
+}
+
+/* Reads everything that is available without blocking.
+ * Returns false if the connection is gone */
+bool IPCChannel::fill()
+{
+	if (!isConnected())
+		return false;
+
+#ifdef _WIN32
+	DWORD avail = 0;
+
+	if (!PeekNamedPipe(handle, NULL, 0, NULL, &avail, NULL))
+	{
+		close();
+		return false;
+	}
+
+	if (avail == 0)
+		return true;
+
+	size_t oldSize = buffer.size();
+	buffer.resize(oldSize + avail);
+
+	DWORD read = 0;
+
+	if (!ReadFile(handle, &buffer[oldSize], avail, &read, NULL))
+	{
+		buffer.resize(oldSize);
+		close();
+
+		return false;
+	}
+
+	buffer.resize(oldSize + read);
+#else
+	char chunk[READ_CHUNK];
+
+	for (;;)
+	{
+		ssize_t result = ::read(fd, chunk, sizeof(chunk));
+
+		if (result > 0)
+		{
+			buffer.insert(buffer.end(), chunk, chunk + result);
+
+			if ((size_t) result < sizeof(chunk))
+				break;
+
+			continue;
+		}
+
+		if (result < 0 && errno == EINTR)
+			continue;
+
+		if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		/* Closed by the other side, or broken */
+		close();
+		return false;
+	}
+#endif
+
+	if (buffer.size() >= HEADER_SIZE)
+	{
+		uint32_t size;
+		memcpy(&size, &buffer[0], HEADER_SIZE);
+
+		/* Garbage; nothing after this can be trusted */
+		if (size > MAX_MESSAGE_SIZE)
+		{
+			buffer.clear();
+			close();
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool IPCChannel::hasMessage() const
+{
+	if (buffer.size() < HEADER_SIZE)
+		return false;
+
+	uint32_t size;
+	memcpy(&size, &buffer[0], HEADER_SIZE);
+
+	return buffer.size() >= HEADER_SIZE + size;
+}
@@ -13,6 +13,11 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 
+#include <pixman.h>
+
+#include <vector>
+#include <algorithm>
+
 // OS-Specific code
 #if defined _WIN32
 	#define OS_W32
@@ -71,16 +76,24 @@ struct OneshotPrivate
 	SDL_mutex *winMutex;
 	bool winPosChanged;
 	std::vector<uint8_t> obscuredMap;
+	int obscuredW, obscuredH;
 	bool obscuredCleared;
 
+	// Window local area that has been offscreen at some point
+	pixman_region32_t revealed;
+
 	OneshotPrivate()
 		: window(0),
-	      winMutex(SDL_CreateMutex())
+	      winMutex(SDL_CreateMutex()),
+	      obscuredW(0),
+	      obscuredH(0)
 	{
+		pixman_region32_init(&revealed);
 	}
 
 	~OneshotPrivate()
 	{
+		pixman_region32_fini(&revealed);
 		SDL_DestroyMutex(winMutex);
 	}
 };
@@ -179,8 +192,9 @@ Oneshot::Oneshot(RGSSThreadData &threadData) :
 	p = new OneshotPrivate();
 	p->window = threadData.window;
 	p->savePath = threadData.config.commonDataPath.substr(0, threadData.config.commonDataPath.size() - 1);
-	p->obscuredMap.resize(640 * 480, 255);
-	obscuredDirty = true;
+	p->obscuredW = DEF_SCREEN_W;
+	p->obscuredH = DEF_SCREEN_H;
+	resetObscured();
 	p->winX = 0;
 	p->winY = 0;
 	p->winPosChanged = false;
@@ -326,71 +340,88 @@ Oneshot::~Oneshot()
 	delete p;
 }
 
-void Oneshot::update()
+void Oneshot::update(int screenW, int screenH)
 {
-	if (p->winPosChanged)
+	if (screenW != p->obscuredW || screenH != p->obscuredH)
 	{
-		p->winPosChanged = false;
-
-		//Map of unobscured pixels in this frame
-		static std::vector<bool> obscuredFrame;
-		obscuredFrame.resize(p->obscuredMap.size());
-		std::fill(obscuredFrame.begin(), obscuredFrame.end(), true);
-
-		SDL_Rect screenRect;
-		SDL_LockMutex(p->winMutex);
-		screenRect.x = p->winX;
-		screenRect.y = p->winY;
-		SDL_UnlockMutex(p->winMutex);
-		screenRect.w = 640;
-		screenRect.h = 480;
-
-		//Update obscured map and texture for window portion offscreen
-		for (int i = 0, max = SDL_GetNumVideoDisplays(); i < max; ++i)
-		{
-			SDL_Rect bounds;
-			SDL_GetDisplayBounds(i, &bounds);
-
-			//Get intersection of window and the screen
-			SDL_Rect intersect;
-			if (!SDL_IntersectRect(&screenRect, &bounds, &intersect))
-				continue;
-			intersect.x -= screenRect.x;
-			intersect.y -= screenRect.y;
-
-			//If it's entirely within the bounds of the screen, we don't need to check out
-			//any other monitors
-			if (intersect.x == 0 && intersect.y == 0 && intersect.w == 640 && intersect.h == 480)
-				return;
-
-			for (int y = intersect.y; y < intersect.y + intersect.h; ++y)
-			{
-				int start = y * 640 + intersect.x;
-				std::fill(obscuredFrame.begin() + start, obscuredFrame.begin() + (start + intersect.w), false);
-			}
-		}
+		p->obscuredW = screenW;
+		p->obscuredH = screenH;
+		resetObscured();
+
+		p->winPosChanged = true;
+	}
+
+	if (!p->winPosChanged)
+		return;
+
+	p->winPosChanged = false;
+
+	int winX, winY;
+	SDL_LockMutex(p->winMutex);
+	winX = p->winX;
+	winY = p->winY;
+	SDL_UnlockMutex(p->winMutex);
+
+	//Window area not covered by any display, in window coordinates
+	pixman_region32_t offscreen;
+	pixman_region32_init_rect(&offscreen, 0, 0, screenW, screenH);
+
+	for (int i = 0, max = SDL_GetNumVideoDisplays(); i < max; ++i)
+	{
+		SDL_Rect bounds;
+		if (SDL_GetDisplayBounds(i, &bounds) != 0)
+			continue;
+
+		pixman_region32_t display;
+		pixman_region32_init_rect(&display, bounds.x - winX, bounds.y - winY, bounds.w, bounds.h);
+		pixman_region32_subtract(&offscreen, &offscreen, &display);
+		pixman_region32_fini(&display);
+	}
+
+	//Only the part that wasn't revealed before changes anything
+	pixman_region32_subtract(&offscreen, &offscreen, &p->revealed);
+
+	int count;
+	const pixman_box32_t *boxes = pixman_region32_rectangles(&offscreen, &count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const pixman_box32_t &box = boxes[i];
 
-		//Update the obscured map, and return prematurely if we don't have any changes
-		//to make to the texture
-		bool needsUpdate = false;
-		bool cleared = true;
-		for (size_t i = 0; i < obscuredFrame.size(); ++i)
+		for (int y = box.y1; y < box.y2; ++y)
 		{
-			if (obscuredFrame[i])
-			{
-				p->obscuredMap[i] = 0;
-				needsUpdate = true;
-			}
-			if (p->obscuredMap[i] == 255)
-				cleared = false;
+			uint8_t *row = &p->obscuredMap[y * screenW];
+			std::fill(row + box.x1, row + box.x2, 0);
 		}
-		p->obscuredCleared = cleared;
-		if (!needsUpdate)
-			return;
 
-		//Flag as dirty
+		markObscuredRows(box.y1, box.y2);
+	}
+
+	if (count > 0)
+	{
+		pixman_region32_union(&p->revealed, &p->revealed, &offscreen);
+
+		pixman_box32_t full = { 0, 0, screenW, screenH };
+		p->obscuredCleared =
+			pixman_region32_contains_rectangle(&p->revealed, &full) == PIXMAN_REGION_IN;
+	}
+
+	pixman_region32_fini(&offscreen);
+}
+
+void Oneshot::markObscuredRows(int top, int bottom)
+{
+	if (!obscuredDirty)
+	{
+		obscuredDirtyTop = top;
+		obscuredDirtyBottom = bottom;
 		obscuredDirty = true;
+
+		return;
 	}
+
+	obscuredDirtyTop = std::min(obscuredDirtyTop, top);
+	obscuredDirtyBottom = std::max(obscuredDirtyBottom, bottom);
 }
 
 const std::string &Oneshot::os() const
@@ -433,6 +464,16 @@ const std::vector<uint8_t> &Oneshot::obscuredMap() const
 	return p->obscuredMap;
 }
 
+int Oneshot::obscuredWidth() const
+{
+	return p->obscuredW;
+}
+
+int Oneshot::obscuredHeight() const
+{
+	return p->obscuredH;
+}
+
 bool Oneshot::obscuredCleared() const
 {
 	return p->obscuredCleared;
@@ -616,7 +657,12 @@ void Oneshot::setWindowPos(int x, int y)
 
 void Oneshot::resetObscured()
 {
-	std::fill(p->obscuredMap.begin(), p->obscuredMap.end(), 255);
-	obscuredDirty = true;
+	p->obscuredMap.assign(p->obscuredW * p->obscuredH, 255);
 	p->obscuredCleared = false;
+
+	pixman_region32_fini(&p->revealed);
+	pixman_region32_init(&p->revealed);
+
+	obscuredDirty = false;
+	markObscuredRows(0, p->obscuredH);
 }
\ No newline at end of file
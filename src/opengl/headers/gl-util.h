@@ -25,6 +25,72 @@
 #include "gl-fun.h"
 #include "etc-internal.h"
 
+#include <assert.h>
+#include <stdint.h>
+
+/* GL calls sent to the driver vs. skipped because the
+ * requested state was already current */
+struct GLCallStats
+{
+	/* Current frame */
+	unsigned issued, skipped;
+
+	/* Finished frames */
+	uint64_t totalIssued, totalSkipped;
+	unsigned frames;
+
+	void endFrame()
+	{
+		totalIssued += issued;
+		totalSkipped += skipped;
+		issued = skipped = 0;
+		++frames;
+	}
+};
+
+extern GLCallStats glCallStats;
+
+/* Shadow of the object bindings of the RGSS context, so binding
+ * what is already bound doesn't reach the driver. Unlike GLState,
+ * this has to exist before SharedState does (the global IBO and
+ * ShaderSet bind objects while it's being constructed). Starts out
+ * all zero, like a fresh context */
+struct GLBindings
+{
+	enum { TexUnits = 8 };
+
+	GLuint tex[TexUnits];
+	GLuint activeUnit;
+
+	GLuint fbo;
+	GLuint vbo;
+	GLuint ibo;
+
+	/* Native VAO, or VBO + attribute layout of the
+	 * emulated one whose arrays are currently set up */
+	GLuint vao;
+	GLuint vaoVBO;
+	const void *vaoAttr;
+	unsigned attrMask;
+};
+
+extern GLBindings glBindings;
+
+/* Updates 'bound' and returns true if 'value' isn't bound yet */
+static inline bool glBindNeeded(GLuint &bound, GLuint value)
+{
+	if (bound == value)
+	{
+		++glCallStats.skipped;
+		return false;
+	}
+
+	bound = value;
+	++glCallStats.issued;
+
+	return true;
+}
+
 /* Struct wrapping GLuint for some light type safety */
 #define DEF_GL_ID \
 struct ID \
@@ -63,12 +129,35 @@ namespace TEX
 
 	static inline void del(ID id)
 	{
+		/* Deleted textures revert to 0 on all units */
+		for (size_t i = 0; i < GLBindings::TexUnits; ++i)
+			if (glBindings.tex[i] == id.gl)
+				glBindings.tex[i] = 0;
+
 		gl.DeleteTextures(1, &id.gl);
 	}
 
+	static inline void setActiveUnit(unsigned unit)
+	{
+		assert(unit < GLBindings::TexUnits);
+
+		if (glBindNeeded(glBindings.activeUnit, unit))
+			gl.ActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	static inline void bindUnit(unsigned unit, ID id)
+	{
+		setActiveUnit(unit);
+
+		if (glBindNeeded(glBindings.tex[unit], id.gl))
+			gl.BindTexture(GL_TEXTURE_2D, id.gl);
+	}
+
+	/* Binds to unit 0, which all uploads and
+	 * parameter changes go through */
 	static inline void bind(ID id)
 	{
-		gl.BindTexture(GL_TEXTURE_2D, id.gl);
+		bindUnit(0, id);
 	}
 
 	static inline void unbind()
@@ -119,12 +208,16 @@ namespace FBO
 
 	static inline void del(ID id)
 	{
+		if (glBindings.fbo == id.gl)
+			glBindings.fbo = 0;
+
 		gl.DeleteFramebuffers(1, &id.gl);
 	}
 
 	static inline void bind(ID id)
 	{
-		gl.BindFramebuffer(GL_FRAMEBUFFER, id.gl);
+		if (glBindNeeded(glBindings.fbo, id.gl))
+			gl.BindFramebuffer(GL_FRAMEBUFFER, id.gl);
 	}
 
 	static inline void unbind()
@@ -156,14 +249,27 @@ struct GenericBO
 		return id;
 	}
 
+	static inline GLuint &bound()
+	{
+		return target == GL_ARRAY_BUFFER ? glBindings.vbo : glBindings.ibo;
+	}
+
 	static inline void del(ID id)
 	{
+		if (bound() == id.gl)
+			bound() = 0;
+
+		/* Attribute arrays sourcing from it are gone too */
+		if (glBindings.vaoVBO == id.gl)
+			glBindings.vaoVBO = 0;
+
 		gl.DeleteBuffers(1, &id.gl);
 	}
 
 	static inline void bind(ID id)
 	{
-		gl.BindBuffer(target, id.gl);
+		if (glBindNeeded(bound(), id.gl))
+			gl.BindBuffer(target, id.gl);
 	}
 
 	static inline void unbind()
@@ -23,22 +23,29 @@
 #define GLOBALIBO_H
 
 #include "gl-util.h"
+#include "exception.h"
 
 #include <vector>
-#include <limits>
-#include <assert.h>
+#include <algorithm>
 #include <stdint.h>
 
-typedef uint16_t index_t;
-#define INDEX_T_MAX std::numeric_limits<index_t>::max()
-#define _GL_INDEX_TYPE GL_UNSIGNED_SHORT
+/* Quads addressable with 16 bit indices */
+#define IBO_MAX_SHORT_QUADS (65536 / 4)
 
+/* Index buffer shared by everything drawing quads. Indices are
+ * 16 bit as long as that suffices, and switch to 32 bit once more
+ * quads are requested (eg. by very large tilemaps), so that those
+ * can still be drawn with a single call. Always use 'type' and
+ * 'quadOffset()' when drawing from it */
 struct GlobalIBO
 {
 	IBO::ID ibo;
-	std::vector<index_t> buffer;
+	GLenum type;
+	size_t quadCount;
 
 	GlobalIBO()
+	    : type(GL_UNSIGNED_SHORT),
+	      quadCount(0)
 	{
 		ibo = IBO::gen();
 	}
@@ -48,27 +55,65 @@ struct GlobalIBO
 		IBO::del(ibo);
 	}
 
-	void ensureSize(size_t quadCount)
+	size_t indexSize() const
 	{
-		assert(quadCount*6 < INDEX_T_MAX);
+		return type == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+	}
+
+	/* Byte offset of the indices for quad 'quad' */
+	GLvoid *quadOffset(size_t quad) const
+	{
+		return (GLvoid*) (quad * 6 * indexSize());
+	}
 
-		if (buffer.size() >= quadCount*6)
+	void ensureSize(size_t quadCount)
+	{
+		if (quadCount <= this->quadCount)
 			return;
 
-		size_t startInd = buffer.size() / 6;
-		buffer.reserve(quadCount*6);
+		/* Grow geometrically to avoid reuploading for every
+		 * slightly larger request, but don't leave the 16 bit
+		 * range just for that */
+		size_t newCount = std::max(quadCount, this->quadCount * 2);
+
+		if (quadCount <= IBO_MAX_SHORT_QUADS)
+			newCount = std::min<size_t>(newCount, IBO_MAX_SHORT_QUADS);
 
-		for (size_t i = startInd; i < quadCount; ++i)
+		if (newCount > IBO_MAX_SHORT_QUADS && type != GL_UNSIGNED_INT)
 		{
-			static const index_t indTemp[] = { 0, 1, 2, 2, 3, 0 };
+			if (!gl.index_uint)
+				throw Exception(Exception::MKXPError,
+				                "Cannot draw more than %d quads at once "
+				                "(32 bit indices unsupported)", IBO_MAX_SHORT_QUADS);
 
-			for (size_t j = 0; j < 6; ++j)
-				buffer.push_back(i * 4 + indTemp[j]);
+			type = GL_UNSIGNED_INT;
 		}
 
 		IBO::bind(ibo);
-		IBO::uploadData(buffer.size() * sizeof(index_t), dataPtr(buffer));
+
+		if (type == GL_UNSIGNED_INT)
+			upload<uint32_t>(newCount);
+		else
+			upload<uint16_t>(newCount);
+
 		IBO::unbind();
+
+		this->quadCount = newCount;
+	}
+
+private:
+	template<typename T>
+	static void upload(size_t quadCount)
+	{
+		static const T indTemp[] = { 0, 1, 2, 2, 3, 0 };
+
+		std::vector<T> buffer(quadCount * 6);
+
+		for (size_t i = 0; i < quadCount; ++i)
+			for (size_t j = 0; j < 6; ++j)
+				buffer[i*6+j] = i * 4 + indTemp[j];
+
+		IBO::uploadData(buffer.size() * sizeof(T), dataPtr(buffer));
 	}
 };
 
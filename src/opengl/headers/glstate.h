@@ -23,18 +23,25 @@
 #define GLSTATE_H
 
 #include "etc.h"
+#include "gl-util.h"
 
-#include <stack>
 #include <assert.h>
 
+/* Maximum nesting depth of push() */
+#define GLPROPERTY_STACK_MAX 16
+
 struct Config;
 
 template<typename T>
 struct GLProperty
 {
+	GLProperty()
+	    : stackSize(0)
+	{}
+
 	~GLProperty()
 	{
-		assert(stack.size() == 0);
+		assert(stackSize == 0);
 	}
 
 	void init(const T &value)
@@ -43,14 +50,30 @@ struct GLProperty
 		apply(value);
 	}
 
-	void push() { stack.push(current); }
-	void pop()  { if (!stack.empty()) { set(stack.top()); stack.pop(); } }
+	/* Records 'value' as current without applying it,
+	 * for state whose initial value is already known */
+	void assume(const T &value)
+	{
+		current = value;
+	}
+
+	void push()
+	{
+		assert(stackSize < GLPROPERTY_STACK_MAX);
+		stack[stackSize++] = current;
+	}
+
+	void pop()  { if (stackSize > 0) set(stack[--stackSize]); }
 	const T &get()    { return current; }
 	void set(const T &value)
 	{
 		if (value == current)
+		{
+			++glCallStats.skipped;
 			return;
+		}
 
+		++glCallStats.issued;
 		init(value);
 	}
 
@@ -68,7 +91,8 @@ private:
 	virtual void apply(const T &value) = 0;
 
 	T current;
-	std::stack<T> stack;
+	T stack[GLPROPERTY_STACK_MAX];
+	size_t stackSize;
 };
 
 
@@ -0,0 +1,91 @@
+/*
+** programcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include "gl-fun.h"
+#include "boost-hash.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct Config;
+
+/* Keeps linked shader programs on disk (in the common data
+ * directory) as driver specific binaries, so they don't have to
+ * be compiled again on the next launch. The whole file is thrown
+ * away when the GL vendor, renderer or version string changes;
+ * single programs are keyed by a hash of their sources.
+ *
+ * Only active while the shaders are being built: Shader::init()
+ * consults 'ProgramCache::current', and 'finish()' writes back
+ * any newly linked programs and frees the binaries */
+class ProgramCache
+{
+public:
+	ProgramCache(const Config &conf);
+	~ProgramCache();
+
+	/* Tries to load the program stored under 'key' into
+	 * 'program'. Returns false if there is none, or if
+	 * the driver rejected it (the program needs to be
+	 * compiled and linked as usual then) */
+	bool load(uint64_t key, GLuint program);
+
+	/* Stores the linked 'program' under 'key' */
+	void store(uint64_t key, GLuint program);
+
+	/* Sets the hint making a program's binary retrievable
+	 * later on; must be called before linking */
+	void prepareLink(GLuint program);
+
+	void finish();
+
+	static ProgramCache *current;
+
+	/* Incremental FNV-1a */
+	static uint64_t hash(const void *data, size_t size,
+	                     uint64_t seed = 0xcbf29ce484222325ull);
+
+private:
+	struct Binary
+	{
+		GLenum format;
+		std::vector<uint8_t> data;
+	};
+
+	void read();
+	void write();
+
+	bool enabled;
+	bool dirty;
+
+	std::string path;
+	std::string driver;
+
+	BoostHash<uint64_t, Binary> binaries;
+
+	unsigned hits, misses;
+};
+
+#endif // PROGRAMCACHE_H
@@ -27,15 +27,18 @@
 #include "gl-meta.h"
 #include "sharedstate.h"
 #include "global-ibo.h"
+#include "streambuffer.h"
 #include "shader.h"
 
 struct Quad
 {
 	Vertex vert[4];
-	VBO::ID vbo;
 	GLMeta::VAO vao;
 	bool vboDirty;
 
+	/* Where 'vert' currently lives in the stream buffer */
+	StreamBuffer::Allocation alloc;
+
 	template<typename V>
 	static void setPosRect(V *vert, const FloatRect &r)
 	{
@@ -73,16 +76,13 @@ struct Quad
 	}
 
 	Quad()
-	    : vbo(VBO::gen()),
-	      vboDirty(true)
+	    : vboDirty(true)
 	{
 		GLMeta::vaoFillInVertexData<Vertex>(vao);
-		vao.vbo = vbo;
+		vao.vbo = shState->streamBuffer().vbo;
 		vao.ibo = shState->globalIBO().ibo;
 
-		GLMeta::vaoInit(vao, true);
-		VBO::allocEmpty(sizeof(Vertex[4]), GL_DYNAMIC_DRAW);
-		GLMeta::vaoUnbind(vao);
+		GLMeta::vaoInit(vao);
 
 		setColor(Vec4(1, 1, 1, 1));
 	}
@@ -90,14 +90,11 @@ struct Quad
 	~Quad()
 	{
 		GLMeta::vaoFini(vao);
-		VBO::del(vbo);
 	}
 
 	void updateBuffer()
 	{
-		VBO::bind(vbo);
-		VBO::uploadSubData(0, sizeof(Vertex[4]), vert);
-		VBO::unbind();
+		alloc = shState->streamBuffer().upload(vert, 1, sizeof(vert));
 	}
 
 	void setPosRect(const FloatRect &r)
@@ -128,14 +125,19 @@ struct Quad
 
 	void draw()
 	{
-		if (vboDirty)
+		if (vboDirty || !shState->streamBuffer().isValid(alloc))
 		{
 			updateBuffer();
 			vboDirty = false;
 		}
 
+		shState->streamBuffer().markDrawn(alloc);
+
 		GLMeta::vaoBind(vao);
-		gl.DrawElements(GL_TRIANGLES, 6, _GL_INDEX_TYPE, 0);
+
+		GlobalIBO &ibo = shState->globalIBO();
+		gl.DrawElements(GL_TRIANGLES, 6, ibo.type, ibo.quadOffset(alloc.firstQuad));
+
 		GLMeta::vaoUnbind(vao);
 	}
 };
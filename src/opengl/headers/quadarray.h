@@ -27,30 +27,39 @@
 #include "gl-meta.h"
 #include "sharedstate.h"
 #include "global-ibo.h"
+#include "streambuffer.h"
 #include "shader.h"
 
 #include <vector>
 #include <stdint.h>
 
+/* Quads are streamed through the shared StreamBuffer; only
+ * arrays too large for it get a VBO of their own */
 template<class VertexType>
 struct QuadArray
 {
 	std::vector<VertexType> vertices;
 
+	/* Own VBO, created on demand */
 	VBO::ID vbo;
 	GLMeta::VAO vao;
 
 	size_t quadCount;
 	GLsizeiptr vboSize;
 
+	bool dirty;
+	bool ownVBO;
+	StreamBuffer::Allocation alloc;
+
 	QuadArray()
-	    : quadCount(0),
-	      vboSize(-1)
+	    : vbo(0),
+	      quadCount(0),
+	      vboSize(-1),
+	      dirty(false),
+	      ownVBO(false)
 	{
-		vbo = VBO::gen();
-
 		GLMeta::vaoFillInVertexData<VertexType>(vao);
-		vao.vbo = vbo;
+		vao.vbo = shState->streamBuffer().vbo;
 		vao.ibo = shState->globalIBO().ibo;
 
 		GLMeta::vaoInit(vao);
@@ -59,7 +68,9 @@ struct QuadArray
 	~QuadArray()
 	{
 		GLMeta::vaoFini(vao);
-		VBO::del(vbo);
+
+		if (vbo != VBO::ID(0))
+			VBO::del(vbo);
 	}
 
 	void resize(size_t size)
@@ -75,12 +86,26 @@ struct QuadArray
 	}
 
 	/* This needs to be called after the final 'append()' call
-	 * and previous to the first 'draw()' call. */
+	 * and previous to the first 'draw()' call. The upload
+	 * itself is deferred until the array is drawn */
 	void commit()
 	{
-		VBO::bind(vbo);
-
 		GLsizeiptr size = vertices.size() * sizeof(VertexType);
+		ownVBO = (size_t) size > shState->streamBuffer().maxSize();
+
+		if (!ownVBO)
+		{
+			vao.vbo = shState->streamBuffer().vbo;
+			dirty = true;
+
+			return;
+		}
+
+		if (vbo == VBO::ID(0))
+			vbo = VBO::gen();
+
+		vao.vbo = vbo;
+		VBO::bind(vbo);
 
 		if (size > vboSize)
 		{
@@ -102,10 +127,27 @@ struct QuadArray
 
 	void draw(size_t offset, size_t count)
 	{
+		if (count == 0)
+			return;
+
+		StreamBuffer &stream = shState->streamBuffer();
+
+		if (!ownVBO)
+		{
+			if (dirty || !stream.isValid(alloc))
+			{
+				alloc = stream.upload(dataPtr(vertices), quadCount, sizeof(VertexType) * 4);
+				dirty = false;
+			}
+
+			offset += alloc.firstQuad;
+			stream.markDrawn(alloc);
+		}
+
 		GLMeta::vaoBind(vao);
 
-		const char *_offset = (const char*) 0 + offset * 6 * sizeof(index_t);
-		gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, _offset);
+		GlobalIBO &ibo = shState->globalIBO();
+		gl.DrawElements(GL_TRIANGLES, count * 6, ibo.type, ibo.quadOffset(offset));
 
 		GLMeta::vaoUnbind(vao);
 	}
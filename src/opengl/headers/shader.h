@@ -26,6 +26,65 @@
 #include "gl-util.h"
 #include "glstate.h"
 
+#include <string.h>
+
+/* Comparable 4x4 matrix for 'GLUniform' */
+struct UniformMat4
+{
+	float m[16];
+
+	bool operator==(const UniformMat4 &o) const
+	{
+		return memcmp(m, o.m, sizeof(m)) == 0;
+	}
+};
+
+static inline void uploadUniform(GLint loc, float value)
+{
+	gl.Uniform1f(loc, value);
+}
+
+static inline void uploadUniform(GLint loc, const Vec2 &value)
+{
+	gl.Uniform2f(loc, value.x, value.y);
+}
+
+static inline void uploadUniform(GLint loc, const Vec4 &value)
+{
+	gl.Uniform4f(loc, value.x, value.y, value.z, value.w);
+}
+
+static inline void uploadUniform(GLint loc, const UniformMat4 &value)
+{
+	gl.UniformMatrix4fv(loc, 1, GL_FALSE, value.m);
+}
+
+/* A uniform of one program, shadowed so that setting its current
+ * value again doesn't reach the driver. Like any uniform setter,
+ * only to be used while the owning program is bound */
+template<typename T>
+struct GLUniform : public GLProperty<T>
+{
+	GLint loc;
+
+	GLUniform()
+	    : loc(-1)
+	{}
+
+	/* Uniforms start out zeroed after linking */
+	void locate(GLuint program, const char *name)
+	{
+		loc = gl.GetUniformLocation(program, name);
+		this->assume(T());
+	}
+
+private:
+	void apply(const T &value)
+	{
+		uploadUniform(loc, value);
+	}
+};
+
 class Shader
 {
 public:
@@ -53,6 +112,7 @@ protected:
 	static void setVec4Uniform(GLint location, const Vec4 &vec);
 	static void setVec2Uniform(GLint location, const Vec2i &vec);
 	static void setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture);
+	static void setMat4Uniform(GLUniform<UniformMat4> &uniform, const float value[16]);
 
 	GLuint vertShader, fragShader;
 	GLuint program;
@@ -85,7 +145,7 @@ public:
 protected:
 	void init();
 
-	GLint u_texSizeInv, u_translation;
+	GLUniform<Vec2> u_texSizeInv, u_translation;
 };
 
 class FlatColorShader : public ShaderBase
@@ -130,7 +190,7 @@ public:
 	void setSpriteMat(const float value[16]);
 
 private:
-	GLint u_spriteMat;
+	GLUniform<UniformMat4> u_spriteMat;
 };
 
 class AlphaSpriteShader : public ShaderBase
@@ -142,7 +202,8 @@ public:
 	void setAlpha(float value);
 
 private:
-	GLint u_spriteMat, u_alpha;
+	GLUniform<UniformMat4> u_spriteMat;
+	GLUniform<float> u_alpha;
 };
 
 class TransShader : public ShaderBase
@@ -186,10 +247,31 @@ public:
 	void setBushOpacity(float value);
 
 private:
-	GLint u_spriteMat, u_tone, u_opacity, u_color, u_bushDepth, u_bushOpacity;
+	GLUniform<UniformMat4> u_spriteMat;
+	GLUniform<Vec4> u_tone, u_color;
+	GLUniform<float> u_opacity, u_bushDepth, u_bushOpacity;
+};
+
+/* Shared by shaders drawing a plane as one quad, with
+ * the source rect repeated (wrapped) in the fragment shader.
+ * Vertex texture coordinates are plane pixel positions */
+class PlaneShaderBase : public ShaderBase
+{
+public:
+	/* Repeated part of the bitmap */
+	void setSrcRect(const FloatRect &value);
+	/* Scroll offset (wrapped by 'tileSize') and size of
+	 * the zoomed source rect, in screen pixels */
+	void setOffset(const Vec2 &value);
+	void setTileSize(const Vec2 &value);
+
+protected:
+	void init();
+
+	GLint u_srcRect, u_offset, u_tileSizeInv;
 };
 
-class PlaneShader : public ShaderBase
+class PlaneShader : public PlaneShaderBase
 {
 public:
 	PlaneShader();
@@ -200,7 +282,8 @@ public:
 	void setOpacity(float value);
 
 private:
-	GLint u_tone, u_color, u_flash, u_opacity;
+	GLUniform<Vec4> u_tone, u_color, u_flash;
+	GLUniform<float> u_opacity;
 };
 
 class GrayShader : public ShaderBase
@@ -382,16 +465,19 @@ private:
 	GLint u_iTime;
 };
 
-class WaterShader : public ShaderBase
+class WaterShader : public PlaneShaderBase
 {
 public:
 	WaterShader();
 
 	void setiTime(const float value);
 	void setOpacity(const float opacity);
+	/* Repeat the source rect when distortion moves past
+	 * its edges, instead of clamping */
+	void setWrapEdges(bool value);
 
 private:
-	GLint u_iTime, u_opacity;
+	GLint u_iTime, u_opacity, u_wrapEdges;
 };
 
 class BinaryShader : public ShaderBase
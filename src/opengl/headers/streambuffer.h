@@ -0,0 +1,127 @@
+/*
+** streambuffer.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "gl-util.h"
+
+#include <stdint.h>
+
+/* Number of segments the ring is split into */
+#define STREAM_SEGMENTS 4
+
+/* Vertex ring buffer that dynamic geometry (Quad, QuadArray) is
+ * streamed through, instead of every one of them owning a VBO that
+ * gets overwritten while earlier draws may still be reading it.
+ *
+ * The ring is split into segments; a new one is started every frame,
+ * and whenever the current one is full. With ARB_buffer_storage the
+ * buffer stays persistently mapped, and a fence guards each segment
+ * until the GPU is done with it. Otherwise data is uploaded with
+ * glBufferSubData, and the buffer is orphaned each time the ring
+ * wraps around.
+ *
+ * Uploaded data only lives until its segment is reused, so users keep
+ * a CPU side copy and upload again once 'isValid()' fails. Data may be
+ * drawn again in later frames while it stays valid; every draw has to
+ * be reported with 'markDrawn()', so that reusing the segment waits for
+ * a fence placed after the last draw reading from it. Uploads are
+ * aligned to whole quads, so they can be drawn with the global IBO
+ * starting at 'firstQuad', and the attribute pointers (set up once,
+ * relative to the start of the buffer) never need to change */
+struct StreamBuffer
+{
+	struct Allocation
+	{
+		size_t firstQuad;
+		size_t segment;
+
+		/* Segment use this was made in; 0 is never valid */
+		uint32_t use;
+
+		Allocation()
+		    : firstQuad(0), segment(0), use(0)
+		{}
+	};
+
+	VBO::ID vbo;
+
+	StreamBuffer();
+	~StreamBuffer();
+
+	/* Largest upload that fits, bigger data
+	 * needs to go into its own VBO */
+	size_t maxSize() const
+	{
+		return segmentSize;
+	}
+
+	/* Uploads 'quadCount' quads of 'quadSize' bytes each,
+	 * and makes sure the global IBO covers them */
+	Allocation upload(const void *data, size_t quadCount, size_t quadSize);
+
+	bool isValid(const Allocation &alloc) const
+	{
+		return alloc.use == segmentUse[alloc.segment];
+	}
+
+	/* To be called for every draw call reading 'alloc' */
+	void markDrawn(const Allocation &alloc)
+	{
+		lastDraw[alloc.segment] = fenceCount;
+	}
+
+	/* Starts a new segment if the current one was used;
+	 * to be called once per frame after presenting */
+	void endFrame();
+
+private:
+	void nextSegment();
+	void waitForDraws(size_t segment);
+
+	size_t size;
+	size_t segmentSize;
+
+	size_t segment;
+	size_t cursor;
+
+	uint32_t segmentUse[STREAM_SEGMENTS];
+
+	/* Fence placed when last moving off each segment; it covers
+	 * all commands issued up to then, including draws reading
+	 * older segments. Serials count fences created so far */
+	_GLsync fences[STREAM_SEGMENTS];
+	uint64_t fenceSerial[STREAM_SEGMENTS];
+	uint64_t fenceCount;
+
+	/* 'fenceCount' at the last draw reading each segment; any
+	 * fence with a greater serial is placed after that draw */
+	uint64_t lastDraw[STREAM_SEGMENTS];
+
+	/* Serial of the newest fence known to have signaled */
+	uint64_t completedSerial;
+
+	/* Null when not persistently mapped */
+	uint8_t *mapped;
+};
+
+#endif // STREAMBUFFER_H
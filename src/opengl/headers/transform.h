@@ -51,6 +51,7 @@
 
 #include <math.h>
 #include <string.h>
+#include <algorithm>
 
 class Transform
 {
@@ -122,6 +123,47 @@ public:
 		return matrix;
 	}
 
+	/* Axis aligned bounding box (in global coordinates) of
+	 * a local rectangle after it has been transformed */
+	IntRect getBoundingRect(const FloatRect &rect)
+	{
+		const float *m = getMatrix();
+
+		const Vec2 corners[] =
+		{
+			rect.topLeft(), rect.topRight(),
+			rect.bottomLeft(), rect.bottomRight()
+		};
+
+		float minX, minY, maxX, maxY;
+
+		for (size_t i = 0; i < 4; ++i)
+		{
+			float x = m[0] * corners[i].x + m[4] * corners[i].y + m[12];
+			float y = m[1] * corners[i].x + m[5] * corners[i].y + m[13];
+
+			if (i == 0)
+			{
+				minX = maxX = x;
+				minY = maxY = y;
+				continue;
+			}
+
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+		}
+
+		IntRect result;
+		result.x = floorf(minX);
+		result.y = floorf(minY);
+		result.w = (int) ceilf(maxX) - result.x;
+		result.h = (int) ceilf(maxY) - result.y;
+
+		return result;
+	}
+
 private:
 	void updateMatrix()
 	{
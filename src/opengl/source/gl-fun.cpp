@@ -163,6 +163,38 @@ void initGLFunctions()
 		GL_VAO_FUN;
 	}
 
+	/* Sync object entrypoints */
+	if (HAVE_EXT(ARB_sync) || (gles && glMajor >= 3))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_SYNC_FUN;
+	}
+
+	/* Buffer storage entrypoints (persistent mapping
+	 * is only useful together with fences) */
+	if (!gles && HAVE_EXT(ARB_buffer_storage) && gl.FenceSync)
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_BUFFER_STORAGE_FUN;
+	}
+
+	/* Program binary entrypoints */
+	if (HAVE_EXT(ARB_get_program_binary) || (gles && glMajor >= 3))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+		GL_PROGRAM_BINARY_FUN;
+		GL_PROGRAM_PARAMETER_FUN;
+	}
+	else if (HAVE_EXT(OES_get_program_binary))
+	{
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "OES"
+		GL_PROGRAM_BINARY_FUN;
+	}
+
 	/* Debug callback entrypoints */
 	if (HAVE_EXT(KHR_debug))
 	{
@@ -190,4 +222,7 @@ void initGLFunctions()
 
 	if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
 		gl.npot_repeat = true;
+
+	if (!gles || glMajor >= 3 || HAVE_EXT(OES_element_index_uint))
+		gl.index_uint = true;
 }
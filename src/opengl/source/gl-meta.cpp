@@ -69,16 +69,52 @@ void subRectImageEnd()
 
 static void vaoBindRes(VAO &vao)
 {
-	VBO::bind(vao.vbo);
+	/* The element array binding isn't part of the emulated
+	 * state, so it might have been changed in the meantime */
 	IBO::bind(vao.ibo);
 
+	if (glBindings.vaoVBO == vao.vbo.gl && glBindings.vaoAttr == vao.attr)
+	{
+		++glCallStats.skipped;
+		return;
+	}
+
+	VBO::bind(vao.vbo);
+
+	unsigned attrMask = 0;
+
 	for (size_t i = 0; i < vao.attrCount; ++i)
 	{
 		const VertexAttribute &va = vao.attr[i];
 
-		gl.EnableVertexAttribArray(va.index);
+		if (!(glBindings.attrMask & (1 << va.index)))
+			gl.EnableVertexAttribArray(va.index);
+
 		gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize, va.offset);
+		attrMask |= 1 << va.index;
 	}
+
+	/* Arrays of the previous layout this one doesn't use */
+	for (GLuint i = 0; (glBindings.attrMask & ~attrMask) >> i; ++i)
+		if ((glBindings.attrMask & ~attrMask) & (1 << i))
+			gl.DisableVertexAttribArray(i);
+
+	glBindings.attrMask = attrMask;
+	glBindings.vaoVBO = vao.vbo.gl;
+	glBindings.vaoAttr = vao.attr;
+	++glCallStats.issued;
+}
+
+static void nativeVAOBind(GLuint vao, GLuint ibo)
+{
+	if (!glBindNeeded(glBindings.vao, vao))
+		return;
+
+	gl.BindVertexArray(vao);
+
+	/* The element array binding is part of VAO state; the
+	 * default VAO's one isn't tracked, force a rebind */
+	glBindings.ibo = vao ? ibo : (GLuint) -1;
 }
 
 void vaoInit(VAO &vao, bool keepBound)
@@ -86,10 +122,20 @@ void vaoInit(VAO &vao, bool keepBound)
 	if (HAVE_NATIVE_VAO)
 	{
 		gl.GenVertexArrays(1, &vao.nativeVAO);
-		gl.BindVertexArray(vao.nativeVAO);
-		vaoBindRes(vao);
+		nativeVAOBind(vao.nativeVAO, 0);
+		VBO::bind(vao.vbo);
+		IBO::bind(vao.ibo);
+
+		for (size_t i = 0; i < vao.attrCount; ++i)
+		{
+			const VertexAttribute &va = vao.attr[i];
+
+			gl.EnableVertexAttribArray(va.index);
+			gl.VertexAttribPointer(va.index, va.size, va.type, GL_FALSE, vao.vertSize, va.offset);
+		}
+
 		if (!keepBound)
-			gl.BindVertexArray(0);
+			nativeVAOBind(0, 0);
 	}
 	else
 	{
@@ -104,31 +150,29 @@ void vaoInit(VAO &vao, bool keepBound)
 void vaoFini(VAO &vao)
 {
 	if (HAVE_NATIVE_VAO)
+	{
+		if (glBindings.vao == vao.nativeVAO)
+			glBindings.vao = 0;
+
 		gl.DeleteVertexArrays(1, &vao.nativeVAO);
+	}
 }
 
 void vaoBind(VAO &vao)
 {
 	if (HAVE_NATIVE_VAO)
-		gl.BindVertexArray(vao.nativeVAO);
+		nativeVAOBind(vao.nativeVAO, vao.ibo.gl);
 	else
 		vaoBindRes(vao);
 }
 
-void vaoUnbind(VAO &vao)
+void vaoUnbind(VAO &)
 {
+	/* Unbinding a native VAO keeps later element array
+	 * binds from modifying it. The emulated one's arrays are
+	 * left set up, so drawing it again right away is free */
 	if (HAVE_NATIVE_VAO)
-	{
-		gl.BindVertexArray(0);
-	}
-	else
-	{
-		for (size_t i = 0; i < vao.attrCount; ++i)
-			gl.DisableVertexAttribArray(vao.attr[i].index);
-
-		VBO::unbind();
-		IBO::unbind();
-	}
+		nativeVAOBind(0, 0);
 }
 
 #define HAVE_NATIVE_BLIT false //gl.BlitFramebuffer
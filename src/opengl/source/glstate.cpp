@@ -27,6 +27,9 @@
 
 #include <SDL2/SDL_rect.h>
 
+GLCallStats glCallStats;
+GLBindings glBindings;
+
 static void applyBool(GLenum state, bool mode)
 {
 	mode ? gl.Enable(state) : gl.Disable(state);
@@ -0,0 +1,290 @@
+/*
+** programcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "programcache.h"
+
+#include "config.h"
+#include "debugwriter.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CACHE_FILE "shaders.cache"
+#define CACHE_MAGIC "MKXPPRGC"
+#define CACHE_VERSION 1
+
+/* Sanity limits when reading */
+#define MAX_DRIVER_LEN 1024
+#define MAX_PROGRAMS 256
+#define MAX_BINARY_SIZE (16 * 1024 * 1024)
+
+ProgramCache *ProgramCache::current = 0;
+
+static std::string glString(GLenum name)
+{
+	const char *str = (const char*) gl.GetString(name);
+
+	return str ? str : "";
+}
+
+ProgramCache::ProgramCache(const Config &conf)
+    : enabled(false),
+      dirty(false),
+      hits(0),
+      misses(0)
+{
+	current = this;
+
+	if (!conf.shaderCache || conf.commonDataPath.empty())
+		return;
+
+	if (!gl.GetProgramBinary || !gl.ProgramBinary)
+		return;
+
+	/* Some drivers expose the entrypoints, but no formats */
+	GLint formats = 0;
+	gl.GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	if (formats <= 0)
+		return;
+
+	enabled = true;
+	path = conf.commonDataPath + CACHE_FILE;
+	driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+	read();
+}
+
+ProgramCache::~ProgramCache()
+{
+	if (current == this)
+		current = 0;
+}
+
+uint64_t ProgramCache::hash(const void *data, size_t size, uint64_t seed)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	uint64_t h = seed;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		h ^= bytes[i];
+		h *= 0x100000001b3ull;
+	}
+
+	return h;
+}
+
+bool ProgramCache::load(uint64_t key, GLuint program)
+{
+	if (!enabled)
+		return false;
+
+	if (!binaries.contains(key))
+	{
+		++misses;
+		return false;
+	}
+
+	const Binary &bin = binaries[key];
+	gl.ProgramBinary(program, bin.format, dataPtr(bin.data), bin.data.size());
+
+	GLint success;
+	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (!success)
+	{
+		/* Driver update with unchanged version string, or
+		 * a corrupted file; replaced once relinked */
+		++misses;
+		return false;
+	}
+
+	++hits;
+
+	return true;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program)
+{
+	if (!enabled)
+		return;
+
+	GLint size = 0;
+	gl.GetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+
+	if (size <= 0 || size > MAX_BINARY_SIZE)
+		return;
+
+	Binary &bin = binaries[key];
+	bin.data.resize(size);
+
+	GLsizei length = 0;
+	gl.GetProgramBinary(program, size, &length, &bin.format, dataPtr(bin.data));
+	bin.data.resize(length);
+
+	if (length == 0)
+	{
+		binaries.remove(key);
+		return;
+	}
+
+	dirty = true;
+}
+
+void ProgramCache::prepareLink(GLuint program)
+{
+	if (enabled && gl.ProgramParameteri)
+		gl.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::finish()
+{
+	if (enabled)
+	{
+		Debug() << "Shader cache:" << hits << "programs loaded," << misses << "compiled";
+
+		if (dirty)
+			write();
+	}
+
+	enabled = false;
+	binaries = BoostHash<uint64_t, Binary>();
+
+	if (current == this)
+		current = 0;
+}
+
+void ProgramCache::read()
+{
+	FILE *f = fopen(path.c_str(), "rb");
+
+	if (!f)
+		return;
+
+	char magic[sizeof(CACHE_MAGIC)-1];
+	uint32_t version, driverLen, count;
+	bool valid = false;
+
+	do
+	{
+		if (fread(magic, sizeof(magic), 1, f) < 1 || memcmp(magic, CACHE_MAGIC, sizeof(magic)))
+			break;
+
+		if (fread(&version, sizeof(version), 1, f) < 1 || version != CACHE_VERSION)
+			break;
+
+		if (fread(&driverLen, sizeof(driverLen), 1, f) < 1 || driverLen > MAX_DRIVER_LEN)
+			break;
+
+		std::string fileDriver(driverLen, '\0');
+
+		if (driverLen > 0 && fread(&fileDriver[0], driverLen, 1, f) < 1)
+			break;
+
+		/* Binaries from another driver are useless */
+		if (fileDriver != driver)
+			break;
+
+		if (fread(&count, sizeof(count), 1, f) < 1 || count > MAX_PROGRAMS)
+			break;
+
+		uint32_t i;
+
+		for (i = 0; i < count; ++i)
+		{
+			uint64_t key;
+			uint32_t format, size;
+
+			if (fread(&key, sizeof(key), 1, f) < 1 ||
+			    fread(&format, sizeof(format), 1, f) < 1 ||
+			    fread(&size, sizeof(size), 1, f) < 1)
+				break;
+
+			if (size == 0 || size > MAX_BINARY_SIZE)
+				break;
+
+			Binary &bin = binaries[key];
+			bin.format = format;
+			bin.data.resize(size);
+
+			if (fread(&bin.data[0], size, 1, f) < 1)
+				break;
+		}
+
+		valid = (i == count);
+	}
+	while (false);
+
+	fclose(f);
+
+	if (!valid)
+	{
+		/* Rewritten from scratch on finish */
+		binaries = BoostHash<uint64_t, Binary>();
+		dirty = true;
+	}
+}
+
+void ProgramCache::write()
+{
+	FILE *f = fopen(path.c_str(), "wb");
+
+	if (!f)
+	{
+		Debug() << "Shader cache: Unable to write" << path;
+		return;
+	}
+
+	uint32_t version = CACHE_VERSION;
+	uint32_t driverLen = driver.size();
+	uint32_t count = 0;
+
+	for (BoostHash<uint64_t, Binary>::const_iterator iter = binaries.cbegin();
+	     iter != binaries.cend(); ++iter)
+		++count;
+
+	bool ok = fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC)-1, 1, f) == 1 &&
+	          fwrite(&version, sizeof(version), 1, f) == 1 &&
+	          fwrite(&driverLen, sizeof(driverLen), 1, f) == 1 &&
+	          fwrite(driver.c_str(), driverLen, 1, f) == 1 &&
+	          fwrite(&count, sizeof(count), 1, f) == 1;
+
+	for (BoostHash<uint64_t, Binary>::const_iterator iter = binaries.cbegin();
+	     ok && iter != binaries.cend(); ++iter)
+	{
+		uint64_t key = iter->first;
+		uint32_t format = iter->second.format;
+		uint32_t size = iter->second.data.size();
+
+		ok = fwrite(&key, sizeof(key), 1, f) == 1 &&
+		     fwrite(&format, sizeof(format), 1, f) == 1 &&
+		     fwrite(&size, sizeof(size), 1, f) == 1 &&
+		     fwrite(&iter->second.data[0], size, 1, f) == 1;
+	}
+
+	fclose(f);
+
+	/* Don't leave a truncated file behind */
+	if (!ok)
+		remove(path.c_str());
+}
@@ -22,6 +22,7 @@
 #include "shader.h"
 #include "sharedstate.h"
 #include "glstate.h"
+#include "programcache.h"
 #include "exception.h"
 
 #include <assert.h>
@@ -47,6 +48,7 @@
 #include "simpleColor.vert.xxd"
 #include "sprite.vert.xxd"
 #include "tilemap.vert.xxd"
+#include "plane.vert.xxd"
 #include "blur.frag.xxd"
 #include "simpleMatrix.vert.xxd"
 #include "blurH.vert.xxd"
@@ -70,6 +72,7 @@
 }
 
 #define GET_U(name) u_##name = gl.GetUniformLocation(program, #name)
+#define GET_SHADOWED_U(name) u_##name.locate(program, #name)
 
 static void printShaderLog(GLuint shader)
 {
@@ -116,7 +119,7 @@ void Shader::bind()
 
 void Shader::unbind()
 {
-	gl.ActiveTexture(GL_TEXTURE0);
+	TEX::setActiveUnit(0);
 	glState.program.set(0);
 }
 
@@ -155,6 +158,19 @@ static void setupShaderSource(GLuint shader, GLenum type,
 	gl.ShaderSource(shader, i, shaderSrc, shaderSrcSize);
 }
 
+/* Identifies the program built from these sources
+ * in the program binary cache */
+static uint64_t programKey(const unsigned char *vert, int vertSize,
+                           const unsigned char *frag, int fragSize)
+{
+	uint64_t key = ProgramCache::hash(&gl.glsles, sizeof(gl.glsles));
+	key = ProgramCache::hash(___shader_common_h, ___shader_common_h_len, key);
+	key = ProgramCache::hash(&vertSize, sizeof(vertSize), key);
+	key = ProgramCache::hash(vert, vertSize, key);
+
+	return ProgramCache::hash(frag, fragSize, key);
+}
+
 void Shader::init(const unsigned char *vert, int vertSize,
                   const unsigned char *frag, int fragSize,
                   const char *vertName, const char *fragName,
@@ -162,6 +178,17 @@ void Shader::init(const unsigned char *vert, int vertSize,
 {
 	GLint success;
 
+	ProgramCache *cache = ProgramCache::current;
+	uint64_t key = 0;
+
+	if (cache)
+	{
+		key = programKey(vert, vertSize, frag, fragSize);
+
+		if (cache->load(key, program))
+			return;
+	}
+
 	/* Compile vertex shader */
 	setupShaderSource(vertShader, GL_VERTEX_SHADER, vert, vertSize);
 	gl.CompileShader(vertShader);
@@ -198,6 +225,9 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	gl.BindAttribLocation(program, TexCoord, "texCoord");
 	gl.BindAttribLocation(program, Color, "color");
 
+	if (cache)
+		cache->prepareLink(program);
+
 	gl.LinkProgram(program);
 
 	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
@@ -209,6 +239,9 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	                    "GLSL: An error occured while linking program '%s' (vertex '%s', fragment '%s')",
 	                    programName, vertName, fragName);
 	}
+
+	if (cache)
+		cache->store(key, program);
 }
 
 void Shader::initFromFile(const char *_vertFile, const char *_fragFile,
@@ -233,14 +266,19 @@ void Shader::setVec2Uniform(GLint location, const Vec2i &vec)
 	gl.Uniform2f(location, 1.f / vec.x, 1.f / vec.y);
 }
 
-void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+void Shader::setMat4Uniform(GLUniform<UniformMat4> &uniform, const float value[16])
 {
-	GLenum texUnit = GL_TEXTURE0 + unitIndex;
+	UniformMat4 mat;
+	memcpy(mat.m, value, sizeof(mat.m));
 
-	gl.ActiveTexture(texUnit);
-	gl.BindTexture(GL_TEXTURE_2D, texture.gl);
+	uniform.set(mat);
+}
+
+void Shader::setTexUniform(GLint location, unsigned unitIndex, TEX::ID texture)
+{
+	/* Unit 0 is selected again by the next TEX::bind() */
+	TEX::bindUnit(unitIndex, texture);
 	gl.Uniform1i(location, unitIndex);
-	gl.ActiveTexture(GL_TEXTURE0);
 }
 
 void ShaderBase::GLProjMat::apply(const Vec2i &value)
@@ -263,10 +301,11 @@ void ShaderBase::GLProjMat::apply(const Vec2i &value)
 
 void ShaderBase::init()
 {
-	GET_U(texSizeInv);
-	GET_U(translation);
+	GET_SHADOWED_U(texSizeInv);
+	GET_SHADOWED_U(translation);
 
 	projMat.u_mat = gl.GetUniformLocation(program, "projMat");
+	projMat.assume(Vec2i());
 }
 
 void ShaderBase::applyViewportProj()
@@ -277,12 +316,12 @@ void ShaderBase::applyViewportProj()
 
 void ShaderBase::setTexSize(const Vec2i &value)
 {
-	gl.Uniform2f(u_texSizeInv, 1.f / value.x, 1.f / value.y);
+	u_texSizeInv.set(Vec2(1.f / value.x, 1.f / value.y));
 }
 
 void ShaderBase::setTranslation(const Vec2i &value)
 {
-	gl.Uniform2f(u_translation, value.x, value.y);
+	u_translation.set(Vec2(value.x, value.y));
 }
 
 
@@ -338,12 +377,12 @@ SimpleSpriteShader::SimpleSpriteShader()
 
 	ShaderBase::init();
 
-	GET_U(spriteMat);
+	GET_SHADOWED_U(spriteMat);
 }
 
 void SimpleSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 
@@ -353,18 +392,18 @@ AlphaSpriteShader::AlphaSpriteShader()
 
 	ShaderBase::init();
 
-	GET_U(spriteMat);
-	GET_U(alpha);
+	GET_SHADOWED_U(spriteMat);
+	GET_SHADOWED_U(alpha);
 }
 
 void AlphaSpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void AlphaSpriteShader::setAlpha(float value)
 {
-	gl.Uniform1f(u_alpha, value);
+	u_alpha.set(value);
 }
 
 
@@ -440,75 +479,100 @@ SpriteShader::SpriteShader()
 
 	ShaderBase::init();
 
-	GET_U(spriteMat);
-	GET_U(tone);
-	GET_U(color);
-	GET_U(opacity);
-	GET_U(bushDepth);
-	GET_U(bushOpacity);
+	GET_SHADOWED_U(spriteMat);
+	GET_SHADOWED_U(tone);
+	GET_SHADOWED_U(color);
+	GET_SHADOWED_U(opacity);
+	GET_SHADOWED_U(bushDepth);
+	GET_SHADOWED_U(bushOpacity);
 }
 
 void SpriteShader::setSpriteMat(const float value[16])
 {
-	gl.UniformMatrix4fv(u_spriteMat, 1, GL_FALSE, value);
+	setMat4Uniform(u_spriteMat, value);
 }
 
 void SpriteShader::setTone(const Vec4 &tone)
 {
-	setVec4Uniform(u_tone, tone);
+	u_tone.set(tone);
 }
 
 void SpriteShader::setColor(const Vec4 &color)
 {
-	setVec4Uniform(u_color, color);
+	u_color.set(color);
 }
 
 void SpriteShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	u_opacity.set(value);
 }
 
 void SpriteShader::setBushDepth(float value)
 {
-	gl.Uniform1f(u_bushDepth, value);
+	u_bushDepth.set(value);
 }
 
 void SpriteShader::setBushOpacity(float value)
 {
-	gl.Uniform1f(u_bushOpacity, value);
+	u_bushOpacity.set(value);
+}
+
+
+void PlaneShaderBase::init()
+{
+	ShaderBase::init();
+
+	GET_U(srcRect);
+	GET_U(offset);
+	GET_U(tileSizeInv);
+}
+
+void PlaneShaderBase::setSrcRect(const FloatRect &value)
+{
+	gl.Uniform4f(u_srcRect, value.x, value.y, value.w, value.h);
+}
+
+void PlaneShaderBase::setOffset(const Vec2 &value)
+{
+	gl.Uniform2f(u_offset, value.x, value.y);
+}
+
+void PlaneShaderBase::setTileSize(const Vec2 &value)
+{
+	gl.Uniform2f(u_tileSizeInv, 1.f / value.x, 1.f / value.y);
 }
 
 
 PlaneShader::PlaneShader()
 {
-	INIT_SHADER(simple, plane, PlaneShader);
+	INIT_SHADER(plane, plane, PlaneShader);
 
-	ShaderBase::init();
+	PlaneShaderBase::init();
 
-	GET_U(tone);
-	GET_U(color);
-	GET_U(flash);
-	GET_U(opacity);
+	GET_SHADOWED_U(tone);
+	GET_SHADOWED_U(color);
+	GET_SHADOWED_U(flash);
+	GET_SHADOWED_U(opacity);
 }
 
 void PlaneShader::setTone(const Vec4 &tone)
 {
-	setVec4Uniform(u_tone, tone);
+	u_tone.set(tone);
 }
 
 void PlaneShader::setColor(const Vec4 &color)
 {
-	setVec4Uniform(u_color, color);
+	u_color.set(color);
 }
 
 void PlaneShader::setFlash(const Vec4 &flash)
 {
-	setVec4Uniform(u_flash, flash);
+	u_flash.set(flash);
 }
 
 void PlaneShader::setOpacity(float value)
 {
-	gl.Uniform1f(u_opacity, value);
+	u_opacity.set(value);
 }
 
 
@@ -742,12 +806,13 @@ void CubicShader::setiTime(const float value)
 
 WaterShader::WaterShader()
 {
-	INIT_SHADER(simple, water, WaterShader);
+	INIT_SHADER(plane, water, WaterShader);
 
-	ShaderBase::init();
+	PlaneShaderBase::init();
 
 	GET_U(iTime);
 	GET_U(opacity);
+	GET_U(wrapEdges);
 }
 
 void WaterShader::setiTime(const float value)
@@ -760,6 +825,11 @@ void WaterShader::setOpacity(const float value)
 	gl.Uniform1f(u_opacity, value);
 }
 
+void WaterShader::setWrapEdges(bool value)
+{
+	gl.Uniform1f(u_wrapEdges, value ? 1.f : 0.f);
+}
+
 BinaryShader::BinaryShader()
 {
 	INIT_SHADER(simple, binary_glitch, BinaryShader);
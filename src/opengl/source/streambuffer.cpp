@@ -0,0 +1,210 @@
+/*
+** streambuffer.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streambuffer.h"
+
+#include "sharedstate.h"
+#include "global-ibo.h"
+#include "vertex.h"
+#include "debugwriter.h"
+
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+
+/* Segment sizes are kept a multiple of every vertex
+ * type's quad size, so segments start quad aligned */
+#define QUAD_SIZE_LCM 384
+
+/* Total ring size. Quads of the smallest vertex type must stay
+ * within the 16 bit index range, or drawing from the far end of
+ * the ring would switch the global IBO to 32 bit indices for
+ * everything. Arrays that don't fit a segment get their own VBO */
+#define RING_SIZE (IBO_MAX_SHORT_QUADS * 4 * sizeof(SVertex))
+
+#define WAIT_TIMEOUT 1000000000ull
+
+StreamBuffer::StreamBuffer()
+    : segment(0),
+      cursor(0),
+      fenceCount(0),
+      completedSerial(0),
+      mapped(0)
+{
+	segmentSize = (RING_SIZE / STREAM_SEGMENTS / QUAD_SIZE_LCM) * QUAD_SIZE_LCM;
+	size = segmentSize * STREAM_SEGMENTS;
+
+	for (size_t i = 0; i < STREAM_SEGMENTS; ++i)
+	{
+		segmentUse[i] = 1;
+		fences[i] = 0;
+		fenceSerial[i] = 0;
+		lastDraw[i] = 0;
+	}
+
+	vbo = VBO::gen();
+	VBO::bind(vbo);
+
+	if (gl.BufferStorage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		gl.BufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+		mapped = static_cast<uint8_t*>(gl.MapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+
+		if (!mapped)
+		{
+			/* Storage is immutable now, start over */
+			VBO::del(vbo);
+			vbo = VBO::gen();
+			VBO::bind(vbo);
+		}
+	}
+
+	if (!mapped)
+		VBO::allocEmpty(size, GL_STREAM_DRAW);
+
+	VBO::unbind();
+
+	Debug() << "Vertex streaming:" << (mapped ? "persistent mapping" : "buffer orphaning");
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (size_t i = 0; i < STREAM_SEGMENTS; ++i)
+		if (fences[i])
+			gl.DeleteSync(fences[i]);
+
+	if (mapped)
+	{
+		VBO::bind(vbo);
+		gl.UnmapBuffer(GL_ARRAY_BUFFER);
+		VBO::unbind();
+	}
+
+	VBO::del(vbo);
+}
+
+StreamBuffer::Allocation StreamBuffer::upload(const void *data, size_t quadCount, size_t quadSize)
+{
+	size_t bytes = quadCount * quadSize;
+	assert(bytes <= segmentSize);
+
+	size_t offset = (cursor + quadSize - 1) / quadSize * quadSize;
+
+	if (offset + bytes > (segment + 1) * segmentSize)
+	{
+		nextSegment();
+		offset = cursor;
+	}
+
+	if (mapped)
+	{
+		memcpy(mapped + offset, data, bytes);
+	}
+	else
+	{
+		VBO::bind(vbo);
+		VBO::uploadSubData(offset, bytes, data);
+	}
+
+	cursor = offset + bytes;
+
+	Allocation alloc;
+	alloc.firstQuad = offset / quadSize;
+	alloc.segment = segment;
+	alloc.use = segmentUse[segment];
+
+	shState->ensureQuadIBO(alloc.firstQuad + quadCount);
+
+	return alloc;
+}
+
+void StreamBuffer::endFrame()
+{
+	if (cursor != segment * segmentSize)
+		nextSegment();
+}
+
+void StreamBuffer::nextSegment()
+{
+	if (mapped)
+	{
+		if (fences[segment])
+			gl.DeleteSync(fences[segment]);
+
+		fences[segment] = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		fenceSerial[segment] = ++fenceCount;
+	}
+
+	segment = (segment + 1) % STREAM_SEGMENTS;
+
+	if (mapped)
+	{
+		waitForDraws(segment);
+	}
+	else if (segment == 0)
+	{
+		/* Let the driver hand us fresh storage instead of
+		 * waiting on draws still using the old one, which
+		 * invalidates the contents of all segments */
+		VBO::bind(vbo);
+		VBO::allocEmpty(size, GL_STREAM_DRAW);
+
+		for (size_t i = 1; i < STREAM_SEGMENTS; ++i)
+			++segmentUse[i];
+	}
+
+	++segmentUse[segment];
+	cursor = segment * segmentSize;
+}
+
+void StreamBuffer::waitForDraws(size_t segment)
+{
+	/* Never drawn from since the last fence known done */
+	if (lastDraw[segment] < completedSerial)
+		return;
+
+	/* The oldest fence placed after the last draw; the one
+	 * just placed always qualifies. A draw of data retained
+	 * across frames can be newer than this segment's own fence */
+	size_t best = STREAM_SEGMENTS;
+
+	for (size_t i = 0; i < STREAM_SEGMENTS; ++i)
+	{
+		if (!fences[i] || fenceSerial[i] <= lastDraw[segment])
+			continue;
+
+		if (best == STREAM_SEGMENTS || fenceSerial[i] < fenceSerial[best])
+			best = i;
+	}
+
+	if (best == STREAM_SEGMENTS)
+		return;
+
+	GLenum result;
+
+	do
+		result = gl.ClientWaitSync(fences[best], GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+	while (result == GL_TIMEOUT_EXPIRED);
+
+	completedSerial = std::max(completedSerial, fenceSerial[best]);
+}
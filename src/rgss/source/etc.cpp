@@ -23,10 +23,19 @@
 
 #include "serial-util.h"
 #include "exception.h"
+#include "sharedstate.h"
 
 #include <SDL2/SDL_types.h>
 #include <SDL2/SDL_pixels.h>
 
+/* Colors, tones and rects feed directly into rendering,
+ * so any change to them invalidates the last frame */
+static void sceneChanged()
+{
+	if (shState)
+		shState->bumpSceneGeneration();
+}
+
 Color::Color(double red, double green, double blue, double alpha)
 	: red(red), green(green), blue(blue), alpha(alpha)
 {
@@ -60,6 +69,8 @@ const Color &Color::operator=(const Color &o)
 	alpha = o.alpha;
 	norm  = o.norm;
 
+	sceneChanged();
+
 	return o;
 }
 
@@ -71,30 +82,39 @@ void Color::set(double red, double green, double blue, double alpha)
 	this->alpha = alpha;
 
 	updateInternal();
+	sceneChanged();
 }
 
 void Color::setRed(double value)
 {
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
+
+	sceneChanged();
 }
 
 void Color::setGreen(double value)
 {
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
+
+	sceneChanged();
 }
 
 void Color::setBlue(double value)
 {
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
+
+	sceneChanged();
 }
 
 void Color::setAlpha(double value)
 {
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
+
+	sceneChanged();
 }
 
 /* Serializable */
@@ -183,6 +203,7 @@ void Tone::set(double red, double green, double blue, double gray)
 
 	updateInternal();
 	valueChanged();
+	sceneChanged();
 }
 
 const Tone& Tone::operator=(const Tone &o)
@@ -194,6 +215,7 @@ const Tone& Tone::operator=(const Tone &o)
 	norm  = o.norm;
 
 	valueChanged();
+	sceneChanged();
 
 	return o;
 }
@@ -204,6 +226,7 @@ void Tone::setRed(double value)
 	norm.x = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	sceneChanged();
 }
 
 void Tone::setGreen(double value)
@@ -212,6 +235,7 @@ void Tone::setGreen(double value)
 	norm.y = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	sceneChanged();
 }
 
 void Tone::setBlue(double value)
@@ -220,6 +244,7 @@ void Tone::setBlue(double value)
 	norm.z = (float) clamp<double>(value, -255, 255) / 255;
 
 	valueChanged();
+	sceneChanged();
 }
 
 void Tone::setGray(double value)
@@ -228,6 +253,7 @@ void Tone::setGray(double value)
 	norm.w = (float) clamp<double>(value, 0, 255) / 255;
 
 	valueChanged();
+	sceneChanged();
 }
 
 /* Serializable */
@@ -313,6 +339,7 @@ void Rect::set(int x, int y, int w, int h)
 	width = w;
 	height = h;
 	valueChanged();
+	sceneChanged();
 }
 
 const Rect &Rect::operator=(const Rect &o)
@@ -323,6 +350,7 @@ const Rect &Rect::operator=(const Rect &o)
 	height = o.height;
 
 	valueChanged();
+	sceneChanged();
 
 	return o;
 }
@@ -334,6 +362,7 @@ void Rect::empty()
 
 	x = y = width = height = 0;
 	valueChanged();
+	sceneChanged();
 }
 
 bool Rect::isEmpty() const
@@ -348,6 +377,7 @@ void Rect::setX(int value)
 
 	x = value;
 	valueChanged();
+	sceneChanged();
 }
 
 void Rect::setY(int value)
@@ -357,6 +387,7 @@ void Rect::setY(int value)
 
 	y = value;
 	valueChanged();
+	sceneChanged();
 }
 
 void Rect::setWidth(int value)
@@ -366,6 +397,7 @@ void Rect::setWidth(int value)
 
 	width = value;
 	valueChanged();
+	sceneChanged();
 }
 
 void Rect::setHeight(int value)
@@ -375,6 +407,7 @@ void Rect::setHeight(int value)
 
 	height = value;
 	valueChanged();
+	sceneChanged();
 }
 
 int Rect::serialSize() const
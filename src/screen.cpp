@@ -8,7 +8,7 @@
 
 #include "config.h"
 #include "debugwriter.h"
-#include "pipe.h"
+#include "ipcchannel.h"
 #include "sharedstate.h"
 
 static void showInitError(const std::string &msg)
@@ -17,27 +17,17 @@ static void showInitError(const std::string &msg)
 	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "OneShot", msg.c_str(), 0);
 }
 
-static bool readMessage(Pipe &ipc, char *buf, size_t size)
-{
-	size_t index = 0;
-	while (index < size - 1) {
-		if (ipc.read(buf + index)) {
-			++index;
-		} else {
-			break;
-		}
-	}
-	buf[index] = 0;
-
-	return index > 0;
-}
-
 int screenMain(Config &conf)
 {
 	const SDL_Color colorKey = {0x00, 0xFF, 0x00, 0xFF};
 	const SDL_Color black = {0x00, 0x00, 0x00, 0xFF};
 
-	Pipe ipc("oneshot-pipe", Pipe::Read);
+	IPCChannel ipc;
+	if (!ipc.connect("oneshot-screen", 5000))
+	{
+		showInitError("Unable to connect to the game");
+		return 0;
+	}
 
 	int imgFlags = IMG_INIT_PNG;
 	if (IMG_Init(imgFlags) != imgFlags)
@@ -66,7 +56,7 @@ int screenMain(Config &conf)
 	SDL_Surface *shape = SDL_CreateRGBSurface(0, DEFAULT_WIDTH, DEFAULT_HEIGHT, 8, 0, 0, 0, 0);
 	SDL_SetPaletteColors(shape->format->palette, &black, 0, 1);
 
-	char messageBuf[256];
+	std::string message;
 
 	std::string filePath =  "./Graphics/Journal/";
 
@@ -81,16 +71,29 @@ int screenMain(Config &conf)
 			}
 		}
 
-		// Change shape
-		if (readMessage(ipc, messageBuf, sizeof(messageBuf))) {
-			if (strcmp(messageBuf, "END") == 0)
+		// Change shape; only the latest of several queued images matters
+		bool shapeChanged = false;
+		bool finished = false;
+		std::string imgname;
+		while (ipc.receive(message)) {
+			if (message == "END") {
+				finished = true;
 				break;
-			std::string imgname = filePath + messageBuf + ".png";
+			}
+			imgname = filePath + message + ".png";
+			shapeChanged = true;
+		}
+
+		// Also stop once the game is gone
+		if (finished || !ipc.isConnected())
+			break;
+
+		if (shapeChanged) {
 			SDL_FreeSurface(shape);
 			if ((shape = IMG_Load(imgname.c_str())) == NULL) {
 				std::string error = "Unable to find image ";
 				SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "OneShot", (error + imgname).c_str(), 0);
-				break;
+				return 0;
 			}
 			SDL_SetWindowSize(win, shape->w, shape->h);
 			SDL_SetWindowShape(win, shape, &shapeMode);
@@ -100,10 +103,10 @@ int screenMain(Config &conf)
 		SDL_BlitSurface(shape, NULL, SDL_GetWindowSurface(win), NULL);
 		SDL_UpdateWindowSurface(win);
 
-		// Regulate framerate
+		// Regulate framerate, waking up as soon as a message arrives
 	    unsigned int ticksDelta = SDL_GetTicks() - ticks;
 	    if (ticksDelta < 1000 / FPS)
-	        SDL_Delay(1000 / FPS - ticksDelta);
+	        ipc.wait(1000 / FPS - ticksDelta);
 	    ticks = SDL_GetTicks();
 	}
 
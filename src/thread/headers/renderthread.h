@@ -0,0 +1,98 @@
+/*
+** renderthread.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "gl-util.h"
+#include "etc-internal.h"
+
+#include <SDL2/SDL_video.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_mutex.h>
+
+/* Presents finished frames to the game window from its own
+ * thread and GL context (sharing objects with the RGSS one).
+ *
+ * Only the final scaled blit and the buffer swap are moved off the
+ * RGSS thread; scene composition still happens there as before. The
+ * frame isn't copied: 'present()' returns as soon as the render
+ * thread has issued its blit, after making the RGSS context wait
+ * (on the GPU, not the CPU) for that blit before anything can draw
+ * into the frame again. Waiting for the swap (vsync) then overlaps
+ * with the next frame's script execution.
+ *
+ * Only one frame is ever in flight; presenting another one before
+ * the previous swap finished blocks, so a vsync'ed swap still paces
+ * the RGSS thread, just one frame later. */
+class RenderThread
+{
+public:
+	/* Must be called from the RGSS thread with its context
+	 * current. Throws an Exception if the render context
+	 * can't be created */
+	RenderThread(SDL_Window *window, SDL_GLContext rgssCtx, bool vsync);
+	~RenderThread();
+
+	/* Hands 'frame' to the render thread to be blitted
+	 * to 'dstRect' of the window and swapped. Blocks while
+	 * the previous frame is still being presented */
+	void present(TEXFBO &frame, const IntRect &dstRect, bool smooth);
+
+	/* Blocks until all queued frames have been presented */
+	void flush();
+
+private:
+	struct Job
+	{
+		GLuint tex;
+		int width;
+		int height;
+
+		IntRect dstRect;
+		bool smooth;
+
+		/* Frame finished rendering on the RGSS context */
+		_GLsync frameSync;
+	};
+
+	void run();
+
+	SDL_Window *window;
+	SDL_GLContext ctx;
+	bool vsync;
+
+	/* Protected by 'mutex' */
+	Job job;
+	bool pending;
+	bool blitIssued;
+	bool presenting;
+	bool quit;
+
+	/* Render thread's blit out of the frame finished */
+	_GLsync blitSync;
+
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+	SDL_Thread *thread;
+};
+
+#endif // RENDERTHREAD_H
@@ -31,6 +31,7 @@
 struct SharedStatePrivate;
 struct RGSSThreadData;
 struct GlobalIBO;
+struct StreamBuffer;
 struct SDL_Window;
 struct TEXFBO;
 struct Quad;
@@ -48,8 +49,10 @@ class Steam;
 #endif
 class GLState;
 class TexPool;
+class TileAtlasCache;
 class Font;
 class SharedFontState;
+class Preparable;
 struct GlobalIBO;
 struct Config;
 struct Vec2i;
@@ -91,7 +94,20 @@ struct SharedState
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 
-	sigc::signal<void> prepareDraw;
+	/* Elements queue themselves here when their state changed
+	 * and they need work done before the next frame draw.
+	 * 'prepareDraw' runs (and empties) the queue; an element
+	 * queued again from inside its own prepare handler will
+	 * only be handled on the next call */
+	void queuePrepare(Preparable &element);
+	void dequeuePrepare(Preparable &element);
+	void prepareDraw();
+
+	/* Bumped by every state change that could alter the
+	 * composited frame. If it didn't move since the last
+	 * composition, that frame can simply be presented again */
+	void bumpSceneGeneration();
+	unsigned int sceneGeneration() const;
 
 	unsigned int genTimeStamp();
 
@@ -100,6 +116,9 @@ struct SharedState
 	void ensureQuadIBO(size_t minSize);
 	GlobalIBO &globalIBO();
 
+	/* Ring buffer for dynamic vertex data */
+	StreamBuffer &streamBuffer();
+
 	/* Global general purpose texture */
 	void bindTex();
 	void ensureTexSize(int minW, int minH, Vec2i &currentSizeOut);
@@ -108,10 +127,9 @@ struct SharedState
 
 	Quad &gpQuad() const;
 
-	/* Basically just a simple "TexPool"
-	 * replacement for Tilemap atlas use */
-	void requestAtlasTex(int w, int h, TEXFBO &out);
-	void releaseAtlasTex(TEXFBO &tex);
+	/* Tilemap atlases, shared between Tilemaps
+	 * using the same tileset / autotiles */
+	TileAtlasCache &atlasCache();
 
 	/* Checks EventThread's shutdown request flag and if set,
 	 * requests the binding to terminate. In this case, this
@@ -0,0 +1,224 @@
+/*
+** renderthread.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 Jonas Kulla <Nyocurio@gmail.com>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "renderthread.h"
+
+#include "gl-meta.h"
+#include "sdl-util.h"
+#include "exception.h"
+#include "debugwriter.h"
+
+RenderThread::RenderThread(SDL_Window *window, SDL_GLContext rgssCtx, bool vsync)
+    : window(window),
+      vsync(vsync),
+      pending(false),
+      blitIssued(false),
+      presenting(false),
+      quit(false),
+      blitSync(0)
+{
+	/* The render thread only ever blits, and can't
+	 * touch any of the RGSS thread's GLState */
+	if (!gl.BlitFramebuffer)
+		throw Exception(Exception::MKXPError,
+		                "Pipelined rendering requires framebuffer blitting");
+
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	ctx = SDL_GL_CreateContext(window);
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+	/* Creating a context makes it current */
+	SDL_GL_MakeCurrent(window, rgssCtx);
+
+	if (!ctx)
+		throw Exception(Exception::SDLError,
+		                "Error creating render context: %s", SDL_GetError());
+
+	mutex = SDL_CreateMutex();
+	cond = SDL_CreateCond();
+
+	thread = createSDLThread
+		<RenderThread, &RenderThread::run>(this, "render");
+}
+
+RenderThread::~RenderThread()
+{
+	SDL_LockMutex(mutex);
+	quit = true;
+	SDL_CondBroadcast(cond);
+	SDL_UnlockMutex(mutex);
+
+	SDL_WaitThread(thread, 0);
+
+	SDL_DestroyCond(cond);
+	SDL_DestroyMutex(mutex);
+
+	SDL_GL_DeleteContext(ctx);
+}
+
+void RenderThread::present(TEXFBO &frame, const IntRect &dstRect, bool smooth)
+{
+	SDL_LockMutex(mutex);
+
+	while (pending || presenting)
+		SDL_CondWait(cond, mutex);
+
+	SDL_UnlockMutex(mutex);
+
+	/* Make sure the frame is complete before the
+	 * render context reads from it */
+	_GLsync frameSync = 0;
+
+	if (gl.FenceSync)
+	{
+		frameSync = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		gl.Flush();
+	}
+	else
+	{
+		gl.Finish();
+	}
+
+	SDL_LockMutex(mutex);
+
+	job.tex = frame.tex.gl;
+	job.width = frame.width;
+	job.height = frame.height;
+	job.dstRect = dstRect;
+	job.smooth = smooth;
+	job.frameSync = frameSync;
+
+	pending = true;
+	blitIssued = false;
+	SDL_CondBroadcast(cond);
+
+	/* Only a short wait, the swap happens afterwards */
+	while (!blitIssued)
+		SDL_CondWait(cond, mutex);
+
+	_GLsync sync = blitSync;
+	blitSync = 0;
+
+	SDL_UnlockMutex(mutex);
+
+	/* Nothing drawn from here on may overwrite the
+	 * frame before the render thread read it */
+	if (sync)
+	{
+		gl.WaitSync(sync, 0, GL_TIMEOUT_IGNORED);
+		gl.DeleteSync(sync);
+	}
+}
+
+void RenderThread::flush()
+{
+	SDL_LockMutex(mutex);
+
+	while (pending || presenting)
+		SDL_CondWait(cond, mutex);
+
+	SDL_UnlockMutex(mutex);
+}
+
+void RenderThread::run()
+{
+	SDL_GL_MakeCurrent(window, ctx);
+	SDL_GL_SetSwapInterval(vsync ? 1 : 0);
+
+	/* FBOs aren't shared between contexts */
+	GLuint readFBO;
+	gl.GenFramebuffers(1, &readFBO);
+	gl.ClearColor(0, 0, 0, 1);
+
+	SDL_LockMutex(mutex);
+
+	while (true)
+	{
+		while (!quit && !pending)
+			SDL_CondWait(cond, mutex);
+
+		if (quit)
+			break;
+
+		Job cur = job;
+		pending = false;
+		presenting = true;
+
+		SDL_UnlockMutex(mutex);
+
+		if (cur.frameSync)
+		{
+			gl.WaitSync(cur.frameSync, 0, GL_TIMEOUT_IGNORED);
+			gl.DeleteSync(cur.frameSync);
+		}
+
+		/* Reattach every time, the frame texture
+		 * might have been reallocated in the meantime */
+		gl.BindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		gl.FramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		                        GL_TEXTURE_2D, cur.tex, 0);
+		gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+		const IntRect &dst = cur.dstRect;
+
+		gl.Clear(GL_COLOR_BUFFER_BIT);
+		gl.BlitFramebuffer(0, 0, cur.width, cur.height,
+		                   dst.x, dst.y, dst.x+dst.w, dst.y+dst.h,
+		                   GL_COLOR_BUFFER_BIT, cur.smooth ? GL_LINEAR : GL_NEAREST);
+
+		/* Detach so a later reallocation of the
+		 * texture doesn't touch this context */
+		gl.FramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		                        GL_TEXTURE_2D, 0, 0);
+
+		_GLsync sync = 0;
+
+		if (gl.FenceSync)
+		{
+			sync = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			gl.Flush();
+		}
+		else
+		{
+			gl.Finish();
+		}
+
+		SDL_LockMutex(mutex);
+
+		blitSync = sync;
+		blitIssued = true;
+		SDL_CondBroadcast(cond);
+
+		SDL_UnlockMutex(mutex);
+
+		SDL_GL_SwapWindow(window);
+
+		SDL_LockMutex(mutex);
+
+		presenting = false;
+		SDL_CondBroadcast(cond);
+	}
+
+	SDL_UnlockMutex(mutex);
+
+	gl.DeleteFramebuffers(1, &readFBO);
+	SDL_GL_MakeCurrent(window, 0);
+}
@@ -32,12 +32,17 @@
 #endif
 #include "glstate.h"
 #include "shader.h"
+#include "programcache.h"
 #include "texpool.h"
+#include "tileatlascache.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
 #include "global-ibo.h"
+#include "streambuffer.h"
 #include "quad.h"
+#include "preparable.h"
+#include "intrulist.h"
 #include "binding.h"
 #include "exception.h"
 
@@ -50,6 +55,7 @@
 SharedState *SharedState::instance = 0;
 int SharedState::rgssVersion = 0;
 static GlobalIBO *_globalIBO = 0;
+static StreamBuffer *_streamBuffer = 0;
 
 struct SharedStatePrivate
 {
@@ -74,6 +80,8 @@ struct SharedStatePrivate
 
 	GLState _glState;
 
+	/* Only used while constructing 'shaders' */
+	ProgramCache programCache;
 	ShaderSet shaders;
 
 	TexPool texPool;
@@ -87,11 +95,16 @@ struct SharedStatePrivate
 
 	TEXFBO gpTexFBO;
 
-	TEXFBO atlasTex;
+	TileAtlasCache atlasCache;
 
 	Quad gpQuad;
 
+	/* Elements waiting for 'prepareDraw' */
+	IntruList<Preparable> prepareList;
+	Preparable *prepareLast;
+
 	unsigned int stampCounter;
+	unsigned int sceneGeneration;
 
 	SharedStatePrivate(RGSSThreadData *threadData)
 	    : bindingData(0),
@@ -105,10 +118,15 @@ struct SharedStatePrivate
 	      audio(*threadData),
 	      oneshot(*threadData),
 	      _glState(threadData->config),
+	      programCache(threadData->config),
 	      fontState(threadData->config),
-	      stampCounter(0)
+	      prepareLast(0),
+	      stampCounter(0),
+	      sceneGeneration(0)
 	{
 		/* Shaders have been compiled in ShaderSet's constructor */
+		programCache.finish();
+
 		if (gl.ReleaseShaderCompiler)
 			gl.ReleaseShaderCompiler();
 
@@ -139,14 +157,13 @@ struct SharedStatePrivate
 	{
 		TEX::del(globalTex);
 		TEXFBO::fini(gpTexFBO);
-		TEXFBO::fini(atlasTex);
 	}
 };
 
 void SharedState::initInstance(RGSSThreadData *threadData)
 {
 	/* This section is tricky because of dependencies:
-	 * SharedState depends on GlobalIBO existing,
+	 * SharedState depends on GlobalIBO and StreamBuffer existing,
 	 * Font depends on SharedState existing */
 
 	rgssVersion = threadData->config.rgssVersion;
@@ -154,6 +171,8 @@ void SharedState::initInstance(RGSSThreadData *threadData)
 	_globalIBO = new GlobalIBO();
 	_globalIBO->ensureSize(1);
 
+	_streamBuffer = new StreamBuffer();
+
 	SharedState::instance = 0;
 	Font *defaultFont = 0;
 
@@ -165,8 +184,9 @@ void SharedState::initInstance(RGSSThreadData *threadData)
 	}
 	catch (const Exception &exc)
 	{
-		delete _globalIBO;
 		delete SharedState::instance;
+		delete _streamBuffer;
+		delete _globalIBO;
 		delete defaultFont;
 
 		throw exc;
@@ -181,6 +201,7 @@ void SharedState::finiInstance()
 
 	delete SharedState::instance;
 
+	delete _streamBuffer;
 	delete _globalIBO;
 }
 
@@ -230,6 +251,44 @@ GlobalIBO &SharedState::globalIBO()
 	return *_globalIBO;
 }
 
+StreamBuffer &SharedState::streamBuffer()
+{
+	return *_streamBuffer;
+}
+
+void SharedState::queuePrepare(Preparable &element)
+{
+	p->prepareList.append(element.prepareLink);
+}
+
+void SharedState::dequeuePrepare(Preparable &element)
+{
+	/* Don't leave a dangling end marker behind */
+	if (&element == p->prepareLast)
+		p->prepareLast = element.prepareLink.prev->data;
+
+	p->prepareList.remove(element.prepareLink);
+}
+
+void SharedState::prepareDraw()
+{
+	/* Only handle what was queued up until now, so elements
+	 * that requeue themselves (eg. Tilemap) can't stall us */
+	p->prepareLast = p->prepareList.tail();
+
+	while (p->prepareLast)
+	{
+		IntruListLink<Preparable> *link = p->prepareList.begin();
+		Preparable *element = link->data;
+
+		if (element == p->prepareLast)
+			p->prepareLast = 0;
+
+		p->prepareList.remove(*link);
+		element->prepare();
+	}
+}
+
 void SharedState::bindTex()
 {
 	TEX::bind(p->globalTex);
@@ -283,34 +342,9 @@ TEXFBO &SharedState::gpTexFBO(int minW, int minH)
 	return p->gpTexFBO;
 }
 
-void SharedState::requestAtlasTex(int w, int h, TEXFBO &out)
-{
-	TEXFBO tex;
-
-	if (w == p->atlasTex.width && h == p->atlasTex.height)
-	{
-		tex = p->atlasTex;
-		p->atlasTex = TEXFBO();
-	}
-	else
-	{
-		TEXFBO::init(tex);
-		TEXFBO::allocEmpty(tex, w, h);
-		TEXFBO::linkFBO(tex);
-	}
-
-	out = tex;
-}
-
-void SharedState::releaseAtlasTex(TEXFBO &tex)
+TileAtlasCache &SharedState::atlasCache()
 {
-	/* No point in caching an invalid object */
-	if (tex.tex == TEX::ID(0))
-		return;
-
-	TEXFBO::fini(p->atlasTex);
-
-	p->atlasTex = tex;
+	return p->atlasCache;
 }
 
 void SharedState::checkShutdown()
@@ -342,6 +376,16 @@ unsigned int SharedState::genTimeStamp()
 	return p->stampCounter++;
 }
 
+void SharedState::bumpSceneGeneration()
+{
+	++p->sceneGeneration;
+}
+
+unsigned int SharedState::sceneGeneration() const
+{
+	return p->sceneGeneration;
+}
+
 SharedState::SharedState(RGSSThreadData *threadData)
 {
 	p = new SharedStatePrivate(threadData);
@@ -46,11 +46,17 @@ struct Config
 	int fixedFramerate;
 	bool frameSkip;
 	bool syncToRefreshrate;
+	bool pipelinedRendering;
+	int framePacingSpin;
+	bool alignFramerate;
+	bool dumpFrameTiming;
 
 	bool solidFonts;
+	int fontPoolSize;
 
 	bool subImageFix;
 	bool enableBlitting;
+	bool shaderCache;
 	int maxTextureSize;
 
 	std::string gameFolder;
@@ -105,10 +111,38 @@ struct Config
 	struct
 	{
 		int sourceCount;
+		int cacheSize;
+		int decodeThreads;
 	} SE;
 
+	struct
+	{
+		int size;
+		int decodeSeconds;
+	} streamCache;
+
 	int audioChannels;
 
+	int audioStatsInterval;
+
+	/* Stream buffering per channel type, see ALStreamBufferPolicy */
+	struct StreamBuffers
+	{
+		int minBuffers;
+		int maxBuffers;
+		/* In KB */
+		int maxBufferSize;
+	};
+
+	struct
+	{
+		StreamBuffers bgm;
+		StreamBuffers bgs;
+		StreamBuffers me;
+		StreamBuffers channels;
+		int stableSeconds;
+	} streamBuffers;
+
 	bool useScriptNames;
 
 	std::string customScript;
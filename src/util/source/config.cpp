@@ -63,6 +63,14 @@ std::set<T> setFromVec(const std::vector<T> &vec)
 	return std::set<T>(vec.begin(), vec.end());
 }
 
+static void clampStreamBuffers(Config::StreamBuffers &conf)
+{
+	/* Upper limit matches STREAM_BUFS_MAX */
+	conf.minBuffers = clamp(conf.minBuffers, 2, 16);
+	conf.maxBuffers = clamp(conf.maxBuffers, conf.minBuffers, 16);
+	conf.maxBufferSize = clamp(conf.maxBufferSize, 32, 1024);
+}
+
 typedef std::vector<std::string> StringVec;
 namespace po = boost::program_options;
 
@@ -87,15 +95,39 @@ void Config::read(int argc, char *argv[])
 	PO_DESC(fixedFramerate, int, 0) \
 	PO_DESC(frameSkip, bool, true) \
 	PO_DESC(syncToRefreshrate, bool, false) \
+	PO_DESC(pipelinedRendering, bool, false) \
+	PO_DESC(framePacingSpin, int, 1000) \
+	PO_DESC(alignFramerate, bool, false) \
+	PO_DESC(dumpFrameTiming, bool, false) \
 	PO_DESC(solidFonts, bool, false) \
+	PO_DESC(fontPoolSize, int, 16) \
 	PO_DESC(subImageFix, bool, false) \
 	PO_DESC(enableBlitting, bool, true) \
+	PO_DESC(shaderCache, bool, true) \
 	PO_DESC(maxTextureSize, int, 0) \
 	PO_DESC(gameFolder, std::string, ".") \
 	PO_DESC(allowSymlinks, bool, false) \
 	PO_DESC(iconPath, std::string, "") \
 	PO_DESC(SE.sourceCount, int, 6) \
+	PO_DESC(SE.cacheSize, int, 10) \
+	PO_DESC(SE.decodeThreads, int, 2) \
+	PO_DESC(streamCache.size, int, 32) \
+	PO_DESC(streamCache.decodeSeconds, int, 15) \
 	PO_DESC(audioChannels, int, 30) \
+	PO_DESC(audioStatsInterval, int, 0) \
+	PO_DESC(streamBuffers.bgm.minBuffers, int, 3) \
+	PO_DESC(streamBuffers.bgm.maxBuffers, int, 8) \
+	PO_DESC(streamBuffers.bgm.maxBufferSize, int, 128) \
+	PO_DESC(streamBuffers.bgs.minBuffers, int, 3) \
+	PO_DESC(streamBuffers.bgs.maxBuffers, int, 8) \
+	PO_DESC(streamBuffers.bgs.maxBufferSize, int, 128) \
+	PO_DESC(streamBuffers.me.minBuffers, int, 3) \
+	PO_DESC(streamBuffers.me.maxBuffers, int, 6) \
+	PO_DESC(streamBuffers.me.maxBufferSize, int, 64) \
+	PO_DESC(streamBuffers.channels.minBuffers, int, 3) \
+	PO_DESC(streamBuffers.channels.maxBuffers, int, 6) \
+	PO_DESC(streamBuffers.channels.maxBufferSize, int, 64) \
+	PO_DESC(streamBuffers.stableSeconds, int, 30) \
 	PO_DESC(pathCache, bool, false) \
 	PO_DESC(mjitEnabled, bool, false) \
 	PO_DESC(mjitVerbosity, int, 0) \
@@ -190,6 +222,16 @@ void Config::read(int argc, char *argv[])
 #undef PO_DESC_ALL
 
 	SE.sourceCount = clamp(SE.sourceCount, 1, 64);
+	SE.cacheSize = clamp(SE.cacheSize, 1, 1024);
+	SE.decodeThreads = clamp(SE.decodeThreads, 0, 8);
+	streamCache.size = clamp(streamCache.size, 0, 1024);
+	streamCache.decodeSeconds = std::max(streamCache.decodeSeconds, 0);
+	audioStatsInterval = std::max(audioStatsInterval, 0);
+	clampStreamBuffers(streamBuffers.bgm);
+	clampStreamBuffers(streamBuffers.bgs);
+	clampStreamBuffers(streamBuffers.me);
+	clampStreamBuffers(streamBuffers.channels);
+	streamBuffers.stableSeconds = std::max(streamBuffers.stableSeconds, 1);
 
 	commonDataPath = prefPath(".", "Cloverlink");
 